@@ -30,6 +30,7 @@ extern "C"{
 #include "lwip/err.h"
 }
 #include "esp_task_wdt.h"
+#include <atomic>
 
 /*
  * TCP/IP Event Task
@@ -93,9 +94,75 @@ static uint32_t _closed_index = []() {
 }();
 
 
+/*
+ * Event Packet Pool
+ *
+ * Packets are taken in the LwIP thread and returned in the async_tcp task.
+ * The free list head packs a 16 bit index with a 16 bit tag, so the
+ * compare-and-swap cannot be fooled by a packet that was taken and put back.
+ * */
+
+#define EVENT_POOL_EMPTY 0xFFFF
+
+static lwip_event_packet_t _event_pool[CONFIG_ASYNC_TCP_EVENT_POOL_SIZE];
+static std::atomic<uint16_t> _event_pool_next[CONFIG_ASYNC_TCP_EVENT_POOL_SIZE];
+static std::atomic<uint32_t> _event_pool_head(EVENT_POOL_EMPTY);
+static std::atomic<uint32_t> _event_pool_used(0);
+
+static std::atomic<uint32_t> _stat_high_water(0);
+static std::atomic<uint32_t> _stat_pool_misses(0);
+static std::atomic<uint32_t> _stat_polls_coalesced(0);
+static std::atomic<uint32_t> _stat_polls_dropped(0);
+static std::atomic<uint32_t> _stat_recv_deferred(0);
+static std::atomic<uint32_t> _stat_stalls(0);
+static std::atomic<uint32_t> _stat_dropped(0);
+
+static void _init_event_pool(){
+    for (int i = 0; i < CONFIG_ASYNC_TCP_EVENT_POOL_SIZE; ++ i) {
+        _event_pool_next[i].store((i + 1 < CONFIG_ASYNC_TCP_EVENT_POOL_SIZE) ? i + 1 : EVENT_POOL_EMPTY, std::memory_order_relaxed);
+    }
+    _event_pool_head.store(CONFIG_ASYNC_TCP_EVENT_POOL_SIZE ? 0 : EVENT_POOL_EMPTY);
+}
+
+static lwip_event_packet_t * _alloc_event(){
+    uint32_t head = _event_pool_head.load(std::memory_order_acquire);
+    while((head & 0xFFFF) != EVENT_POOL_EMPTY){
+        uint16_t index = head & 0xFFFF;
+        //a stale link read here is harmless: the tag makes the swap fail
+        uint32_t next = ((head + 0x10000) & 0xFFFF0000) | _event_pool_next[index].load(std::memory_order_relaxed);
+        if(_event_pool_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire)){
+            _event_pool_used.fetch_add(1, std::memory_order_relaxed);
+            return &_event_pool[index];
+        }
+    }
+    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    if(e){
+        _stat_pool_misses.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        _stat_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return e;
+}
+
+static void _free_event(lwip_event_packet_t * e){
+    if(e < _event_pool || e >= _event_pool + CONFIG_ASYNC_TCP_EVENT_POOL_SIZE){
+        free((void*)(e));
+        return;
+    }
+    uint16_t index = e - _event_pool;
+    uint32_t head = _event_pool_head.load(std::memory_order_acquire);
+    uint32_t next;
+    do {
+        _event_pool_next[index].store(head & 0xFFFF, std::memory_order_relaxed);
+        next = ((head + 0x10000) & 0xFFFF0000) | index;
+    } while(!_event_pool_head.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire));
+    _event_pool_used.fetch_sub(1, std::memory_order_relaxed);
+}
+
 static inline bool _init_async_event_queue(){
     if(!_async_queue){
-        _async_queue = xQueueCreate(32, sizeof(lwip_event_packet_t *));
+        _init_event_pool();
+        _async_queue = xQueueCreate(CONFIG_ASYNC_TCP_QUEUE_SIZE, sizeof(lwip_event_packet_t *));
         if(!_async_queue){
             return false;
         }
@@ -103,12 +170,50 @@ static inline bool _init_async_event_queue(){
     return true;
 }
 
+static inline void _note_queue_depth(){
+    uint32_t depth = uxQueueMessagesWaiting(_async_queue);
+    uint32_t high = _stat_high_water.load(std::memory_order_relaxed);
+    while(depth > high && !_stat_high_water.compare_exchange_weak(high, depth, std::memory_order_relaxed));
+}
+
+//waits at most `wait` ticks once the queue is full; every wait is counted as a stall
+static inline bool _queue_async_event(lwip_event_packet_t ** e, bool front, TickType_t wait){
+    if(!_async_queue){
+        return false;
+    }
+    BaseType_t sent = front ? xQueueSendToFront(_async_queue, e, 0) : xQueueSend(_async_queue, e, 0);
+    if(sent != pdPASS && wait){
+        _stat_stalls.fetch_add(1, std::memory_order_relaxed);
+        sent = front ? xQueueSendToFront(_async_queue, e, wait) : xQueueSend(_async_queue, e, wait);
+    }
+    if(sent != pdPASS){
+        return false;
+    }
+    _note_queue_depth();
+    return true;
+}
+
 static inline bool _send_async_event(lwip_event_packet_t ** e){
-    return _async_queue && xQueueSend(_async_queue, e, portMAX_DELAY) == pdPASS;
+    return _queue_async_event(e, false, portMAX_DELAY);
 }
 
 static inline bool _prepend_async_event(lwip_event_packet_t ** e){
-    return _async_queue && xQueueSendToFront(_async_queue, e, portMAX_DELAY) == pdPASS;
+    return _queue_async_event(e, true, portMAX_DELAY);
+}
+
+void async_tcp_get_stats(async_tcp_stats_t * stats){
+    if(!stats){
+        return;
+    }
+    stats->queueDepth = _async_queue ? uxQueueMessagesWaiting(_async_queue) : 0;
+    stats->queueHighWater = _stat_high_water.load(std::memory_order_relaxed);
+    stats->poolFree = CONFIG_ASYNC_TCP_EVENT_POOL_SIZE - _event_pool_used.load(std::memory_order_relaxed);
+    stats->poolMisses = _stat_pool_misses.load(std::memory_order_relaxed);
+    stats->pollsCoalesced = _stat_polls_coalesced.load(std::memory_order_relaxed);
+    stats->pollsDropped = _stat_polls_dropped.load(std::memory_order_relaxed);
+    stats->recvDeferred = _stat_recv_deferred.load(std::memory_order_relaxed);
+    stats->stalls = _stat_stalls.load(std::memory_order_relaxed);
+    stats->dropped = _stat_dropped.load(std::memory_order_relaxed);
 }
 
 static inline bool _get_async_event(lwip_event_packet_t ** e){
@@ -129,7 +234,7 @@ static bool _remove_events_with_arg(void * arg){
         }
         //discard packet if matching
         if((int)first_packet->arg == (int)arg){
-            free(first_packet);
+            _free_event(first_packet);
             first_packet = NULL;
         //return first packet to the back of the queue
         } else if(xQueueSend(_async_queue, &first_packet, portMAX_DELAY) != pdPASS){
@@ -142,7 +247,7 @@ static bool _remove_events_with_arg(void * arg){
             return false;
         }
         if((int)packet->arg == (int)arg){
-            free(packet);
+            _free_event(packet);
             packet = NULL;
         } else if(xQueueSend(_async_queue, &packet, portMAX_DELAY) != pdPASS){
             return false;
@@ -182,7 +287,7 @@ static void _handle_async_event(lwip_event_packet_t * e){
         //ets_printf("D: 0x%08x %s = %s\n", e->arg, e->dns.name, ipaddr_ntoa(&e->dns.addr));
         AsyncClient::_s_dns_found(e->dns.name, &e->dns.addr, e->arg);
     }
-    free((void*)(e));
+    _free_event(e);
 }
 
 static void _async_service_task(void *pvParameters){
@@ -218,7 +323,7 @@ static bool _start_async_task(){
         return false;
     }
     if(!_async_service_task_handle){
-        xTaskCreateUniversal(_async_service_task, "async_tcp", 8192 * 2, NULL, 3, &_async_service_task_handle, CONFIG_ASYNC_TCP_RUNNING_CORE);
+        xTaskCreateUniversal(_async_service_task, "async_tcp", CONFIG_ASYNC_TCP_STACK_SIZE, NULL, CONFIG_ASYNC_TCP_PRIORITY, &_async_service_task_handle, CONFIG_ASYNC_TCP_RUNNING_CORE);
         if(!_async_service_task_handle){
             return false;
         }
@@ -231,89 +336,140 @@ static bool _start_async_task(){
  * */
 
 static int8_t _tcp_clear_events(void * arg) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return ERR_MEM;
+    }
     e->event = LWIP_TCP_CLEAR;
     e->arg = arg;
     if (!_prepend_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
     return ERR_OK;
 }
 
 static int8_t _tcp_connected(void * arg, tcp_pcb * pcb, int8_t err) {
     //ets_printf("+C: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return ERR_MEM;
+    }
     e->event = LWIP_TCP_CONNECTED;
     e->arg = arg;
     e->connected.pcb = pcb;
     e->connected.err = err;
     if (!_prepend_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
     return ERR_OK;
 }
 
 static int8_t _tcp_poll(void * arg, struct tcp_pcb * pcb) {
     //ets_printf("+P: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    //polls are periodic, so one that cannot be queued right away is simply skipped
+    if(_async_queue && uxQueueSpacesAvailable(_async_queue) < CONFIG_ASYNC_TCP_QUEUE_SIZE / 4){
+        _stat_polls_dropped.fetch_add(1, std::memory_order_relaxed);
+        return ERR_OK;
+    }
+    if(arg && !AsyncClient::_s_poll_queue(arg)){
+        _stat_polls_coalesced.fetch_add(1, std::memory_order_relaxed);
+        return ERR_OK;
+    }
+    //the flag is set before queueing, as _s_poll may clear it as soon as the event is in;
+    //every path that does not queue must clear it, or the client is never polled again
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        if(arg){
+            AsyncClient::_s_poll_unqueue(arg);
+        }
+        return ERR_OK;
+    }
     e->event = LWIP_TCP_POLL;
     e->arg = arg;
     e->poll.pcb = pcb;
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
+    if (!_queue_async_event(&e, false, 0)) {
+        _stat_polls_dropped.fetch_add(1, std::memory_order_relaxed);
+        _free_event(e);
+        if(arg){
+            AsyncClient::_s_poll_unqueue(arg);
+        }
     }
     return ERR_OK;
 }
 
 static int8_t _tcp_recv(void * arg, struct tcp_pcb * pcb, struct pbuf *pb, int8_t err) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
-    e->arg = arg;
-    if(pb){
-        //ets_printf("+R: 0x%08x\n", pcb);
-        e->event = LWIP_TCP_RECV;
-        e->recv.pcb = pcb;
-        e->recv.pb = pb;
-        e->recv.err = err;
-    } else {
+    if(!pb){
         //ets_printf("+F: 0x%08x\n", pcb);
+        //close the PCB in LwIP thread
+        AsyncClient::_s_lwip_fin(arg, pcb, err);
+        lwip_event_packet_t * e = _alloc_event();
+        if(!e){
+            return ERR_OK;
+        }
         e->event = LWIP_TCP_FIN;
+        e->arg = arg;
         e->fin.pcb = pcb;
         e->fin.err = err;
-        //close the PCB in LwIP thread
-        AsyncClient::_s_lwip_fin(e->arg, e->fin.pcb, e->fin.err);
+        if (!_send_async_event(&e)) {
+            _free_event(e);
+        }
+        return ERR_OK;
     }
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
+    //ets_printf("+R: 0x%08x\n", pcb);
+    //when the task cannot keep up, LwIP keeps the refused pbuf and offers it again from its timer
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        _stat_recv_deferred.fetch_add(1, std::memory_order_relaxed);
+        return ERR_MEM;
+    }
+    e->event = LWIP_TCP_RECV;
+    e->arg = arg;
+    e->recv.pcb = pcb;
+    e->recv.pb = pb;
+    e->recv.err = err;
+    if (!_queue_async_event(&e, false, pdMS_TO_TICKS(CONFIG_ASYNC_TCP_QUEUE_TIMEOUT_MS))) {
+        _free_event(e);
+        _stat_recv_deferred.fetch_add(1, std::memory_order_relaxed);
+        return ERR_MEM;
     }
     return ERR_OK;
 }
 
 static int8_t _tcp_sent(void * arg, struct tcp_pcb * pcb, uint16_t len) {
     //ets_printf("+S: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return ERR_OK;
+    }
     e->event = LWIP_TCP_SENT;
     e->arg = arg;
     e->sent.pcb = pcb;
     e->sent.len = len;
     if (!_send_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
     return ERR_OK;
 }
 
 static void _tcp_error(void * arg, int8_t err) {
     //ets_printf("+E: 0x%08x\n", arg);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return;
+    }
     e->event = LWIP_TCP_ERROR;
     e->arg = arg;
     e->error.err = err;
     if (!_send_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
 }
 
 static void _tcp_dns_found(const char * name, struct ip_addr * ipaddr, void * arg) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return;
+    }
     //ets_printf("+DNS: name=%s ipaddr=0x%08x arg=%x\n", name, ipaddr, arg);
     e->event = LWIP_TCP_DNS;
     e->arg = arg;
@@ -324,18 +480,21 @@ static void _tcp_dns_found(const char * name, struct ip_addr * ipaddr, void * ar
         memset(&e->dns.addr, 0, sizeof(e->dns.addr));
     }
     if (!_send_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
 }
 
 //Used to switch out from LwIP thread
 static int8_t _tcp_accept(void * arg, AsyncClient * client) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return ERR_MEM;
+    }
     e->event = LWIP_TCP_ACCEPT;
     e->arg = arg;
     e->accept.client = client;
     if (!_prepend_async_event(&e)) {
-        free((void*)(e));
+        _free_event(e);
     }
     return ERR_OK;
 }
@@ -556,6 +715,7 @@ AsyncClient::AsyncClient(tcp_pcb* pcb)
 , _timeout_cb(0)
 , _timeout_cb_arg(0)
 , _pcb_busy(false)
+, _poll_queued(false)
 , _pcb_sent_at(0)
 , _ack_pcb(true)
 , _rx_last_packet(0)
@@ -1203,9 +1363,25 @@ void AsyncClient::_s_dns_found(const char * name, struct ip_addr * ipaddr, void
 }
 
 int8_t AsyncClient::_s_poll(void * arg, struct tcp_pcb * pcb) {
+    reinterpret_cast<AsyncClient*>(arg)->_poll_queued = false;
     return reinterpret_cast<AsyncClient*>(arg)->_poll(pcb);
 }
 
+//In LwIP Thread: false while an earlier poll for this client is still queued
+bool AsyncClient::_s_poll_queue(void * arg) {
+    AsyncClient * client = reinterpret_cast<AsyncClient*>(arg);
+    if(client->_poll_queued){
+        return false;
+    }
+    client->_poll_queued = true;
+    return true;
+}
+
+//In LwIP Thread: the poll _s_poll_queue allowed could not be queued
+void AsyncClient::_s_poll_unqueue(void * arg) {
+    reinterpret_cast<AsyncClient*>(arg)->_poll_queued = false;
+}
+
 int8_t AsyncClient::_s_recv(void * arg, struct tcp_pcb * pcb, struct pbuf *pb, int8_t err) {
     return reinterpret_cast<AsyncClient*>(arg)->_recv(pcb, pb, err);
 }
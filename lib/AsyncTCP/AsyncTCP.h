@@ -36,6 +36,26 @@ extern "C" {
 #define CONFIG_ASYNC_TCP_USE_WDT 1 //if enabled, adds between 33us and 200us per event
 #endif
 
+#ifndef CONFIG_ASYNC_TCP_PRIORITY
+#define CONFIG_ASYNC_TCP_PRIORITY 3 //keep below anything that must not be preempted on the same core
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_STACK_SIZE
+#define CONFIG_ASYNC_TCP_STACK_SIZE 8192 * 2
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_QUEUE_SIZE
+#define CONFIG_ASYNC_TCP_QUEUE_SIZE 32
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_EVENT_POOL_SIZE
+#define CONFIG_ASYNC_TCP_EVENT_POOL_SIZE CONFIG_ASYNC_TCP_QUEUE_SIZE //packets beyond this fall back to malloc
+#endif
+
+#ifndef CONFIG_ASYNC_TCP_QUEUE_TIMEOUT_MS
+#define CONFIG_ASYNC_TCP_QUEUE_TIMEOUT_MS 10 //longest the LwIP thread waits before handing a recv back to LwIP
+#endif
+
 class AsyncClient;
 
 #define ASYNC_MAX_ACK_TIME 5000
@@ -52,6 +72,20 @@ typedef std::function<void(void*, AsyncClient*, uint32_t time)> AcTimeoutHandler
 struct tcp_pcb;
 struct ip_addr;
 
+typedef struct {
+    uint32_t queueDepth;      //events waiting for the async_tcp task
+    uint32_t queueHighWater;  //deepest the queue has been since boot
+    uint32_t poolFree;        //event packets left in the pool
+    uint32_t poolMisses;      //event packets that had to be malloc'ed
+    uint32_t pollsCoalesced;  //polls skipped because one was still queued for the client
+    uint32_t pollsDropped;    //polls skipped because the queue was nearly full
+    uint32_t recvDeferred;    //received data handed back to LwIP to retry later
+    uint32_t stalls;          //times the LwIP thread had to wait for queue space
+    uint32_t dropped;         //events lost because no packet could be allocated
+} async_tcp_stats_t;
+
+void async_tcp_get_stats(async_tcp_stats_t * stats);
+
 class AsyncClient {
   public:
     AsyncClient(tcp_pcb* pcb = 0);
@@ -128,6 +162,8 @@ class AsyncClient {
 
     //Do not use any of the functions below!
     static int8_t _s_poll(void *arg, struct tcp_pcb *tpcb);
+    static bool _s_poll_queue(void *arg);
+    static void _s_poll_unqueue(void *arg);
     static int8_t _s_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *pb, int8_t err);
     static int8_t _s_fin(void *arg, struct tcp_pcb *tpcb, int8_t err);
     static int8_t _s_lwip_fin(void *arg, struct tcp_pcb *tpcb, int8_t err);
@@ -161,6 +197,7 @@ class AsyncClient {
     void* _poll_cb_arg;
 
     bool _pcb_busy;
+    volatile bool _poll_queued;
     uint32_t _pcb_sent_at;
     bool _ack_pcb;
     uint32_t _rx_ack_len;
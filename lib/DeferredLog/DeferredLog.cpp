@@ -0,0 +1,248 @@
+/*
+  DeferredLog - non-blocking binary logging for timing-critical code.
+*/
+#include "DeferredLog.h"
+#include <WiFi.h>
+#include <sys/time.h>
+#include "esp_timer.h"
+
+DeferredLogger DLog;
+
+/*
+ * RING :: Bounded multi-producer queue (Vyukov). Each cell carries a sequence
+ * number: equal to the position when free for that lap, position + 1 once a
+ * producer has filled it. Producers race only on the CAS of _head; a full ring
+ * drops the new record instead of waiting for the drain task.
+ * */
+
+DeferredLogger::DeferredLogger()
+  : _head(0)
+  , _tail(0)
+  , _logged(0)
+  , _dropped(0)
+  , _highWater(0)
+  , _reportedDrops(0)
+  , _sinkCount(0)
+  , _formats(NULL)
+  , _formatCount(0)
+  , _task(NULL)
+  , _drainLock(NULL)
+{
+  static_assert((DLOG_RING_SIZE & (DLOG_RING_SIZE - 1)) == 0, "DLOG_RING_SIZE must be a power of two");
+  for(uint32_t i = 0; i < DLOG_RING_SIZE; i++)
+    _cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+void DeferredLogger::log(uint8_t level, uint16_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3){
+  uint32_t pos = _head.load(std::memory_order_relaxed);
+  Cell * cell;
+  for(;;){
+    cell = &_cells[pos & (DLOG_RING_SIZE - 1)];
+    int32_t diff = (int32_t)(cell->sequence.load(std::memory_order_acquire) - pos);
+    if(diff == 0){
+      if(_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if(diff < 0){
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = _head.load(std::memory_order_relaxed);
+    }
+  }
+
+  DeferredLogRecord& r = cell->record;
+  r.timestampUs = esp_timer_get_time();
+  r.event = event;
+  r.level = level;
+  r.reserved = 0;
+  r.args[0] = a0;
+  r.args[1] = a1;
+  r.args[2] = a2;
+  r.args[3] = a3;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+
+  _logged.fetch_add(1, std::memory_order_relaxed);
+  // _tail may move meanwhile: the high-water mark is a statistic, not a bound
+  uint32_t waiting = pos + 1 - _tail.load(std::memory_order_relaxed);
+  uint32_t seen = _highWater.load(std::memory_order_relaxed);
+  while(waiting > seen && waiting <= DLOG_RING_SIZE && !_highWater.compare_exchange_weak(seen, waiting, std::memory_order_relaxed));
+}
+
+bool DeferredLogger::_pop(DeferredLogRecord& record){
+  uint32_t pos = _tail.load(std::memory_order_relaxed);
+  Cell * cell = &_cells[pos & (DLOG_RING_SIZE - 1)];
+  if((int32_t)(cell->sequence.load(std::memory_order_acquire) - (pos + 1)) < 0)
+    return false;
+  record = cell->record;
+  cell->sequence.store(pos + DLOG_RING_SIZE, std::memory_order_release);
+  _tail.store(pos + 1, std::memory_order_relaxed);
+  return true;
+}
+
+void DeferredLogger::begin(const char * const * formats, uint16_t count, UBaseType_t priority, BaseType_t core){
+  _formats = formats;
+  _formatCount = count;
+  if(_task != NULL)
+    return;
+  _drainLock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(_taskEntry, "DeferredLog", 4096, this, priority, &_task, core);
+}
+
+bool DeferredLogger::addSink(DeferredLogSink * sink){
+  uint8_t n = _sinkCount.load(std::memory_order_relaxed);
+  if(n >= DLOG_MAX_SINKS)
+    return false;
+  _sinks[n] = sink;
+  _sinkCount.store(n + 1, std::memory_order_release);
+  return true;
+}
+
+size_t DeferredLogger::format(const DeferredLogRecord& record, char * buf, size_t size) const {
+  int n;
+  if(record.event < _formatCount && _formats[record.event] != NULL){
+    const uint32_t * a = record.args;
+    n = snprintf(buf, size, _formats[record.event], a[0], a[1], a[2], a[3]);
+  } else {
+    n = snprintf(buf, size, "event %u: %08x %08x %08x %08x", record.event,
+                 record.args[0], record.args[1], record.args[2], record.args[3]);
+  }
+  if(n < 0)
+    n = 0;
+  return (size_t)n < size ? (size_t)n : size - 1;
+}
+
+void DeferredLogger::_emit(const DeferredLogRecord& record, const char * line, size_t len){
+  uint8_t n = _sinkCount.load(std::memory_order_acquire);
+  for(uint8_t i = 0; i < n; i++)
+    _sinks[i]->write(record, line, len);
+}
+
+void DeferredLogger::drain(){
+  if(_drainLock == NULL)
+    return;
+  xSemaphoreTake(_drainLock, portMAX_DELAY);
+
+  char line[DLOG_LINE_MAX];
+  DeferredLogRecord record;
+  bool any = false;
+  while(_pop(record)){
+    _emit(record, line, format(record, line, sizeof(line)));
+    any = true;
+  }
+
+  uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+  if(dropped != _reportedDrops){
+    record.timestampUs = esp_timer_get_time();
+    record.event = 0xFFFF;
+    record.level = DLOG_LEVEL_WARN;
+    size_t len = snprintf(line, sizeof(line), "⚠️ %u log records dropped (ring full)", dropped - _reportedDrops);
+    _emit(record, line, len < sizeof(line) ? len : sizeof(line) - 1);
+    _reportedDrops = dropped;
+    any = true;
+  }
+
+  if(any){
+    uint8_t n = _sinkCount.load(std::memory_order_acquire);
+    for(uint8_t i = 0; i < n; i++)
+      _sinks[i]->flush();
+  }
+  xSemaphoreGive(_drainLock);
+}
+
+void DeferredLogger::_taskEntry(void * arg){
+  DeferredLogger * self = (DeferredLogger *)arg;
+  for(;;){
+    self->drain();
+    vTaskDelay(DLOG_DRAIN_MS / portTICK_PERIOD_MS);
+  }
+}
+
+DeferredLogStats DeferredLogger::stats() const {
+  DeferredLogStats s;
+  s.logged = _logged.load(std::memory_order_relaxed);
+  s.dropped = _dropped.load(std::memory_order_relaxed);
+  s.highWater = _highWater.load(std::memory_order_relaxed);
+  s.capacity = DLOG_RING_SIZE;
+  return s;
+}
+
+/*
+ * SINKS
+ * */
+
+void DeferredLogPrintSink::write(const DeferredLogRecord& record, const char * line, size_t len){
+  if(len && line[0] == '\r'){
+    _out.write((const uint8_t *)line, len);
+    _progressOpen = true;
+    return;
+  }
+  if(_progressOpen){
+    _out.write('\n');
+    _progressOpen = false;
+  }
+  uint32_t ms = record.timestampUs / 1000ULL;
+  _out.printf("[%6u.%03u] ", ms / 1000, ms % 1000);
+  _out.write((const uint8_t *)line, len);
+  _out.write('\n');
+}
+
+static const uint8_t syslogSeverity[] = {7, 3, 4, 6, 7}; // by DLOG_LEVEL_*
+
+void DeferredLogSyslogSink::write(const DeferredLogRecord& record, const char * line, size_t len){
+  if((len && line[0] == '\r') || WiFi.status() != WL_CONNECTED)
+    return;
+  if(!_resolved){
+    if(!WiFi.hostByName(_host, _ip))
+      return;
+    _resolved = true;
+  }
+
+  // Facility 1 (user); the wall-clock time is only known once the clock has been set
+  uint8_t severity = syslogSeverity[record.level <= DLOG_LEVEL_DEBUG ? record.level : DLOG_LEVEL_DEBUG];
+  char stamp[32] = "-";
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if(now.tv_sec > 1600000000){
+    int64_t epochUs = (int64_t)now.tv_sec * 1000000LL + now.tv_usec - (esp_timer_get_time() - (int64_t)record.timestampUs);
+    time_t sec = epochUs / 1000000LL;
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03uZ", tm.tm_year + 1900, tm.tm_mon + 1,
+             tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned)((epochUs / 1000) % 1000));
+  }
+
+  if(!_udp.beginPacket(_ip, _port))
+    return;
+  _udp.printf("<%u>1 %s %s %s - - - ", 8 + severity, stamp, _hostname, _app);
+  _udp.write((const uint8_t *)line, len);
+  _udp.endPacket();
+}
+
+void DeferredLogFileSink::write(const DeferredLogRecord& record, const char * line, size_t len){
+  if(len && line[0] == '\r')
+    return;
+  if(!_file){
+    _file = _fs.open(_path, FILE_APPEND);
+    if(!_file)
+      return;
+  }
+  if(_file.size() >= _maxBytes){
+    _file.close();
+    String old = String(_path) + ".1";
+    _fs.remove(old);
+    _fs.rename(_path, old);
+    _file = _fs.open(_path, FILE_WRITE);
+    if(!_file)
+      return;
+  }
+  uint32_t ms = record.timestampUs / 1000ULL;
+  _file.printf("[%6u.%03u] ", ms / 1000, ms % 1000);
+  _file.write((const uint8_t *)line, len);
+  _file.write('\n');
+}
+
+// Closing commits the LittleFS metadata once per drain instead of once per line
+void DeferredLogFileSink::flush(){
+  if(_file)
+    _file.close();
+}
@@ -0,0 +1,179 @@
+/*
+  DeferredLog - non-blocking binary logging for timing-critical code.
+
+  A call site stores one fixed-size record (timestamp, level, event id and up
+  to four 32-bit arguments) into a lock-free ring and returns: no formatting,
+  no allocation, no UART. A low-priority task drains the ring, expands each
+  record with the printf format registered for its event id and hands the line
+  to the attached sinks (Serial, remote syslog, a LittleFS file).
+
+  Levels above DLOG_LEVEL compile to nothing, arguments included.
+
+  String arguments are stored as pointers and only dereferenced when the record
+  is formatted, later and on another task: pass string literals or entries of
+  constant tables through DLOG_STR(), never a buffer that may change. Pointers
+  are 32-bit on the ESP32, so they travel in an ordinary argument slot.
+
+  Formats starting with '\r' are console progress lines: the print sink
+  overwrites them in place, syslog and file sinks skip them.
+*/
+#ifndef DEFERREDLOG_H_
+#define DEFERREDLOG_H_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <WiFiUdp.h>
+#include <atomic>
+
+#define DLOG_LEVEL_NONE 0
+#define DLOG_LEVEL_ERROR 1
+#define DLOG_LEVEL_WARN 2
+#define DLOG_LEVEL_INFO 3
+#define DLOG_LEVEL_DEBUG 4
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_LEVEL_INFO
+#endif
+#ifndef DLOG_RING_SIZE
+#define DLOG_RING_SIZE 128     // records, power of two
+#endif
+#ifndef DLOG_DRAIN_MS
+#define DLOG_DRAIN_MS 20
+#endif
+#define DLOG_MAX_ARGS 4
+#define DLOG_MAX_SINKS 4
+#define DLOG_LINE_MAX 192
+
+#define DLOG_STR(s) ((uint32_t)(uintptr_t)(s))
+
+#if DLOG_LEVEL >= DLOG_LEVEL_ERROR
+#define DLOG_E(event, ...) DLog.log(DLOG_LEVEL_ERROR, (event), ##__VA_ARGS__)
+#else
+#define DLOG_E(event, ...) ((void)0)
+#endif
+#if DLOG_LEVEL >= DLOG_LEVEL_WARN
+#define DLOG_W(event, ...) DLog.log(DLOG_LEVEL_WARN, (event), ##__VA_ARGS__)
+#else
+#define DLOG_W(event, ...) ((void)0)
+#endif
+#if DLOG_LEVEL >= DLOG_LEVEL_INFO
+#define DLOG_I(event, ...) DLog.log(DLOG_LEVEL_INFO, (event), ##__VA_ARGS__)
+#else
+#define DLOG_I(event, ...) ((void)0)
+#endif
+#if DLOG_LEVEL >= DLOG_LEVEL_DEBUG
+#define DLOG_D(event, ...) DLog.log(DLOG_LEVEL_DEBUG, (event), ##__VA_ARGS__)
+#else
+#define DLOG_D(event, ...) ((void)0)
+#endif
+
+struct DeferredLogRecord {
+  uint64_t timestampUs;   // esp_timer_get_time() at the call site
+  uint16_t event;
+  uint8_t level;
+  uint8_t reserved;
+  uint32_t args[DLOG_MAX_ARGS];
+};
+
+typedef struct {
+  uint32_t logged;        // records accepted since boot
+  uint32_t dropped;       // records lost because the ring was full
+  uint32_t highWater;     // most records ever waiting in the ring
+  uint32_t capacity;
+} DeferredLogStats;
+
+class DeferredLogSink {
+  public:
+    virtual ~DeferredLogSink(){}
+    // line is formatted without timestamp or trailing newline
+    virtual void write(const DeferredLogRecord& record, const char * line, size_t len) = 0;
+    // Called once the ring has been drained
+    virtual void flush(){}
+};
+
+class DeferredLogger {
+  private:
+    struct Cell {
+      std::atomic<uint32_t> sequence;
+      DeferredLogRecord record;
+    };
+
+    Cell _cells[DLOG_RING_SIZE];
+    std::atomic<uint32_t> _head;        // next position producers claim
+    std::atomic<uint32_t> _tail;        // next position the drain task reads
+    std::atomic<uint32_t> _logged;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _highWater;
+    uint32_t _reportedDrops;
+
+    DeferredLogSink * _sinks[DLOG_MAX_SINKS];
+    std::atomic<uint8_t> _sinkCount;
+
+    const char * const * _formats;
+    uint16_t _formatCount;
+    TaskHandle_t _task;
+    SemaphoreHandle_t _drainLock;       // the ring has a single consumer at a time
+
+    static void _taskEntry(void * arg);
+    bool _pop(DeferredLogRecord& record);
+    void _emit(const DeferredLogRecord& record, const char * line, size_t len);
+
+  public:
+    DeferredLogger();
+
+    // formats[id] is the printf format for event id; records already queued are kept
+    void begin(const char * const * formats, uint16_t count, UBaseType_t priority = 1, BaseType_t core = 0);
+    bool addSink(DeferredLogSink * sink);
+
+    // Never blocks or allocates; safe from any task and from ISRs
+    void log(uint8_t level, uint16_t event, uint32_t a0 = 0, uint32_t a1 = 0, uint32_t a2 = 0, uint32_t a3 = 0);
+
+    // Formats every queued record now, on the calling task
+    void drain();
+    size_t format(const DeferredLogRecord& record, char * buf, size_t size) const;
+    DeferredLogStats stats() const;
+};
+
+extern DeferredLogger DLog;
+
+// Serial (or any Print) with a seconds-since-boot prefix
+class DeferredLogPrintSink: public DeferredLogSink {
+  private:
+    Print& _out;
+    bool _progressOpen;
+  public:
+    DeferredLogPrintSink(Print& out): _out(out), _progressOpen(false) {}
+    void write(const DeferredLogRecord& record, const char * line, size_t len) override;
+};
+
+// RFC 5424 over UDP; records are dropped while Wi-Fi is down
+class DeferredLogSyslogSink: public DeferredLogSink {
+  private:
+    WiFiUDP _udp;
+    const char * _host;
+    uint16_t _port;
+    const char * _hostname;
+    const char * _app;
+    IPAddress _ip;
+    bool _resolved;
+  public:
+    DeferredLogSyslogSink(const char * host, const char * hostname, const char * app, uint16_t port = 514)
+      : _host(host), _port(port), _hostname(hostname), _app(app), _resolved(false) {}
+    void write(const DeferredLogRecord& record, const char * line, size_t len) override;
+};
+
+// Appends to a file, rotating it to <path>.1 past maxBytes
+class DeferredLogFileSink: public DeferredLogSink {
+  private:
+    fs::FS& _fs;
+    const char * _path;
+    size_t _maxBytes;
+    File _file;
+  public:
+    DeferredLogFileSink(fs::FS& fs, const char * path, size_t maxBytes = 64 * 1024)
+      : _fs(fs), _path(path), _maxBytes(maxBytes) {}
+    void write(const DeferredLogRecord& record, const char * line, size_t len) override;
+    void flush() override;
+};
+
+#endif /* DEFERREDLOG_H_ */
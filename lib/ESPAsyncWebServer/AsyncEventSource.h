@@ -116,6 +116,7 @@ class AsyncEventSource: public AsyncWebHandler {
     void _handleDisconnect(AsyncEventSourceClient * client);
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual const char* _statsLabel() const override { return _url.c_str(); }
 };
 
 class AsyncEventSourceResponse: public AsyncWebServerResponse {
@@ -169,6 +169,164 @@ public:
 	}
 };
 
+#ifndef ARDUINOJSON_5_COMPATIBILITY
+/*
+ * Json Stream Response
+ *
+ * The document is allocated from an arena owned by the response: heap chunks taken as
+ * the document grows, up to ASYNC_JSON_ARENA_MAX, all given back at once. So the heap
+ * a handler needs is bounded whatever the payload. The body is never rendered into a
+ * String: Content-Length comes from measureJson(), the text is serialized once into a
+ * buffer of that size, the document's arena is released, and every TCP window is
+ * copied from where the previous one ended.
+ *
+ *   AsyncJsonStreamResponse * response = new AsyncJsonStreamResponse();
+ *   JsonDocument& doc = response->document();
+ *   doc["key"] = value;
+ *   request->send(response);
+ * */
+
+#ifndef ASYNC_JSON_ARENA_CHUNK
+#define ASYNC_JSON_ARENA_CHUNK 1280 // one ArduinoJson slot pool plus the strings of a small document
+#endif
+#ifndef ASYNC_JSON_ARENA_MAX
+#define ASYNC_JSON_ARENA_MAX 4096 // most heap one response's document may hold
+#endif
+
+// Bump allocator over heap chunks. Every block carries its size so a reallocation
+// can move it; only the most recent block is ever given back before release().
+class AsyncJsonArena : public ArduinoJson::Allocator {
+  private:
+    static const size_t ALIGN = 8;
+    struct Chunk {
+      Chunk* next;
+      size_t size;
+      size_t used;
+    };
+    static const size_t HEADER = (sizeof(Chunk) + ALIGN - 1) & ~(ALIGN - 1);
+
+    Chunk* _head;   // The chunk blocks are taken from; older ones are full
+    size_t _total;
+    size_t _peak;
+
+    static size_t _align(size_t size){ return (size + ALIGN - 1) & ~(ALIGN - 1); }
+    static size_t& _sizeOf(void* ptr){ return *(size_t*)((uint8_t*)ptr - ALIGN); }
+    static uint8_t* _data(Chunk* c){ return (uint8_t*)c + HEADER; }
+    bool _isLast(void* ptr) const { return _head && (uint8_t*)ptr + _sizeOf(ptr) == _data(_head) + _head->used; }
+
+    bool _grow(size_t need){
+      size_t want = need > ASYNC_JSON_ARENA_CHUNK ? need : ASYNC_JSON_ARENA_CHUNK;
+      if(_total + want > ASYNC_JSON_ARENA_MAX)
+        want = need;   // The last chunk only takes what is asked
+      if(_total + want > ASYNC_JSON_ARENA_MAX)
+        return false;
+      Chunk* c = (Chunk*)malloc(HEADER + want);
+      if(c == NULL)
+        return false;
+      c->next = _head;
+      c->size = want;
+      c->used = 0;
+      _head = c;
+      _total += want;
+      if(_total > _peak) _peak = _total;
+      return true;
+    }
+
+  public:
+    AsyncJsonArena() : _head(NULL), _total(0), _peak(0) {}
+    ~AsyncJsonArena(){ release(); }
+
+    void* allocate(size_t size) override {
+      size_t need = ALIGN + _align(size);
+      if((_head == NULL || need > _head->size - _head->used) && !_grow(need))
+        return nullptr;
+      uint8_t* block = _data(_head) + _head->used + ALIGN;
+      _head->used += need;
+      _sizeOf(block) = _align(size);
+      return block;
+    }
+
+    void deallocate(void* ptr) override {
+      if(ptr && _isLast(ptr))
+        _head->used -= ALIGN + _sizeOf(ptr);
+    }
+
+    void* reallocate(void* ptr, size_t new_size) override {
+      if(!ptr)
+        return allocate(new_size);
+      size_t aligned = _align(new_size);
+      if(_isLast(ptr)){
+        size_t start = (uint8_t*)ptr - _data(_head);
+        if(aligned <= _head->size - start){
+          _sizeOf(ptr) = aligned;
+          _head->used = start + aligned;
+          return ptr;
+        }
+      }
+      void* moved = allocate(new_size);
+      if(moved)
+        memcpy(moved, ptr, (_sizeOf(ptr) < aligned) ? _sizeOf(ptr) : aligned);
+      return moved;
+    }
+
+    void release(){
+      while(_head != NULL){
+        Chunk* c = _head;
+        _head = c->next;
+        free(c);
+      }
+      _total = 0;
+    }
+
+    size_t used() const { return _total; }
+    size_t peak() const { return _peak; }
+};
+
+class AsyncJsonStreamResponse: public AsyncAbstractResponse {
+  private:
+    AsyncJsonArena _arena;
+    JsonDocument _doc;
+    uint8_t* _text;   // The body, serialized once by _respond()
+
+  public:
+    AsyncJsonStreamResponse(int code=200) : _arena(), _doc(&_arena), _text(NULL) {
+      _code = code;
+      _contentType = JSON_MIMETYPE;
+    }
+    ~AsyncJsonStreamResponse(){ free(_text); }
+
+    JsonDocument& document() { return _doc; }
+    size_t arenaPeak() const { return _arena.peak(); }
+
+    // A document that ran out of arena is incomplete: answer 500 instead of truncated JSON
+    bool _sourceValid() const { return !_doc.overflowed(); }
+
+    void _respond(AsyncWebServerRequest *request){
+      _contentLength = measureJson(_doc);
+      _text = (uint8_t*)malloc(_contentLength + 1);   // serializeJson() adds a NUL
+      if(_text){
+        serializeJson(_doc, (char*)_text, _contentLength + 1);
+        _doc.clear();
+        _arena.release();
+      }
+      AsyncAbstractResponse::_respond(request);
+    }
+
+    size_t _fillBuffer(uint8_t *data, size_t len){
+      if(len > _contentLength - _sentLength)
+        len = _contentLength - _sentLength;
+      if(_text){
+        memcpy(data, _text + _sentLength, len);
+        return len;
+      }
+      // No heap for the text: serialize again for each window, skipping what was sent
+      ChunkPrint dest(data, _sentLength, len);
+      serializeJson(_doc, dest);
+      return len;
+    }
+};
+#endif
+
 typedef std::function<void(AsyncWebServerRequest *request, JsonVariant &json)> ArJsonRequestHandlerFunction;
 
 class AsyncCallbackJsonWebHandler: public AsyncWebHandler {
@@ -195,6 +353,8 @@ public:
   void setMaxContentLength(int maxContentLength){ _maxContentLength = maxContentLength; }
   void onRequest(ArJsonRequestHandlerFunction fn){ _onRequest = fn; }
 
+  virtual const char* _statsLabel() const override { return _uri.c_str(); }
+
   virtual bool canHandle(AsyncWebServerRequest *request) override final{
     if(!_onRequest)
       return false;
@@ -208,7 +368,6 @@ public:
     if ( !request->contentType().equalsIgnoreCase(JSON_MIMETYPE) )
       return false;
 
-    request->addInterestingHeader("ANY");
     return true;
   }
 
@@ -242,10 +401,13 @@ public:
     if (_onRequest) {
       _contentLength = total;
       if (total > 0 && request->_tempObject == NULL && total < _maxContentLength) {
-        request->_tempObject = malloc(total);
+        request->_tempObject = malloc(total + 1);
       }
       if (request->_tempObject != NULL) {
         memcpy((uint8_t*)(request->_tempObject) + index, data, len);
+        // deserializeJson() reads up to the terminator
+        if (index + len == total)
+          ((uint8_t*)(request->_tempObject))[total] = 0;
       }
     }
   }
@@ -0,0 +1,131 @@
+/*
+  Asynchronous WebServer library for Espressif MCUs
+
+  Copyright (c) 2016 Hristo Gochkov. All rights reserved.
+  This file is part of the esp8266 core for Arduino environment.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef ASYNCWEBARENA_H_
+#define ASYNCWEBARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bounds for the first chunk, which is sized from the first packet of a request
+#ifndef ASYNCWEB_ARENA_MIN_CHUNK
+#define ASYNCWEB_ARENA_MIN_CHUNK 256
+#endif
+#ifndef ASYNCWEB_ARENA_MAX_CHUNK
+#define ASYNCWEB_ARENA_MAX_CHUNK 1536
+#endif
+
+typedef struct {
+  uint32_t arenas;    // arenas released since boot
+  uint32_t chunks;    // chunk allocations since boot
+  uint32_t failed;    // chunk allocations that returned NULL
+  size_t liveBytes;   // chunk bytes held by requests that are still connected
+  size_t peakBytes;   // high-water mark of liveBytes
+} AsyncWebArenaStats;
+
+/*
+ * ARENA :: Bump allocator that owns the parse-time strings of one request.
+ * Nothing is freed individually; release() hands every chunk back at once.
+ * */
+
+class AsyncWebArena {
+  private:
+    struct Chunk {
+      Chunk* next;
+      size_t size;
+      size_t used;
+    };
+
+    Chunk* _head;
+    size_t _chunkSize;
+    size_t _total;
+
+    static AsyncWebArenaStats _stats;
+
+    bool _grow(size_t size){
+      size_t want = size > _chunkSize ? size : _chunkSize;
+      Chunk* c = (Chunk*)malloc(sizeof(Chunk) + want);
+      if(c == NULL){
+        _stats.failed++;
+        return false;
+      }
+      c->next = _head;
+      c->size = want;
+      c->used = 0;
+      _head = c;
+      _total += want;
+      _stats.chunks++;
+      _stats.liveBytes += want;
+      if(_stats.liveBytes > _stats.peakBytes)
+        _stats.peakBytes = _stats.liveBytes;
+      return true;
+    }
+
+  public:
+    AsyncWebArena(): _head(NULL), _chunkSize(ASYNCWEB_ARENA_MIN_CHUNK), _total(0) {}
+    ~AsyncWebArena(){ release(); }
+
+    // Sizes the chunks from the first packet; has no effect once memory is held
+    void sizeFor(size_t len){
+      if(_head != NULL) return;
+      if(len < ASYNCWEB_ARENA_MIN_CHUNK) len = ASYNCWEB_ARENA_MIN_CHUNK;
+      if(len > ASYNCWEB_ARENA_MAX_CHUNK) len = ASYNCWEB_ARENA_MAX_CHUNK;
+      _chunkSize = (len + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    }
+
+    // Rounded to pointer size so header records can share chunks with strings
+    void* alloc(size_t size){
+      size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+      if(_head == NULL || _head->size - _head->used < size){
+        if(!_grow(size)) return NULL;
+      }
+      void* p = (uint8_t*)(_head + 1) + _head->used;
+      _head->used += size;
+      return p;
+    }
+
+    // NUL-terminated copy of len bytes of data
+    char* copy(const char* data, size_t len){
+      char* p = (char*)alloc(len + 1);
+      if(p == NULL) return NULL;
+      memcpy(p, data, len);
+      p[len] = 0;
+      return p;
+    }
+
+    void release(){
+      if(_head == NULL) return;
+      while(_head != NULL){
+        Chunk* c = _head;
+        _head = c->next;
+        free(c);
+      }
+      _stats.liveBytes -= _total;
+      _stats.arenas++;
+      _total = 0;
+    }
+
+    size_t capacity() const { return _total; }
+    static const AsyncWebArenaStats& stats(){ return _stats; }
+};
+
+#endif /* ASYNCWEBARENA_H_ */
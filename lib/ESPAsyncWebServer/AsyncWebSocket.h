@@ -323,6 +323,7 @@ class AsyncWebSocket: public AsyncWebHandler {
     void _handleEvent(AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len);
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual const char* _statsLabel() const override { return _url.c_str(); }
 
 
     //  messagebuffer functions/objects. 
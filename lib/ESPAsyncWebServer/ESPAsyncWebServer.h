@@ -24,9 +24,11 @@
 #include "Arduino.h"
 
 #include <functional>
+#include <atomic>
 #include "FS.h"
 
 #include "StringArray.h"
+#include "AsyncWebArena.h"
 
 #ifdef ESP32
 #include <WiFi.h>
@@ -91,6 +93,7 @@ class AsyncWebParameter {
   public:
 
     AsyncWebParameter(const String& name, const String& value, bool form=false, bool file=false, size_t size=0): _name(name), _value(value), _size(size), _isForm(form), _isFile(file){}
+    AsyncWebParameter(const char* name, const char* value, bool form=false, bool file=false, size_t size=0): _name(name), _value(value), _size(size), _isForm(form), _isFile(file){}
     const String& name() const { return _name; }
     const String& value() const { return _value; }
     size_t size() const { return _size; }
@@ -109,6 +112,7 @@ class AsyncWebHeader {
 
   public:
     AsyncWebHeader(const String& name, const String& value): _name(name), _value(value){}
+    AsyncWebHeader(const char* name, const char* value): _name(name), _value(value){}
     AsyncWebHeader(const String& data): _name(), _value(){
       if(!data) return;
       int index = data.indexOf(':');
@@ -128,8 +132,29 @@ class AsyncWebHeader {
 
 typedef enum { RCT_NOT_USED = -1, RCT_DEFAULT = 0, RCT_HTTP, RCT_WS, RCT_EVENT, RCT_MAX } RequestedConnectionType;
 
+// A received header line, kept in the request arena for the whole request.
+// The heap AsyncWebHeader is only made when a handler asks for the object.
+struct AsyncWebRawHeader {
+  const char* name;
+  const char* value;
+  AsyncWebRawHeader* next;
+  AsyncWebHeader* kept;
+};
+
+// A decoded query, form or multipart parameter, kept the same way
+struct AsyncWebRawParam {
+  const char* name;
+  const char* value;
+  size_t size;
+  bool post;
+  bool file;
+  AsyncWebRawParam* next;
+  AsyncWebParameter* kept;
+};
+
 typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
 typedef std::function<String(const String&)> AwsTemplateProcessor;
+typedef std::function<String(const String&)> AwsETagProvider;
 
 class AsyncWebServerRequest {
   using File = fs::File;
@@ -141,7 +166,6 @@ class AsyncWebServerRequest {
     AsyncWebServer* _server;
     AsyncWebHandler* _handler;
     AsyncWebServerResponse* _response;
-    StringArray _interestingHeaders;
     ArDisconnectHandler _onDisconnectfn;
 
     String _temp;
@@ -155,7 +179,6 @@ class AsyncWebServerRequest {
     String _boundary;
     String _authorization;
     RequestedConnectionType _reqconntype;
-    void _removeNotInterestingHeaders();
     bool _isDigest;
     bool _isMultipart;
     bool _isPlainPost;
@@ -163,8 +186,14 @@ class AsyncWebServerRequest {
     size_t _contentLength;
     size_t _parsedLength;
 
-    LinkedList<AsyncWebHeader *> _headers;
-    LinkedList<AsyncWebParameter *> _params;
+    AsyncWebArena _arena;
+    uint32_t _startUs;
+    AsyncWebRawHeader* _rawHeaders;
+    AsyncWebRawHeader* _rawHeadersTail;
+    AsyncWebRawParam* _rawParams;
+    AsyncWebRawParam* _rawParamsTail;
+    mutable LinkedList<AsyncWebHeader *> _headers;     // Owns the header objects handed out so far
+    mutable LinkedList<AsyncWebParameter *> _params;   // Owns the parameter objects handed out so far
     LinkedList<String *> _pathParams;
 
     uint8_t _multiParseState;
@@ -186,7 +215,9 @@ class AsyncWebServerRequest {
     void _onDisconnect();
     void _onData(void *buf, size_t len);
 
-    void _addParam(AsyncWebParameter*);
+    void _addParam(const char* name, const char* value, bool post=false, bool file=false, size_t size=0);
+    AsyncWebHeader* _keep(AsyncWebRawHeader* h) const;
+    AsyncWebParameter* _keep(AsyncWebRawParam* p) const;
     void _addPathParam(const char *param);
 
     bool _parseReqHead();
@@ -195,6 +226,8 @@ class AsyncWebServerRequest {
     void _parsePlainPostChar(uint8_t data);
     void _parseMultipartPostByte(uint8_t data, bool last);
     void _addGetParams(const String& params);
+    void _addGetParams(const char* params, size_t len);
+    char* _arenaDecode(const char* text, size_t len);
 
     void _handleUploadStart();
     void _handleUploadByte(uint8_t data, bool last);
@@ -229,7 +262,9 @@ class AsyncWebServerRequest {
     void requestAuthentication(const char * realm = NULL, bool isDigest = true);
 
     void setHandler(AsyncWebHandler *handler){ _handler = handler; }
-    void addInterestingHeader(const String& name);
+    // Every header stays readable for the whole request, so there is nothing to declare;
+    // kept for handlers written against the old API
+    void addInterestingHeader(const String& name){ (void)name; }
 
     void redirect(const String& url);
 
@@ -323,6 +358,52 @@ class AsyncWebRewrite {
     virtual bool match(AsyncWebServerRequest *request) { return from() == request->url() && filter(request); }
 };
 
+/*
+ * ROUTE STATS :: Requests and latency per handler, from accept to the connection
+ * being closed or handed over (WebSocket, EventSource). Updated lock-free.
+ * */
+
+#define ASYNCWEB_LATENCY_BUCKETS 8
+
+// Upper bounds of the latency buckets in microseconds; the last bucket is +Inf
+static const uint32_t AsyncWebLatencyBoundsUs[ASYNCWEB_LATENCY_BUCKETS - 1] = {
+  5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+typedef struct {
+  uint32_t requests;
+  uint64_t sumUs;                                 // 32 bits would wrap after ~71 min of summed latency
+  uint32_t buckets[ASYNCWEB_LATENCY_BUCKETS];     // per bucket, not cumulative
+} AsyncWebRouteSnapshot;
+
+class AsyncWebRouteStats {
+  private:
+    std::atomic<uint32_t> _requests;
+    std::atomic<uint64_t> _sumUs;
+    std::atomic<uint32_t> _buckets[ASYNCWEB_LATENCY_BUCKETS];
+  public:
+    AsyncWebRouteStats(): _requests(0), _sumUs(0) {
+      for(size_t i = 0; i < ASYNCWEB_LATENCY_BUCKETS; i++)
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    void record(uint32_t us){
+      size_t i = 0;
+      while(i < ASYNCWEB_LATENCY_BUCKETS - 1 && us > AsyncWebLatencyBoundsUs[i])
+        i++;
+      _buckets[i].fetch_add(1, std::memory_order_relaxed);
+      _sumUs.fetch_add(us, std::memory_order_relaxed);
+      _requests.fetch_add(1, std::memory_order_relaxed);
+    }
+    void addTo(AsyncWebRouteSnapshot& s) const {
+      s.requests += _requests.load(std::memory_order_relaxed);
+      s.sumUs += _sumUs.load(std::memory_order_relaxed);
+      for(size_t i = 0; i < ASYNCWEB_LATENCY_BUCKETS; i++)
+        s.buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+    }
+};
+
+typedef std::function<void(const char* route, const AsyncWebRouteSnapshot& stats)> ArRouteStatsFunction;
+
 /*
  * HANDLER :: One instance can be attached to any Request (done by the Server)
  * */
@@ -333,6 +414,7 @@ class AsyncWebHandler {
     String _username;
     String _password;
   public:
+    AsyncWebRouteStats _stats;
     AsyncWebHandler():_username(""), _password(""){}
     AsyncWebHandler& setFilter(ArRequestFilterFunction fn) { _filter = fn; return *this; }
     AsyncWebHandler& setAuthentication(const char *username, const char *password){  _username = String(username);_password = String(password); return *this; };
@@ -345,6 +427,11 @@ class AsyncWebHandler {
     virtual void handleUpload(AsyncWebServerRequest *request  __attribute__((unused)), const String& filename __attribute__((unused)), size_t index __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), bool final  __attribute__((unused))){}
     virtual void handleBody(AsyncWebServerRequest *request __attribute__((unused)), uint8_t *data __attribute__((unused)), size_t len __attribute__((unused)), size_t index __attribute__((unused)), size_t total __attribute__((unused))){}
     virtual bool isRequestHandlerTrivial(){return true;}
+    // Path this handler answers for (itself and its subpaths), if that is all canHandle() looks at
+    // besides method/filter. Such handlers are dispatched from the server's route index.
+    virtual const String* _routeUri() const { return NULL; }
+    // Name of this handler in route statistics; handlers sharing a name are reported together
+    virtual const char* _statsLabel() const { const String* uri = _routeUri(); return uri ? uri->c_str() : NULL; }
 };
 
 /*
@@ -394,12 +481,18 @@ typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunc
 typedef std::function<void(AsyncWebServerRequest *request, const String& filename, size_t index, uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
 typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
 
+struct AsyncWebRouteIndex;
+
 class AsyncWebServer {
   protected:
     AsyncServer _server;
     LinkedList<AsyncWebRewrite*> _rewrites;
     LinkedList<AsyncWebHandler*> _handlers;
     AsyncCallbackWebHandler* _catchAllHandler;
+    AsyncWebRouteIndex* _routeIndex; // rebuilt whenever the handler list changes
+    bool _routesDirty;
+
+    void _buildRouteIndex();
 
   public:
     AsyncWebServer(uint16_t port);
@@ -432,6 +525,9 @@ class AsyncWebServer {
     void onRequestBody(ArBodyHandlerFunction fn); //handle posts with plain body content (JSON often transmitted this way as a request)
 
     void reset(); //remove all writers and handlers, with onNotFound/onFileUpload/onRequestBody 
+
+    // Calls fn once per distinct handler label, then once for "notFound"
+    void routeStats(ArRouteStatsFunction fn) const;
   
     void _handleDisconnect(AsyncWebServerRequest *request);
     void _attachHandler(AsyncWebServerRequest *request);
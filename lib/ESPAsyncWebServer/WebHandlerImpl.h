@@ -42,15 +42,19 @@ class AsyncStaticWebHandler: public AsyncWebHandler {
     String _path;
     String _default_file;
     String _cache_control;
+    String _versioned_cache_control;
     String _last_modified;
     AwsTemplateProcessor _callback;
+    AwsETagProvider _etagProvider;
     bool _isDir;
     bool _gzipFirst;
+    bool _gzipPinned;
     uint8_t _gzipStats;
   public:
     AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cache_control);
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
+    virtual const char* _statsLabel() const override { return "static"; }
     AsyncStaticWebHandler& setIsDir(bool isDir);
     AsyncStaticWebHandler& setDefaultFile(const char* filename);
     AsyncStaticWebHandler& setCacheControl(const char* cache_control);
@@ -61,6 +65,12 @@ class AsyncStaticWebHandler: public AsyncWebHandler {
     AsyncStaticWebHandler& setLastModified(); //sets to current time. Make sure sntp is runing and time is updated
   #endif
     AsyncStaticWebHandler& setTemplateProcessor(AwsTemplateProcessor newCallback) {_callback = newCallback; return *this;}
+    // Always look for the .gz variant first instead of guessing from previous requests
+    AsyncStaticWebHandler& setGzipFirst(bool gzipFirst);
+    // Strong ETag from a content hash; the provider gets the file path and returns the hash or ""
+    AsyncStaticWebHandler& setETagProvider(AwsETagProvider provider) {_etagProvider = provider; return *this;}
+    // Cache-Control used instead of the default one when the request carries ?v=<content hash>
+    AsyncStaticWebHandler& setVersionedCacheControl(const char* cache_control);
 };
 
 class AsyncCallbackWebHandler: public AsyncWebHandler {
@@ -118,13 +128,19 @@ class AsyncCallbackWebHandler: public AsyncWebHandler {
         if (!request->url().startsWith(uriTemplate))
           return false;
       }
-      else if(_uri.length() && (_uri != request->url() && !request->url().startsWith(_uri+"/")))
+      else if(_uri.length() && _uri != request->url()
+        && !(request->url().length() > _uri.length() && request->url().charAt(_uri.length()) == '/' && request->url().startsWith(_uri)))
         return false;
 
-      request->addInterestingHeader("ANY");
       return true;
     }
   
+    virtual const String* _routeUri() const override final {
+      if(!_uri.length() || _isRegex || _uri.indexOf('*') >= 0)
+        return NULL;
+      return &_uri;
+    }
+
     virtual void handleRequest(AsyncWebServerRequest *request) override final {
       if((_username != "" && _password != "") && !request->authenticate(_username.c_str(), _password.c_str()))
         return request->requestAuthentication();
@@ -22,7 +22,7 @@
 #include "WebHandlerImpl.h"
 
 AsyncStaticWebHandler::AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cache_control)
-  : _fs(fs), _uri(uri), _path(path), _default_file("index.htm"), _cache_control(cache_control), _last_modified(""), _callback(nullptr)
+  : _fs(fs), _uri(uri), _path(path), _default_file("index.htm"), _cache_control(cache_control), _last_modified(""), _callback(nullptr), _etagProvider(nullptr)
 {
   // Ensure leading '/'
   if (_uri.length() == 0 || _uri[0] != '/') _uri = "/" + _uri;
@@ -39,9 +39,21 @@ AsyncStaticWebHandler::AsyncStaticWebHandler(const char* uri, FS& fs, const char
 
   // Reset stats
   _gzipFirst = false;
+  _gzipPinned = false;
   _gzipStats = 0xF8;
 }
 
+AsyncStaticWebHandler& AsyncStaticWebHandler::setGzipFirst(bool gzipFirst){
+  _gzipFirst = gzipFirst;
+  _gzipPinned = true;
+  return *this;
+}
+
+AsyncStaticWebHandler& AsyncStaticWebHandler::setVersionedCacheControl(const char* cache_control){
+  _versioned_cache_control = String(cache_control);
+  return *this;
+}
+
 AsyncStaticWebHandler& AsyncStaticWebHandler::setIsDir(bool isDir){
   _isDir = isDir;
   return *this;
@@ -92,9 +104,12 @@ bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request){
     if (_last_modified.length())
       request->addInterestingHeader("If-Modified-Since");
 
-    if(_cache_control.length())
+    if(_cache_control.length() || _etagProvider)
       request->addInterestingHeader("If-None-Match");
 
+    // Needed to fall back to the plain file for clients without gzip support
+    request->addInterestingHeader("Accept-Encoding");
+
     DEBUGF("[AsyncStaticWebHandler::canHandle] TRUE\n");
     return true;
   }
@@ -167,6 +182,7 @@ bool AsyncStaticWebHandler::_fileExists(AsyncWebServerRequest *request, const St
     request->_tempObject = (void*)_tempPath;
 
     // Calculate gzip statistic
+    if (_gzipPinned) return true;
     _gzipStats = (_gzipStats << 1) + (gzipFound ? 1 : 0);
     if (_gzipStats == 0x00) _gzipFirst = false; // All files are not gzip
     else if (_gzipStats == 0xFF) _gzipFirst = true; // All files are gzip
@@ -194,24 +210,49 @@ void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request)
       return request->requestAuthentication();
 
   if (request->_tempFile == true) {
-    String etag = String(request->_tempFile.size());
+    bool gzipped = String(request->_tempFile.name()).endsWith(".gz") && !filename.endsWith(".gz");
+    bool fellBack = false;
+
+    // Serve the plain file to clients that explicitly do not accept gzip
+    if (gzipped && request->hasHeader("Accept-Encoding") && request->header("Accept-Encoding").indexOf("gzip") < 0) {
+      File plain = _fs.open(filename, "r");
+      if (FILE_IS_REAL(plain)) {
+        request->_tempFile.close();
+        request->_tempFile = plain;
+        gzipped = false;
+        fellBack = true;
+      }
+    }
+
+    // The content hash describes the served variant; a fallback variant gets the size-based tag
+    String hash = (_etagProvider && !fellBack) ? _etagProvider(filename) : String();
+    String etag = hash.length() ? "\"" + hash + "\"" : String(request->_tempFile.size());
+
+    String cacheControl = _cache_control;
+    if (hash.length() && _versioned_cache_control.length() && request->hasParam("v") && request->getParam("v")->value() == hash)
+      cacheControl = _versioned_cache_control;
+    bool sendETag = cacheControl.length() || hash.length();
+
     if (_last_modified.length() && _last_modified == request->header("If-Modified-Since")) {
       request->_tempFile.close();
       request->send(304); // Not modified
-    } else if (_cache_control.length() && request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag)) {
+    } else if (sendETag && request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag)) {
       request->_tempFile.close();
       AsyncWebServerResponse * response = new AsyncBasicResponse(304); // Not modified
-      response->addHeader("Cache-Control", _cache_control);
+      if (cacheControl.length())
+        response->addHeader("Cache-Control", cacheControl);
       response->addHeader("ETag", etag);
       request->send(response);
     } else {
       AsyncWebServerResponse * response = new AsyncFileResponse(request->_tempFile, filename, String(), false, _callback);
       if (_last_modified.length())
         response->addHeader("Last-Modified", _last_modified);
-      if (_cache_control.length()){
-        response->addHeader("Cache-Control", _cache_control);
+      if (cacheControl.length())
+        response->addHeader("Cache-Control", cacheControl);
+      if (sendETag)
         response->addHeader("ETag", etag);
-      }
+      if (gzipped || fellBack)
+        response->addHeader("Vary", "Accept-Encoding");
       request->send(response);
     }
   } else {
@@ -28,6 +28,8 @@
 
 static const String SharedEmptyString = String();
 
+AsyncWebArenaStats AsyncWebArena::_stats = { 0, 0, 0, 0, 0 };
+
 #define __is_param_char(c) ((c) && ((c) != '{') && ((c) != '[') && ((c) != '&') && ((c) != '='))
 
 enum { PARSE_REQ_START, PARSE_REQ_HEADERS, PARSE_REQ_BODY, PARSE_REQ_END, PARSE_REQ_FAIL };
@@ -53,6 +55,12 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
   , _expectingContinue(false)
   , _contentLength(0)
   , _parsedLength(0)
+  , _arena()
+  , _startUs(micros())
+  , _rawHeaders(NULL)
+  , _rawHeadersTail(NULL)
+  , _rawParams(NULL)
+  , _rawParamsTail(NULL)
   , _headers(LinkedList<AsyncWebHeader *>([](AsyncWebHeader *h){ delete h; }))
   , _params(LinkedList<AsyncWebParameter *>([](AsyncWebParameter *p){ delete p; }))
   , _pathParams(LinkedList<String *>([](String *p){ delete p; }))
@@ -78,13 +86,14 @@ AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* s, AsyncClient* c)
 }
 
 AsyncWebServerRequest::~AsyncWebServerRequest(){
+  if(_handler)
+    _handler->_stats.record(micros() - _startUs);
+
   _headers.free();
 
   _params.free();
   _pathParams.free();
 
-  _interestingHeaders.free();
-
   if(_response != NULL){
     delete _response;
   }
@@ -96,6 +105,8 @@ AsyncWebServerRequest::~AsyncWebServerRequest(){
   if(_tempFile){
     _tempFile.close();
   }
+
+  _arena.release();
 }
 
 void AsyncWebServerRequest::_onData(void *buf, size_t len){
@@ -103,6 +114,8 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
   while (true) {
 
   if(_parseState < PARSE_REQ_BODY){
+    // The first packet normally carries the whole head, so it sizes the arena
+    _arena.sizeFor(len);
     // Find new line in buf
     char *str = (char*)buf;
     for (i = 0; i < len; i++) {
@@ -178,15 +191,6 @@ void AsyncWebServerRequest::_onData(void *buf, size_t len){
   }
 }
 
-void AsyncWebServerRequest::_removeNotInterestingHeaders(){
-  if (_interestingHeaders.containsIgnoreCase("ANY")) return; // nothing to do
-  for(const auto& header: _headers){
-      if(!_interestingHeaders.containsIgnoreCase(header->name().c_str())){
-        _headers.remove(header);
-      }
-  }
-}
-
 void AsyncWebServerRequest::_onPoll(){
   //os_printf("p\n");
   if(_response != NULL && _client != NULL && _client->canSend() && !_response->_finished()){
@@ -229,8 +233,37 @@ void AsyncWebServerRequest::_onDisconnect(){
   _server->_handleDisconnect(this);
 }
 
-void AsyncWebServerRequest::_addParam(AsyncWebParameter *p){
-  _params.add(p);
+void AsyncWebServerRequest::_addParam(const char* name, const char* value, bool post, bool file, size_t size){
+  // name and value are arena text; the record joins them there
+  AsyncWebRawParam* raw = (AsyncWebRawParam*)_arena.alloc(sizeof(AsyncWebRawParam));
+  if(name == NULL || value == NULL || raw == NULL) return;
+  raw->name = name;
+  raw->value = value;
+  raw->size = size;
+  raw->post = post;
+  raw->file = file;
+  raw->next = NULL;
+  raw->kept = NULL;
+  if(_rawParamsTail != NULL) _rawParamsTail->next = raw;
+  else _rawParams = raw;
+  _rawParamsTail = raw;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::_keep(AsyncWebRawHeader* h) const {
+  // A handler asked for the object: copy this one header to the heap, once
+  if(h != NULL && h->kept == NULL){
+    h->kept = new AsyncWebHeader(h->name, h->value);
+    _headers.add(h->kept);
+  }
+  return h ? h->kept : nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::_keep(AsyncWebRawParam* p) const {
+  if(p != NULL && p->kept == NULL){
+    p->kept = new AsyncWebParameter(p->name, p->value, p->post, p->file, p->size);
+    _params.add(p->kept);
+  }
+  return p ? p->kept : nullptr;
 }
 
 void AsyncWebServerRequest::_addPathParam(const char *p){
@@ -238,63 +271,93 @@ void AsyncWebServerRequest::_addPathParam(const char *p){
 }
 
 void AsyncWebServerRequest::_addGetParams(const String& params){
+  _addGetParams(params.c_str(), params.length());
+}
+
+void AsyncWebServerRequest::_addGetParams(const char* params, size_t len){
   size_t start = 0;
-  while (start < params.length()){
-    int end = params.indexOf('&', start);
-    if (end < 0) end = params.length();
-    int equal = params.indexOf('=', start);
-    if (equal < 0 || equal > end) equal = end;
-    String name = params.substring(start, equal);
-    String value = equal + 1 < end ? params.substring(equal + 1, end) : String();
-    _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value)));
+  while (start < len){
+    const char* amp = (const char*)memchr(params + start, '&', len - start);
+    size_t end = amp ? amp - params : len;
+    const char* eq = (const char*)memchr(params + start, '=', end - start);
+    size_t equal = eq ? eq - params : end;
+    char* name = _arenaDecode(params + start, equal - start);
+    char* value = _arenaDecode(params + equal + 1, equal + 1 < end ? end - equal - 1 : 0);
+    _addParam(name, value);
     start = end + 1;
   }
 }
 
+char* AsyncWebServerRequest::_arenaDecode(const char* text, size_t len){
+  // Decoding never grows the text, so len+1 bytes are always enough
+  char* decoded = (char*)_arena.alloc(len + 1);
+  if(decoded == NULL) return NULL;
+  char temp[] = "0x00";
+  size_t i = 0;
+  size_t o = 0;
+  while (i < len){
+    char encodedChar = text[i++];
+    if ((encodedChar == '%') && (i + 1 < len)){
+      temp[2] = text[i++];
+      temp[3] = text[i++];
+      decoded[o++] = strtol(temp, NULL, 16);
+    } else if (encodedChar == '+') {
+      decoded[o++] = ' ';
+    } else {
+      decoded[o++] = encodedChar;
+    }
+  }
+  decoded[o] = 0;
+  return decoded;
+}
+
 bool AsyncWebServerRequest::_parseReqHead(){
-  // Split the head into method, url and version
-  int index = _temp.indexOf(' ');
-  String m = _temp.substring(0, index);
-  index = _temp.indexOf(' ', index+1);
-  String u = _temp.substring(m.length()+1, index);
-  _temp = _temp.substring(index+1);
-
-  if(m == "GET"){
+  // Split the head into method, url and version without temporary Strings
+  const char* line = _temp.c_str();
+  const char* sp1 = strchr(line, ' ');
+  if(sp1 == NULL) sp1 = line + _temp.length();
+  const char* u = *sp1 ? sp1 + 1 : sp1;
+  const char* sp2 = strchr(u, ' ');
+  if(sp2 == NULL) sp2 = line + _temp.length();
+  const char* v = *sp2 ? sp2 + 1 : sp2;
+  size_t m = sp1 - line;
+
+  if(m == 3 && !strncmp(line, "GET", 3)){
     _method = HTTP_GET;
-  } else if(m == "POST"){
+  } else if(m == 4 && !strncmp(line, "POST", 4)){
     _method = HTTP_POST;
-  } else if(m == "DELETE"){
+  } else if(m == 6 && !strncmp(line, "DELETE", 6)){
     _method = HTTP_DELETE;
-  } else if(m == "PUT"){
+  } else if(m == 3 && !strncmp(line, "PUT", 3)){
     _method = HTTP_PUT;
-  } else if(m == "PATCH"){
+  } else if(m == 5 && !strncmp(line, "PATCH", 5)){
     _method = HTTP_PATCH;
-  } else if(m == "HEAD"){
+  } else if(m == 4 && !strncmp(line, "HEAD", 4)){
     _method = HTTP_HEAD;
-  } else if(m == "OPTIONS"){
+  } else if(m == 7 && !strncmp(line, "OPTIONS", 7)){
     _method = HTTP_OPTIONS;
   }
 
-  String g = String();
-  index = u.indexOf('?');
-  if(index > 0){
-    g = u.substring(index +1);
-    u = u.substring(0, index);
-  }
-  _url = urlDecode(u);
-  _addGetParams(g);
+  size_t ulen = sp2 - u;
+  const char* q = (const char*)memchr(u, '?', ulen);
+  size_t plen = (q != NULL && q > u) ? q - u : ulen;
+  char* path = _arenaDecode(u, plen);
+  if(path != NULL)
+    _url = path;
+  if(plen < ulen)
+    _addGetParams(u + plen + 1, ulen - plen - 1);
 
-  if(!_temp.startsWith("HTTP/1.0"))
+  if(strncmp(v, "HTTP/1.0", 8))
     _version = 1;
 
   _temp = String();
   return true;
 }
 
-bool strContains(String src, String find, bool mindcase = true) {
+bool strContains(const char* src, const char* find, bool mindcase = true) {
   int pos=0, i=0;
-  const int slen = src.length();
-  const int flen = find.length();
+  const int slen = strlen(src);
+  const int flen = strlen(find);
 
   if (slen < flen) return false;
   while (pos <= (slen - flen)) {
@@ -309,43 +372,74 @@ bool strContains(String src, String find, bool mindcase = true) {
   return false;
 }
 
+bool strContains(String src, String find, bool mindcase = true) {
+  return strContains(src.c_str(), find.c_str(), mindcase);
+}
+
 bool AsyncWebServerRequest::_parseReqHeader(){
-  int index = _temp.indexOf(':');
-  if(index){
-    String name = _temp.substring(0, index);
-    String value = _temp.substring(index + 2);
-    if(name.equalsIgnoreCase("Host")){
+  const char* line = _temp.c_str();
+  const char* colon = strchr(line, ':');
+  if(colon != NULL && colon != line){
+    // name and value live in the arena for the whole request
+    size_t vstart = colon - line + 2;
+    if(vstart > _temp.length()) vstart = _temp.length();
+    char* name = _arena.copy(line, colon - line);
+    char* value = _arena.copy(line + vstart, _temp.length() - vstart);
+    AsyncWebRawHeader* raw = (AsyncWebRawHeader*)_arena.alloc(sizeof(AsyncWebRawHeader));
+    if(name == NULL || value == NULL || raw == NULL){
+      _temp = String();
+      return false;
+    }
+    if(!strcasecmp(name, "Host")){
       _host = value;
-    } else if(name.equalsIgnoreCase("Content-Type")){
-	  _contentType = value.substring(0, value.indexOf(';'));
-      if (value.startsWith("multipart/")){
-        _boundary = value.substring(value.indexOf('=')+1);
-        _boundary.replace("\"","");
+    } else if(!strcasecmp(name, "Content-Type")){
+      const char* semi = strchr(value, ';');
+      char* type = semi ? _arena.copy(value, semi - value) : value;
+      if(type != NULL) _contentType = type;
+      if (!strncmp(value, "multipart/", 10)){
+        const char* eq = strchr(value, '=');
+        const char* src = eq ? eq + 1 : value;
+        char* boundary = (char*)_arena.alloc(strlen(src) + 1);
+        if(boundary != NULL){
+          char* dst = boundary;
+          for(; *src; src++){
+            if(*src != '"') *dst++ = *src;
+          }
+          *dst = 0;
+          _boundary = boundary;
+        }
         _isMultipart = true;
       }
-    } else if(name.equalsIgnoreCase("Content-Length")){
-      _contentLength = atoi(value.c_str());
-    } else if(name.equalsIgnoreCase("Expect") && value == "100-continue"){
+    } else if(!strcasecmp(name, "Content-Length")){
+      _contentLength = atoi(value);
+    } else if(!strcasecmp(name, "Expect") && !strcmp(value, "100-continue")){
       _expectingContinue = true;
-    } else if(name.equalsIgnoreCase("Authorization")){
-      if(value.length() > 5 && value.substring(0,5).equalsIgnoreCase("Basic")){
-        _authorization = value.substring(6);
-      } else if(value.length() > 6 && value.substring(0,6).equalsIgnoreCase("Digest")){
+    } else if(!strcasecmp(name, "Authorization")){
+      size_t vlen = strlen(value);
+      if(vlen > 5 && !strncasecmp(value, "Basic", 5)){
+        _authorization = value + 6;
+      } else if(vlen > 6 && !strncasecmp(value, "Digest", 6)){
         _isDigest = true;
-        _authorization = value.substring(7);
+        _authorization = value + 7;
       }
     } else {
-      if(name.equalsIgnoreCase("Upgrade") && value.equalsIgnoreCase("websocket")){
+      if(!strcasecmp(name, "Upgrade") && !strcasecmp(value, "websocket")){
         // WebSocket request can be uniquely identified by header: [Upgrade: websocket]
         _reqconntype = RCT_WS;
       } else {
-        if(name.equalsIgnoreCase("Accept") && strContains(value, "text/event-stream", false)){
+        if(!strcasecmp(name, "Accept") && strContains(value, "text/event-stream", false)){
           // WebEvent request can be uniquely identified by header:  [Accept: text/event-stream]
           _reqconntype = RCT_EVENT;
         }
       }
     }
-    _headers.add(new AsyncWebHeader(name, value));
+    raw->name = name;
+    raw->value = value;
+    raw->next = NULL;
+    raw->kept = NULL;
+    if(_rawHeadersTail != NULL) _rawHeadersTail->next = raw;
+    else _rawHeaders = raw;
+    _rawHeadersTail = raw;
   }
   _temp = String();
   return true;
@@ -355,13 +449,19 @@ void AsyncWebServerRequest::_parsePlainPostChar(uint8_t data){
   if(data && (char)data != '&')
     _temp += (char)data;
   if(!data || (char)data == '&' || _parsedLength == _contentLength){
-    String name = "body";
-    String value = _temp;
-    if(!_temp.startsWith("{") && !_temp.startsWith("[") && _temp.indexOf('=') > 0){
-      name = _temp.substring(0, _temp.indexOf('='));
-      value = _temp.substring(_temp.indexOf('=') + 1);
+    const char* text = _temp.c_str();
+    size_t len = _temp.length();
+    int equal = _temp.indexOf('=');
+    char* name;
+    char* value;
+    if(!_temp.startsWith("{") && !_temp.startsWith("[") && equal > 0){
+      name = _arenaDecode(text, equal);
+      value = _arenaDecode(text + equal + 1, len - equal - 1);
+    } else {
+      name = _arena.copy("body", 4);
+      value = _arenaDecode(text, len);
     }
-    _addParam(new AsyncWebParameter(urlDecode(name), urlDecode(value), true));
+    _addParam(name, value, true);
     _temp = String();
   }
 }
@@ -508,13 +608,13 @@ void AsyncWebServerRequest::_parseMultipartPostByte(uint8_t data, bool last){
     } else if(_boundaryPosition == _boundary.length() - 1){
       _multiParseState = DASH3_OR_RETURN2;
       if(!_itemIsFile){
-        _addParam(new AsyncWebParameter(_itemName, _itemValue, true));
+        _addParam(_arena.copy(_itemName.c_str(), _itemName.length()), _arena.copy(_itemValue.c_str(), _itemValue.length()), true);
       } else {
         if(_itemSize){
           //check if authenticated before calling the upload
           if(_handler) _handler->handleUpload(this, _itemFilename, _itemSize - _itemBufferIndex, _itemBuffer, _itemBufferIndex, true);
           _itemBufferIndex = 0;
-          _addParam(new AsyncWebParameter(_itemName, _itemFilename, true, true, _itemSize));
+          _addParam(_arena.copy(_itemName.c_str(), _itemName.length()), _arena.copy(_itemFilename.c_str(), _itemFilename.length()), true, true, _itemSize);
         }
         free(_itemBuffer);
         _itemBuffer = NULL;
@@ -568,7 +668,6 @@ void AsyncWebServerRequest::_parseLine(){
       //end of headers
       _server->_rewriteRequest(this);
       _server->_attachHandler(this);
-      _removeNotInterestingHeaders();
       if(_expectingContinue){
         const char * response = "HTTP/1.1 100 Continue\r\n\r\n";
         _client->write(response, os_strlen(response));
@@ -586,12 +685,15 @@ void AsyncWebServerRequest::_parseLine(){
 }
 
 size_t AsyncWebServerRequest::headers() const{
-  return _headers.length();
+  size_t count = 0;
+  for(AsyncWebRawHeader* h = _rawHeaders; h != NULL; h = h->next)
+    count++;
+  return count;
 }
 
 bool AsyncWebServerRequest::hasHeader(const String& name) const {
-  for(const auto& h: _headers){
-    if(h->name().equalsIgnoreCase(name)){
+  for(AsyncWebRawHeader* h = _rawHeaders; h != NULL; h = h->next){
+    if(!strcasecmp(h->name, name.c_str())){
       return true;
     }
   }
@@ -619,9 +721,9 @@ bool AsyncWebServerRequest::hasHeader(const __FlashStringHelper * data) const {
 }
 
 AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
-  for(const auto& h: _headers){
-    if(h->name().equalsIgnoreCase(name)){
-      return h;
+  for(AsyncWebRawHeader* h = _rawHeaders; h != NULL; h = h->next){
+    if(!strcasecmp(h->name, name.c_str())){
+      return _keep(h);
     }
   }
   return nullptr;
@@ -642,17 +744,22 @@ AsyncWebHeader* AsyncWebServerRequest::getHeader(const __FlashStringHelper * dat
 }
 
 AsyncWebHeader* AsyncWebServerRequest::getHeader(size_t num) const {
-  auto header = _headers.nth(num);
-  return header ? *header : nullptr;
+  AsyncWebRawHeader* h = _rawHeaders;
+  while(h != NULL && num--)
+    h = h->next;
+  return _keep(h);
 }
 
 size_t AsyncWebServerRequest::params() const {
-  return _params.length();
+  size_t count = 0;
+  for(AsyncWebRawParam* p = _rawParams; p != NULL; p = p->next)
+    count++;
+  return count;
 }
 
 bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p->name() == name && p->isPost() == post && p->isFile() == file){
+  for(AsyncWebRawParam* p = _rawParams; p != NULL; p = p->next){
+    if(name == p->name && p->post == post && p->file == file){
       return true;
     }
   }
@@ -676,9 +783,9 @@ bool AsyncWebServerRequest::hasParam(const __FlashStringHelper * data, bool post
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const {
-  for(const auto& p: _params){
-    if(p->name() == name && p->isPost() == post && p->isFile() == file){
-      return p;
+  for(AsyncWebRawParam* p = _rawParams; p != NULL; p = p->next){
+    if(name == p->name && p->post == post && p->file == file){
+      return _keep(p);
     }
   }
   return nullptr;
@@ -699,13 +806,10 @@ AsyncWebParameter* AsyncWebServerRequest::getParam(const __FlashStringHelper * d
 }
 
 AsyncWebParameter* AsyncWebServerRequest::getParam(size_t num) const {
-  auto param = _params.nth(num);
-  return param ? *param : nullptr;
-}
-
-void AsyncWebServerRequest::addInterestingHeader(const String& name){
-  if(!_interestingHeaders.containsIgnoreCase(name))
-    _interestingHeaders.add(name);
+  AsyncWebRawParam* p = _rawParams;
+  while(p != NULL && num--)
+    p = p->next;
+  return _keep(p);
 }
 
 void AsyncWebServerRequest::send(AsyncWebServerResponse *response){
@@ -862,8 +966,8 @@ void AsyncWebServerRequest::requestAuthentication(const char * realm, bool isDig
 }
 
 bool AsyncWebServerRequest::hasArg(const char* name) const {
-  for(const auto& arg: _params){
-    if(arg->name() == name){
+  for(AsyncWebRawParam* p = _rawParams; p != NULL; p = p->next){
+    if(!strcmp(p->name, name)){
       return true;
     }
   }
@@ -886,9 +990,9 @@ bool AsyncWebServerRequest::hasArg(const __FlashStringHelper * data) const {
 
 
 const String& AsyncWebServerRequest::arg(const String& name) const {
-  for(const auto& arg: _params){
-    if(arg->name() == name){
-      return arg->value();
+  for(AsyncWebRawParam* p = _rawParams; p != NULL; p = p->next){
+    if(name == p->name){
+      return _keep(p)->value();
     }
   }
   return SharedEmptyString;
@@ -51,8 +51,11 @@ class AsyncAbstractResponse: public AsyncWebServerResponse {
     size_t _fillBufferAndProcessTemplates(uint8_t* buf, size_t maxLen);
   protected:
     AwsTemplateProcessor _callback;
+    char _placeholder;
   public:
     AsyncAbstractResponse(AwsTemplateProcessor callback=nullptr);
+    // Pages full of CSS/JS percentages can delimit their placeholders with a character they never use
+    AsyncAbstractResponse& setTemplatePlaceholder(char placeholder){ _placeholder = placeholder; return *this; }
     void _respond(AsyncWebServerRequest *request);
     size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time);
     bool _sourceValid() const { return false; }
@@ -118,6 +121,21 @@ class AsyncProgmemResponse: public AsyncAbstractResponse {
     virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
 };
 
+// Body lives in memory that outlives the response and never changes (e.g. a
+// memory-mapped flash partition): it is handed to the TCP stack by reference,
+// so no file is opened and no payload byte is copied through the heap.
+class AsyncMappedResponse: public AsyncWebServerResponse {
+  private:
+    String _head;
+    const uint8_t * _content;
+    size_t _sendContent(AsyncWebServerRequest *request);
+  public:
+    AsyncMappedResponse(int code, const String& contentType, const uint8_t * content, size_t len);
+    void _respond(AsyncWebServerRequest *request);
+    size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time);
+    bool _sourceValid() const { return _content != NULL; }
+};
+
 class cbuf;
 
 class AsyncResponseStream: public AsyncAbstractResponse, public Print {
@@ -244,7 +244,7 @@ size_t AsyncBasicResponse::_ack(AsyncWebServerRequest *request, size_t len, uint
  * Abstract Response
  * */
 
-AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _callback(callback)
+AsyncAbstractResponse::AsyncAbstractResponse(AwsTemplateProcessor callback): _callback(callback), _placeholder(TEMPLATE_PLACEHOLDER)
 {
   // In case of template processing, we're unable to determine real response size
   if(callback) {
@@ -388,8 +388,8 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
   // Now we've read 'len' bytes, either from cache or from file
   // Search for template placeholders
   uint8_t* pTemplateStart = data;
-  while((pTemplateStart < &data[len]) && (pTemplateStart = (uint8_t*)memchr(pTemplateStart, TEMPLATE_PLACEHOLDER, &data[len - 1] - pTemplateStart + 1))) { // data[0] ... data[len - 1]
-    uint8_t* pTemplateEnd = (pTemplateStart < &data[len - 1]) ? (uint8_t*)memchr(pTemplateStart + 1, TEMPLATE_PLACEHOLDER, &data[len - 1] - pTemplateStart) : nullptr;
+  while((pTemplateStart < &data[len]) && (pTemplateStart = (uint8_t*)memchr(pTemplateStart, _placeholder, &data[len - 1] - pTemplateStart + 1))) { // data[0] ... data[len - 1]
+    uint8_t* pTemplateEnd = (pTemplateStart < &data[len - 1]) ? (uint8_t*)memchr(pTemplateStart + 1, _placeholder, &data[len - 1] - pTemplateStart) : nullptr;
     // temporary buffer to hold parameter name
     uint8_t buf[TEMPLATE_PARAM_NAME_LENGTH + 1];
     String paramName;
@@ -411,7 +411,7 @@ size_t AsyncAbstractResponse::_fillBufferAndProcessTemplates(uint8_t* data, size
       memcpy(buf, pTemplateStart + 1, &data[len - 1] - pTemplateStart);
       const size_t readFromCacheOrContent = _readDataFromCacheOrContent(buf + (&data[len - 1] - pTemplateStart), TEMPLATE_PARAM_NAME_LENGTH + 2 - (&data[len - 1] - pTemplateStart + 1));
       if(readFromCacheOrContent) {
-        pTemplateEnd = (uint8_t*)memchr(buf + (&data[len - 1] - pTemplateStart), TEMPLATE_PLACEHOLDER, readFromCacheOrContent);
+        pTemplateEnd = (uint8_t*)memchr(buf + (&data[len - 1] - pTemplateStart), _placeholder, readFromCacheOrContent);
         if(pTemplateEnd) {
           // prepare argument to callback
           *pTemplateEnd = 0;
@@ -661,6 +661,69 @@ size_t AsyncProgmemResponse::_fillBuffer(uint8_t *data, size_t len){
   return left;
 }
 
+/*
+ * Mapped Response (zero-copy body from memory-mapped flash)
+ * */
+
+AsyncMappedResponse::AsyncMappedResponse(int code, const String& contentType, const uint8_t * content, size_t len){
+  _code = code;
+  _content = content;
+  _contentType = contentType;
+  _contentLength = len;
+}
+
+void AsyncMappedResponse::_respond(AsyncWebServerRequest *request){
+  addHeader("Connection","close");
+  _head = _assembleHead(request->version());
+  _state = RESPONSE_HEADERS;
+  _sendContent(request);
+}
+
+size_t AsyncMappedResponse::_ack(AsyncWebServerRequest *request, size_t len, uint32_t time){
+  (void)time;
+  _ackedLength += len;
+  if(_state == RESPONSE_HEADERS || _state == RESPONSE_CONTENT){
+    return _sendContent(request);
+  } else if(_state == RESPONSE_WAIT_ACK){
+    if(_ackedLength >= _writtenLength){
+      _state = RESPONSE_END;
+    }
+  }
+  return 0;
+}
+
+size_t AsyncMappedResponse::_sendContent(AsyncWebServerRequest *request){
+  AsyncClient *client = request->client();
+  size_t space = client->space();
+  size_t written = 0;
+  //the head is built on the heap, so it has to be copied into the pcb
+  if(_head.length() && space){
+    size_t headLen = _head.length();
+    size_t n = (space < headLen) ? space : headLen;
+    n = client->add(_head.c_str(), n);
+    _head = (n < headLen) ? _head.substring(n) : String();
+    space -= n;
+    written += n;
+  }
+  //the body is only referenced: lwIP chains the mapped flash into the segment
+  if(!_head.length() && space && _sentLength < _contentLength){
+    size_t left = _contentLength - _sentLength;
+    size_t n = client->add((const char*)_content + _sentLength, (space < left) ? space : left, 0);
+    _sentLength += n;
+    written += n;
+  }
+  if(written){
+    client->send();
+    _writtenLength += written;
+  }
+  if(!_head.length() && _sentLength >= _contentLength){
+    _state = (_ackedLength >= _writtenLength) ? RESPONSE_END : RESPONSE_WAIT_ACK;
+  } else if(!_head.length()){
+    _state = RESPONSE_CONTENT;
+  }
+  return written;
+}
+
 
 /*
  * Response Stream (You can print/write/printf to it, up to the contentLen bytes)
@@ -20,6 +20,10 @@
 */
 #include "ESPAsyncWebServer.h"
 #include "WebHandlerImpl.h"
+#include <WebRouteIndex.h>
+
+// Plain-path handlers are dispatched from a route index, see WebRouteIndex.h
+struct AsyncWebRouteIndex: public WebRouteIndex<AsyncWebHandler> {};
 
 bool ON_STA_FILTER(AsyncWebServerRequest *request) {
   return WiFi.localIP() == request->client()->localIP();
@@ -34,6 +38,8 @@ AsyncWebServer::AsyncWebServer(uint16_t port)
   : _server(port)
   , _rewrites(LinkedList<AsyncWebRewrite*>([](AsyncWebRewrite* r){ delete r; }))
   , _handlers(LinkedList<AsyncWebHandler*>([](AsyncWebHandler* h){ delete h; }))
+  , _routeIndex(new AsyncWebRouteIndex())
+  , _routesDirty(true)
 {
   _catchAllHandler = new AsyncCallbackWebHandler();
   if(_catchAllHandler == NULL)
@@ -55,6 +61,7 @@ AsyncWebServer::~AsyncWebServer(){
   reset();  
   end();
   if(_catchAllHandler) delete _catchAllHandler;
+  delete _routeIndex;
 }
 
 AsyncWebRewrite& AsyncWebServer::addRewrite(AsyncWebRewrite* rewrite){
@@ -72,14 +79,17 @@ AsyncWebRewrite& AsyncWebServer::rewrite(const char* from, const char* to){
 
 AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler){
   _handlers.add(handler);
+  _routesDirty = true;
   return *handler;
 }
 
 bool AsyncWebServer::removeHandler(AsyncWebHandler *handler){
+  _routesDirty = true;
   return _handlers.remove(handler);
 }
 
 void AsyncWebServer::begin(){
+  _buildRouteIndex();
   _server.setNoDelay(true);
   _server.begin();
 }
@@ -111,15 +121,38 @@ void AsyncWebServer::_rewriteRequest(AsyncWebServerRequest *request){
   }
 }
 
-void AsyncWebServer::_attachHandler(AsyncWebServerRequest *request){
+void AsyncWebServer::_buildRouteIndex(){
+  _routeIndex->clear();
   for(const auto& h: _handlers){
-    if (h->filter(request) && h->canHandle(request)){
-      request->setHandler(h);
-      return;
+    const String* uri = h->_routeUri();
+    _routeIndex->add(h, uri ? uri->c_str() : NULL, uri ? uri->length() : 0);
+  }
+  _routeIndex->sort();
+  _routesDirty = false;
+}
+
+void AsyncWebServer::_attachHandler(AsyncWebServerRequest *request){
+  if(_routesDirty)
+    _buildRouteIndex();
+
+  bool overflow;
+  AsyncWebHandler* handler = _routeIndex->find(request->url().c_str(), request->url().length(), [request](AsyncWebHandler* h){
+    return h->filter(request) && h->canHandle(request);
+  }, overflow);
+  if(handler){
+    request->setHandler(handler);
+    return;
+  }
+  if(overflow){
+    // Pathological route set: fall back to asking every handler
+    for(const auto& h: _handlers){
+      if (h->filter(request) && h->canHandle(request)){
+        request->setHandler(h);
+        return;
+      }
     }
   }
   
-  request->addInterestingHeader("ANY");
   request->setHandler(_catchAllHandler);
 }
 
@@ -180,9 +213,40 @@ void AsyncWebServer::onRequestBody(ArBodyHandlerFunction fn){
   _catchAllHandler->onBody(fn);
 }
 
+void AsyncWebServer::routeStats(ArRouteStatsFunction fn) const {
+  // Handlers that share a label (GET and PATCH on one path, say) are summed into one series
+  for(auto it = _handlers.begin(); it != _handlers.end(); ++it){
+    const char* label = (*it)->_statsLabel();
+    if(label == NULL) label = "other";
+    bool seen = false;
+    for(auto prev = _handlers.begin(); prev != it && !seen; ++prev){
+      const char* l = (*prev)->_statsLabel();
+      seen = !strcmp(l ? l : "other", label);
+    }
+    if(seen)
+      continue;
+
+    AsyncWebRouteSnapshot sum;
+    memset(&sum, 0, sizeof(sum));
+    for(auto next = it; next != _handlers.end(); ++next){
+      const char* l = (*next)->_statsLabel();
+      if(!strcmp(l ? l : "other", label))
+        (*next)->_stats.addTo(sum);
+    }
+    fn(label, sum);
+  }
+
+  AsyncWebRouteSnapshot notFound;
+  memset(&notFound, 0, sizeof(notFound));
+  if(_catchAllHandler)
+    _catchAllHandler->_stats.addTo(notFound);
+  fn("notFound", notFound);
+}
+
 void AsyncWebServer::reset(){
   _rewrites.free();
   _handlers.free();
+  _routesDirty = true;
   
   if (_catchAllHandler != NULL){
     _catchAllHandler->onRequest(NULL);
@@ -0,0 +1,70 @@
+/*
+  FrequencyPlanner - picks a WSPR transmit frequency away from other signals.
+*/
+#include "FrequencyPlanner.h"
+#include <math.h>
+#include <string.h>
+
+void FrequencyPlanner::clear(){
+  memset(_bins, 0, sizeof(_bins));
+}
+
+void FrequencyPlanner::add(int offsetHz, uint32_t reports, uint32_t ageS){
+  if(offsetHz < 0 || offsetHz > FP_WINDOW_HZ || reports == 0)
+    return;
+  uint32_t weight = (uint32_t)(reports * FP_WEIGHT_ONE * exp2f(-(float)ageS / FP_HALF_LIFE_S) + 0.5f);
+  uint32_t sum = _bins[offsetHz] + weight;
+  _bins[offsetHz] = sum > UINT16_MAX ? UINT16_MAX : sum;
+}
+
+uint32_t FrequencyPlanner::cost(int offsetHz, int avoidHz) const {
+  uint32_t sum = 0;
+  for(int f = offsetHz - FP_SIGNAL_HZ + 1; f < offsetHz + FP_SIGNAL_HZ; f++){
+    if(f >= 0 && f <= FP_WINDOW_HZ)
+      sum += _bins[f];
+  }
+  if(avoidHz >= 0 && offsetHz > avoidHz - FP_SIGNAL_HZ && offsetHz < avoidHz + FP_SIGNAL_HZ)
+    sum += FP_SELF_PENALTY;
+  return sum;
+}
+
+uint32_t FrequencyPlanner::total() const {
+  uint32_t sum = 0;
+  for(int f = 0; f <= FP_WINDOW_HZ; f++)
+    sum += _bins[f];
+  return sum;
+}
+
+/*
+ * Two passes over the candidates: the first finds the quietest score, the second
+ * picks the n-th candidate within FP_QUIET_SLACK of it, n uniform. Picking the
+ * single best centre would send every planner with the same reports to it.
+ * */
+
+int FrequencyPlanner::choose(int minHz, int maxHz, int avoidHz, RandomSource random) const {
+  if(minHz < 0)
+    minHz = 0;
+  if(maxHz > FP_WINDOW_HZ)
+    maxHz = FP_WINDOW_HZ;
+  if(maxHz < minHz)
+    return minHz;
+
+  uint32_t best = UINT32_MAX;
+  for(int c = minHz; c <= maxHz; c++){
+    uint32_t s = cost(c, avoidHz);
+    if(s < best)
+      best = s;
+  }
+
+  uint32_t quiet = 0;
+  for(int c = minHz; c <= maxHz; c++){
+    if(cost(c, avoidHz) <= best + FP_QUIET_SLACK)
+      quiet++;
+  }
+  uint32_t pick = random() % quiet;
+  for(int c = minHz; c <= maxHz; c++){
+    if(cost(c, avoidHz) <= best + FP_QUIET_SLACK && pick-- == 0)
+      return c;
+  }
+  return minHz;
+}
@@ -0,0 +1,51 @@
+/*
+  FrequencyPlanner - picks a WSPR transmit frequency away from other signals.
+
+  One planner covers the 200 Hz WSPR window of one band with a 1 Hz histogram
+  of recent reports of other stations, each weighted down by its age. choose()
+  scores every candidate centre by the occupancy a signal there (about 6 Hz
+  wide) would overlap and picks at random among the quietest candidates, so
+  that stations fed the same reports do not all pile into the same gap. The
+  caller passes the offset it used last on the band to keep away from it too.
+
+  With no reports the choice is uniform over the allowed range.
+
+  Plain C++ with no Arduino dependency, so it also builds for host simulations.
+*/
+#ifndef FREQUENCYPLANNER_H_
+#define FREQUENCYPLANNER_H_
+
+#include <stdint.h>
+
+#define FP_WINDOW_HZ 200
+#define FP_SIGNAL_HZ 6            // Centres closer than this overlap
+#ifndef FP_HALF_LIFE_S
+#define FP_HALF_LIFE_S 1800       // A report's weight halves every half-life
+#endif
+#define FP_WEIGHT_ONE 256         // Weight of one fresh report
+#define FP_QUIET_SLACK 64         // Candidates within this of the quietest count as quiet
+#define FP_SELF_PENALTY 0x100000  // Added around the offset to avoid
+
+class FrequencyPlanner {
+  public:
+    typedef uint32_t (*RandomSource)();
+
+  private:
+    uint16_t _bins[FP_WINDOW_HZ + 1];   // Weighted reports per Hz offset, saturating
+
+  public:
+    FrequencyPlanner(){ clear(); }
+
+    void clear();
+    // reports heard at offsetHz (0..FP_WINDOW_HZ from the window start), ageS seconds ago
+    void add(int offsetHz, uint32_t reports, uint32_t ageS);
+
+    // Offset in [minHz, maxHz] away from avoidHz (-1 for none); random() returns 32 uniform bits
+    int choose(int minHz, int maxHz, int avoidHz, RandomSource random) const;
+
+    // Weighted reports a signal centred at offsetHz would overlap
+    uint32_t cost(int offsetHz, int avoidHz = -1) const;
+    uint32_t total() const;
+};
+
+#endif /* FREQUENCYPLANNER_H_ */
@@ -92,31 +92,75 @@ bool NTPClient::forceUpdate() {
 
   this->sendNTPPacket();
 
-  // Wait till data is there or timeout...
-  byte timeout = 0;
+  // Wait till data is there or timeout... Poll every millisecond so the
+  // destination timestamp (T4) is taken as close as possible to the arrival.
+  unsigned long start = millis();
   int cb = 0;
   do {
-    delay ( 10 );
+    delay ( 1 );
     cb = this->_udp->parsePacket();
-    if (timeout > 100) return false; // timeout after 1000 ms
-    timeout++;
+    if (millis() - start > NTP_REPLY_TIMEOUT_MS) return false;
   } while (cb == 0);
 
-  this->_lastUpdate = millis() - (10 * (timeout + 1)); // Account for delay in reading the time
+  this->_destinationUs = localTimeMicros();
+  unsigned long arrivalMillis = millis();
 
+  if (cb < NTP_PACKET_SIZE) {
+    this->_udp->flush();
+    return false;
+  }
   this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
 
-  unsigned long highWord = word(this->_packetBuffer[40], this->_packetBuffer[41]);
-  unsigned long lowWord = word(this->_packetBuffer[42], this->_packetBuffer[43]);
-  // combine the four bytes (two words) into a long integer
-  // this is NTP time (seconds since Jan 1 1900):
-  unsigned long secsSince1900 = highWord << 16 | lowWord;
+  if (!this->parseNTPPacket()) return false;
 
-  this->_currentEpoc = secsSince1900 - SEVENZYYEARS;
+  this->_lastUpdate = arrivalMillis;
+  this->_currentEpoc = (unsigned long)((this->_destinationUs + this->_offsetUs) / 1000000LL);
 
   return true;  // return true after successful update
 }
 
+bool NTPClient::parseNTPPacket() {
+  byte li   = this->_packetBuffer[0] >> 6;
+  byte mode = this->_packetBuffer[0] & 0x07;
+  byte stratum = this->_packetBuffer[1];
+
+  // Only accept synchronised server replies; stratum 0 is a kiss-o'-death
+  if (mode != 4 || li == 3 || stratum == 0 || stratum > 15) return false;
+
+  // The server echoes our transmit timestamp as its originate timestamp;
+  // anything else is a stale or spoofed reply.
+  byte expected[8];
+  microsToNtp(this->_originateUs, expected);
+  if (memcmp(expected, this->_packetBuffer + 24, 8) != 0) return false;
+
+  this->_receiveUs  = ntpToMicros(this->_packetBuffer + 32);
+  this->_transmitUs = ntpToMicros(this->_packetBuffer + 40);
+  if (this->_transmitUs == 0) return false;
+
+  int64_t t1 = this->_originateUs;
+  int64_t t2 = this->_receiveUs;
+  int64_t t3 = this->_transmitUs;
+  int64_t t4 = this->_destinationUs;
+
+  this->_offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+  this->_delayUs  = (t4 - t1) - (t3 - t2);
+  if (this->_delayUs < 0) this->_delayUs = 0;
+
+  // Root delay and root dispersion are 16.16 fixed-point seconds
+  uint32_t rootDelay = ((uint32_t)this->_packetBuffer[4] << 24) | ((uint32_t)this->_packetBuffer[5] << 16) |
+                       ((uint32_t)this->_packetBuffer[6] << 8)  |  (uint32_t)this->_packetBuffer[7];
+  uint32_t rootDisp  = ((uint32_t)this->_packetBuffer[8] << 24) | ((uint32_t)this->_packetBuffer[9] << 16) |
+                       ((uint32_t)this->_packetBuffer[10] << 8) |  (uint32_t)this->_packetBuffer[11];
+  int64_t rootDelayUs = ((int64_t)rootDelay * 1000000LL) >> 16;
+  int64_t rootDispUs  = ((int64_t)rootDisp * 1000000LL) >> 16;
+
+  this->_dispersionUs = rootDispUs + rootDelayUs / 2 + this->_delayUs / 2 +
+                        ((t4 - t1) * NTP_CLOCK_PHI_PPM) / 1000000LL;
+  this->_stratum = stratum;
+
+  return true;
+}
+
 bool NTPClient::update() {
   if ((millis() - this->_lastUpdate >= this->_updateInterval)     // Update after _updateInterval
     || this->_lastUpdate == 0) {                                // Update if there was no update yet.
@@ -163,6 +207,31 @@ String NTPClient::getFormattedTime() const {
   return hoursStr + ":" + minuteStr + ":" + secondStr;
 }
 
+int64_t NTPClient::getOffsetMicros() const {
+  return this->_offsetUs;
+}
+
+int64_t NTPClient::getDelayMicros() const {
+  return this->_delayUs;
+}
+
+int64_t NTPClient::getDispersionMicros() const {
+  return this->_dispersionUs;
+}
+
+uint8_t NTPClient::getStratum() const {
+  return this->_stratum;
+}
+
+bool NTPClient::getTimeval(struct timeval* tv) const {
+  if (!this->isTimeSet() || tv == NULL) return false;
+
+  int64_t nowUs = localTimeMicros() + this->_offsetUs;
+  tv->tv_sec  = (time_t)(nowUs / 1000000LL);
+  tv->tv_usec = (suseconds_t)(nowUs % 1000000LL);
+  return true;
+}
+
 void NTPClient::end() {
   this->_udp->stop();
 
@@ -202,6 +271,11 @@ void NTPClient::sendNTPPacket() {
   } else {
     this->_udp->beginPacket(this->_poolServerIP, 123);
   }
+
+  // Fill the transmit timestamp (T1) last, right before the packet leaves
+  this->_originateUs = localTimeMicros();
+  microsToNtp(this->_originateUs, this->_packetBuffer + 40);
+
   this->_udp->write(this->_packetBuffer, NTP_PACKET_SIZE);
   this->_udp->endPacket();
 }
@@ -210,3 +284,28 @@ void NTPClient::setRandomPort(unsigned int minValue, unsigned int maxValue) {
   randomSeed(analogRead(0));
   this->_port = random(minValue, maxValue);
 }
+
+int64_t NTPClient::localTimeMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+int64_t NTPClient::ntpToMicros(const byte* field) {
+  uint32_t seconds  = ((uint32_t)field[0] << 24) | ((uint32_t)field[1] << 16) |
+                      ((uint32_t)field[2] << 8)  |  (uint32_t)field[3];
+  uint32_t fraction = ((uint32_t)field[4] << 24) | ((uint32_t)field[5] << 16) |
+                      ((uint32_t)field[6] << 8)  |  (uint32_t)field[7];
+  if (seconds == 0 && fraction == 0) return 0;
+
+  int64_t us = ((int64_t)seconds - (int64_t)SEVENZYYEARS) * 1000000LL;
+  return us + (int64_t)(((uint64_t)fraction * 1000000ULL) >> 32);
+}
+
+void NTPClient::microsToNtp(int64_t us, byte* field) {
+  uint32_t seconds  = (uint32_t)(us / 1000000LL + SEVENZYYEARS);
+  uint32_t fraction = (uint32_t)((((uint64_t)(us % 1000000LL)) << 32) / 1000000ULL);
+
+  field[0] = seconds >> 24;  field[1] = seconds >> 16;  field[2] = seconds >> 8;  field[3] = seconds;
+  field[4] = fraction >> 24; field[5] = fraction >> 16; field[6] = fraction >> 8; field[7] = fraction;
+}
@@ -3,10 +3,13 @@
 #include "Arduino.h"
 
 #include <Udp.h>
+#include <sys/time.h>
 
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_REPLY_TIMEOUT_MS 1000
+#define NTP_CLOCK_PHI_PPM 15 // Frequency tolerance used for dispersion growth (RFC 5905)
 
 class NTPClient {
   private:
@@ -25,7 +28,23 @@ class NTPClient {
 
     byte          _packetBuffer[NTP_PACKET_SIZE];
 
+    // The four on-wire timestamps of the last exchange, in us since Jan. 1, 1970
+    int64_t       _originateUs    = 0;      // T1: client transmit (local clock)
+    int64_t       _receiveUs      = 0;      // T2: server receive
+    int64_t       _transmitUs     = 0;      // T3: server transmit
+    int64_t       _destinationUs  = 0;      // T4: client receive (local clock)
+
+    int64_t       _offsetUs       = 0;      // Server clock minus local clock
+    int64_t       _delayUs        = 0;      // Round-trip delay minus server hold time
+    int64_t       _dispersionUs   = 0;      // Error bound of the offset
+    uint8_t       _stratum        = 0;
+
     void          sendNTPPacket();
+    bool          parseNTPPacket();
+
+    static int64_t localTimeMicros();
+    static int64_t ntpToMicros(const byte* field);
+    static void    microsToNtp(int64_t us, byte* field);
 
   public:
     NTPClient(UDP& udp);
@@ -107,6 +126,43 @@ class NTPClient {
      */
     unsigned long getEpochTime() const;
 
+    /**
+     * Clock offset of the server relative to the local system clock (gettimeofday),
+     * computed from the four timestamps of the last exchange: ((T2 - T1) + (T3 - T4)) / 2
+     *
+     * @return offset in microseconds, positive when the local clock is behind
+     */
+    int64_t getOffsetMicros() const;
+
+    /**
+     * Round-trip network delay of the last exchange: (T4 - T1) - (T3 - T2)
+     *
+     * @return delay in microseconds
+     */
+    int64_t getDelayMicros() const;
+
+    /**
+     * Upper bound of the offset error: server root dispersion + half the root delay
+     * + half the round-trip delay + clock frequency tolerance over the exchange
+     *
+     * @return dispersion in microseconds
+     */
+    int64_t getDispersionMicros() const;
+
+    /**
+     * @return stratum reported by the server in the last valid reply
+     */
+    uint8_t getStratum() const;
+
+    /**
+     * Corrected current UTC time, ready to be passed to settimeofday(). It is the local
+     * system clock shifted by the offset measured during the last update (the
+     * user time offset is not applied).
+     *
+     * @return false if no valid reply has been received yet
+     */
+    bool getTimeval(struct timeval* tv) const;
+
     /**
      * Stops the underlying UDP client
      */
@@ -0,0 +1,113 @@
+/*
+  RecordRing - a bounded log of fixed-size records kept in append-only segment
+  files, the oldest segment being deleted whole.
+
+  Slot layout: magic, sequence (both uint32_t, host order), the record, then
+  the CRC-32 of everything before it.
+*/
+#include "RecordRing.h"
+#include <string.h>
+
+RecordRing::RecordRing(RecordStore& store, uint32_t magic, uint16_t recordSize, uint16_t perSegment, uint16_t segments)
+  : _store(store), _magic(magic), _recordSize(recordSize), _perSegment(perSegment ? perSegment : 1),
+    _segments(segments ? segments : 1), _next(0), _trimFrom(0) {}
+
+struct SegmentRange {
+  bool any;
+  uint32_t first;
+  uint32_t last;
+};
+
+static void widen(uint32_t segment, void* context){
+  SegmentRange& range = *(SegmentRange*)context;
+  if(!range.any || segment < range.first)
+    range.first = segment;
+  if(!range.any || segment > range.last)
+    range.last = segment;
+  range.any = true;
+}
+
+uint32_t RecordRing::begin(){
+  SegmentRange range = {false, 0, 0};
+  _store.list(widen, &range);
+  if(!range.any){
+    _next = 0;
+    _trimFrom = 0;
+    return _next;
+  }
+
+  size_t size = _store.size(range.last);
+  if(size % slotSize() == 0 && size / slotSize() <= _perSegment)
+    _next = range.last * _perSegment + size / slotSize();
+  else
+    _next = (range.last + 1) * _perSegment;   // Torn tail: the slots after it would sit at the wrong offset
+  _trimFrom = range.first;
+  trim(range.last);
+  return _next;
+}
+
+void RecordRing::trim(uint32_t newest){
+  uint32_t keepFrom = newest + 1 > _segments ? newest + 1 - _segments : 0;
+  // A segment the store cannot remove yet (open for reading, say) is retried with the next segment
+  while(_trimFrom < keepFrom && _store.remove(_trimFrom))
+    _trimFrom++;
+}
+
+bool RecordRing::append(const void* record){
+  if(_recordSize > RECORD_RING_MAX_RECORD)
+    return false;
+  uint32_t segment = _next / _perSegment;
+  if(_next % _perSegment == 0){
+    trim(segment);
+    if(_store.size(segment) && !_store.remove(segment))   // Left over from a failed append
+      return false;
+  }
+
+  uint8_t slot[RECORD_RING_MAX_RECORD + 12];
+  memcpy(slot, &_magic, 4);
+  memcpy(slot + 4, &_next, 4);
+  memcpy(slot + 8, record, _recordSize);
+  uint32_t crc = crc32(slot, 8 + _recordSize);
+  memcpy(slot + 8 + _recordSize, &crc, 4);
+  if(!_store.append(segment, slot, slotSize())){
+    // Part of the slot may be in the segment already, so it ends here
+    _next = (segment + 1) * _perSegment;
+    return false;
+  }
+  _next++;
+  return true;
+}
+
+bool RecordRing::read(uint32_t sequence, void* record){
+  if(_recordSize > RECORD_RING_MAX_RECORD)
+    return false;
+  uint8_t slot[RECORD_RING_MAX_RECORD + 12];
+  if(!_store.read(sequence / _perSegment, (sequence % _perSegment) * slotSize(), slot, slotSize()))
+    return false;
+  uint32_t magic, stored, crc;
+  memcpy(&magic, slot, 4);
+  memcpy(&stored, slot + 4, 4);
+  memcpy(&crc, slot + 8 + _recordSize, 4);
+  if(magic != _magic || stored != sequence || crc != crc32(slot, 8 + _recordSize))
+    return false;
+  memcpy(record, slot + 8, _recordSize);
+  return true;
+}
+
+uint32_t RecordRing::oldest(uint32_t next) const {
+  if(next == 0)
+    return 0;
+  uint32_t newest = (next - 1) / _perSegment;
+  return newest + 1 > _segments ? (newest + 1 - _segments) * _perSegment : 0;
+}
+
+// CRC-32 (IEEE 802.3, reflected), the same as esp_rom_crc32_le
+uint32_t RecordRing::crc32(const uint8_t* data, size_t len, uint32_t crc){
+  crc = ~crc;
+  while(len--){
+    crc ^= *data++;
+    for(int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
@@ -0,0 +1,80 @@
+/*
+  RecordRing - a bounded log of fixed-size records kept in append-only segment
+  files, the oldest segment being deleted whole.
+
+  Record n sits in segment n / perSegment at slot n % perSegment, so a segment
+  is only ever appended to and no record is rewritten in place. On LittleFS,
+  where a file is a copy-on-write skip-list, writing into the middle of a file
+  copies everything after it; an append copies at most the file's last block.
+
+  Each slot is framed by the ring's magic, the record's sequence and a CRC-32,
+  so a torn or corrupt slot reads as missing and its neighbours still read.
+  begin() resumes after the last slot of the newest segment. When that segment
+  ends in a partial slot, or an append fails, writing goes on at the start of
+  the next segment, so every slot keeps its fixed offset.
+
+  Storage goes through RecordStore: LittleFS files in the firmware, memory in
+  the host tests. Appends must come from one task; any number of rings over
+  their own stores may read concurrently, between oldest(next) and next.
+
+  Plain C++ with no Arduino dependency, so it also builds for host tests.
+*/
+#ifndef RECORDRING_H_
+#define RECORDRING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RECORD_RING_MAX_RECORD 128   // Largest record size, in bytes
+
+class RecordStore {
+  public:
+    virtual ~RecordStore() {}
+    // Bytes in the segment, 0 when it does not exist
+    virtual size_t size(uint32_t segment) = 0;
+    // Adds len bytes at the end of the segment, creating it; false when not all were written
+    virtual bool append(uint32_t segment, const uint8_t* data, size_t len) = 0;
+    // Makes the appends so far durable and visible to other readers
+    virtual void flush() {}
+    virtual bool read(uint32_t segment, size_t offset, uint8_t* data, size_t len) = 0;
+    // True once the segment is gone, including when it never existed
+    virtual bool remove(uint32_t segment) = 0;
+    // Calls found(segment, context) for each existing segment, in any order
+    virtual void list(void (*found)(uint32_t segment, void* context), void* context) = 0;
+};
+
+class RecordRing {
+  private:
+    RecordStore& _store;
+    uint32_t _magic;
+    uint16_t _recordSize;
+    uint16_t _perSegment;
+    uint16_t _segments;
+    uint32_t _next;
+    uint32_t _trimFrom;   // Oldest segment that may still exist
+
+    size_t slotSize() const { return _recordSize + 12; }
+    void trim(uint32_t newest);
+
+  public:
+    RecordRing(RecordStore& store, uint32_t magic, uint16_t recordSize, uint16_t perSegment, uint16_t segments);
+
+    // Finds where appending resumes and drops segments beyond the capacity; returns next()
+    uint32_t begin();
+    // Stores record under sequence next(); false when the store failed. Readers elsewhere see it after flush().
+    bool append(const void* record);
+    void flush() { _store.flush(); }
+    // False when the slot is missing, torn, corrupt or holds another sequence
+    bool read(uint32_t sequence, void* record);
+
+    uint32_t next() const { return _next; }
+    // First sequence still kept once next is the next sequence to be written
+    uint32_t oldest(uint32_t next) const;
+    uint32_t oldest() const { return oldest(_next); }
+    // Records kept at most; at least capacity() - perSegment once the ring has wrapped
+    uint32_t capacity() const { return (uint32_t)_perSegment * _segments; }
+
+    static uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+};
+
+#endif /* RECORDRING_H_ */
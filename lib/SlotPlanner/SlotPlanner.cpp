@@ -0,0 +1,111 @@
+/*
+  SlotPlanner - decides, one hour ahead, which two-minute WSPR slots transmit
+  and on which band.
+*/
+#include "SlotPlanner.h"
+#include <string.h>
+
+void SlotPlanner::invalidate(){
+  memset(_bands, SP_IDLE, sizeof(_bands));
+  _hour = SP_NO_HOUR;
+  _txCount = 0;
+}
+
+// Murmur3 finalizer over the seed and a counter: cheap, and every input bit reaches every output bit
+static uint32_t mix(uint32_t seed, uint32_t n){
+  uint32_t h = seed ^ (n * 0x9E3779B9UL);
+  h ^= h >> 16;
+  h *= 0x85EBCA6BUL;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35UL;
+  h ^= h >> 16;
+  return h;
+}
+
+/*
+ * Run k covers slots [ceil(100 k / p), ceil(100 (k + 1) / p)), 100 / p slots
+ * rounded up or down, so slot n lies in run floor(n p / 100). Each run
+ * transmits in exactly one of its slots: the seeded hash of the run number,
+ * modulo the run length, is its offset in the run.
+ * */
+
+bool SlotPlanner::percentSlot(uint32_t n, uint8_t percent, uint32_t seed, uint32_t& run){
+  if(percent == 0)
+    return false;
+  if(percent > 100)
+    percent = 100;
+  run = (uint32_t)((uint64_t)n * percent / 100);
+  uint32_t start = (uint32_t)(((uint64_t)run * 100 + percent - 1) / percent);
+  uint32_t next = (uint32_t)(((uint64_t)(run + 1) * 100 + percent - 1) / percent);
+  return n - start == mix(seed, run) % (next - start);
+}
+
+// First slot of one run to the last of the next, both runs at their longest
+uint16_t SlotPlanner::maxSpacing(uint8_t percent){
+  if(percent == 0)
+    return 0;
+  if(percent > 100)
+    percent = 100;
+  return 2 * ((100 + percent - 1) / percent) - 1;
+}
+
+/*
+ * Slots are numbered on the absolute grid (epoch / SP_SLOT_S), so an interval,
+ * a run or a rotation carries on across hours and reboots instead of
+ * restarting at the top of each hour. An hour starts on a multiple of
+ * SP_HOP_CYCLE, so the cycle position is the slot's position in the hour
+ * modulo the cycle.
+ * */
+
+void SlotPlanner::build(const SlotRules& rules, uint32_t hour){
+  invalidate();
+  _hour = hour;
+
+  uint8_t bandCount = rules.bandCount < SP_MAX_BANDS ? rules.bandCount : SP_MAX_BANDS;
+  uint32_t hourBit = 1UL << (hour % 24);
+  uint8_t usable[SP_MAX_BANDS];
+  uint8_t usableCount = 0;
+  for(uint8_t b = 0; b < bandCount; b++){
+    if(rules.bandHours[b] & hourBit)
+      usable[usableCount++] = b;
+  }
+  if(usableCount == 0)
+    return;
+
+  if(rules.mode == SP_MODE_MANUAL){
+    for(uint8_t s = 0; s < SP_SLOTS; s++){
+      uint8_t b = rules.manual[s];
+      if(b < bandCount && (rules.bandHours[b] & hourBit)){
+        _bands[s] = b;
+        _txCount++;
+      }
+    }
+    return;
+  }
+
+  uint32_t firstSlot = hour * SP_SLOTS;
+  for(uint8_t s = 0; s < SP_SLOTS; s++){
+    uint32_t n = firstSlot + s;
+    uint32_t ordinal;   // Transmissions before this one, for the rotation
+    if(rules.mode == SP_MODE_PERCENT){
+      if(!percentSlot(n, rules.txPercent, rules.seed, ordinal))
+        continue;
+    } else {
+      uint8_t every = rules.intervalSlots ? rules.intervalSlots : 1;
+      if(n % every)
+        continue;
+      ordinal = n / every;
+    }
+
+    uint8_t b;
+    if(rules.hop == SP_HOP_COORDINATED){
+      int8_t c = rules.hopBand[s % SP_HOP_CYCLE];
+      bool usableNow = c >= 0 && c < bandCount && (rules.bandHours[c] & hourBit);
+      b = usableNow ? (uint8_t)c : usable[mix(~rules.seed, n) % usableCount];
+    } else {
+      b = usable[ordinal % usableCount];
+    }
+    _bands[s] = b;
+    _txCount++;
+  }
+}
@@ -0,0 +1,90 @@
+/*
+  SlotPlanner - decides, one hour ahead, which two-minute WSPR slots transmit
+  and on which band.
+
+  An hour holds SP_SLOTS even-minute slots. build() turns the rules into a plan
+  for one hour (a band index or SP_IDLE per slot) so the scheduler only does a
+  table lookup per slot. The rules combine:
+
+    - which slots transmit: every n-th slot on the absolute slot grid
+      (epoch / 120), a TX percentage, or a plan given slot by slot;
+    - which band a slot uses: a rotation over the usable bands, or a fixed
+      band per slot of a 20-minute cycle shared by every station (WSJT-X band
+      hopping), with a pseudo-random usable band where the cycle's band is
+      not usable;
+    - when a band is usable: a 24-bit mask of UTC hours per band.
+
+  TX percentage p cuts the slot grid into consecutive runs of 100 / p slots
+  (rounded so that run k starts at slot ceil(100 k / p)) and transmits in one
+  slot of each run, picked by a hash of the run number and a per-device seed.
+  Hence, whatever the seed:
+
+    - the long-run duty is p: any stretch of slots holds within two
+      transmissions of p percent of them;
+    - two transmissions start at most 2 * ceil(100 / p) - 1 slots apart;
+    - a station sharing a slot with a neighbour once is no more likely than
+      any other to share the next one: the sequences of two seeds do not
+      keep a fixed phase, unlike two beacons on the same fixed interval.
+
+  The plan is a function of the rules and the hour alone, so it is the same
+  after a reboot.
+
+  Plain C++ with no Arduino dependency, so it also builds for host simulations.
+*/
+#ifndef SLOTPLANNER_H_
+#define SLOTPLANNER_H_
+
+#include <stdint.h>
+
+#define SP_SLOTS 30               // Two-minute slots per hour
+#define SP_SLOT_S 120
+#define SP_HOP_CYCLE 10           // Slots of the coordinated band-hopping cycle
+#define SP_MAX_BANDS 16
+#define SP_IDLE 0xFF              // Slot without transmission
+#define SP_ALL_HOURS 0xFFFFFFUL
+#define SP_NO_HOUR UINT32_MAX
+
+#define SP_MODE_INTERVAL 0        // Every intervalSlots-th slot
+#define SP_MODE_PERCENT 1         // txPercent of the slots, chosen at random
+#define SP_MODE_MANUAL 2          // manual[] as given
+
+#define SP_HOP_ROTATE 0           // Next usable band at each transmission
+#define SP_HOP_COORDINATED 1      // hopBand[] by position in the cycle
+
+struct SlotRules {
+  uint8_t mode;                       // SP_MODE_*
+  uint8_t intervalSlots;              // SP_MODE_INTERVAL: 1 to 5
+  uint8_t txPercent;                  // SP_MODE_PERCENT: 1 to 100
+  uint8_t hop;                        // SP_HOP_*
+  uint8_t bandCount;
+  uint32_t seed;                      // Per device: picks the slot of each run, and fallback bands
+  uint32_t bandHours[SP_MAX_BANDS];   // Bit h: the band may transmit during UTC hour h
+  int8_t hopBand[SP_HOP_CYCLE];       // Band of each cycle slot, -1 for a band we do not have
+  uint8_t manual[SP_SLOTS];           // SP_MODE_MANUAL: band per slot or SP_IDLE
+};
+
+class SlotPlanner {
+  private:
+    uint8_t _bands[SP_SLOTS];
+    uint32_t _hour;                   // epoch / 3600 the plan is for
+    uint8_t _txCount;
+
+  public:
+    SlotPlanner(){ invalidate(); }
+
+    // hour is epoch / 3600
+    void build(const SlotRules& rules, uint32_t hour);
+    void invalidate();
+
+    // Percent mode: whether absolute slot n transmits, and the run it belongs to
+    static bool percentSlot(uint32_t n, uint8_t percent, uint32_t seed, uint32_t& run);
+    // Percent mode: most slots from one transmission to the next
+    static uint16_t maxSpacing(uint8_t percent);
+
+    bool covers(uint32_t hour) const { return _hour == hour; }
+    uint32_t hour() const { return _hour; }
+    uint8_t band(uint8_t slot) const { return _bands[slot]; }
+    uint8_t txCount() const { return _txCount; }
+};
+
+#endif /* SLOTPLANNER_H_ */
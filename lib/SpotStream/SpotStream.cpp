@@ -0,0 +1,39 @@
+/*
+  SpotStream - reads JSONEachRow answers (one JSON object per line) such as
+  wspr.live sends, a row at a time.
+*/
+#include "SpotStream.h"
+#include <string.h>
+
+bool SpotStreamReader::fill(){
+  int n = _source(_context, _buf, sizeof(_buf));
+  if(n <= 0)
+    return false;
+  _len = (size_t)n < sizeof(_buf) ? n : sizeof(_buf);
+  _pos = 0;
+  return true;
+}
+
+int SpotStreamReader::read(){
+  if(_pos == _len && !fill())
+    return -1;
+  return _buf[_pos++];
+}
+
+size_t SpotStreamReader::readBytes(char* out, size_t length){
+  size_t got = 0;
+  while(got < length && (_pos < _len || fill())){
+    size_t n = length - got < _len - _pos ? length - got : _len - _pos;
+    memcpy(out + got, _buf + _pos, n);
+    got += n;
+    _pos += n;
+  }
+  return got;
+}
+
+void copySpotText(char* dst, const char* src, size_t size){
+  size_t i = 0;
+  for(; src && src[i] && i < size - 1; i++)
+    dst[i] = (src[i] < 0x20 || src[i] == '"' || src[i] == '\\') ? '?' : src[i];
+  dst[i] = 0;
+}
@@ -0,0 +1,66 @@
+/*
+  SpotStream - reads JSONEachRow answers (one JSON object per line) such as
+  wspr.live sends, a row at a time.
+
+  ArduinoJson pulls a byte at a time; over TLS every read() is a
+  record-layer call, so SpotStreamReader refills a 512-byte block from a
+  caller-supplied source and serves the parser from it. A row may span any
+  number of blocks.
+
+  readJsonRows() parses each row into one small document, keeping only the
+  fields in the filter, and hands it to the caller before the next row
+  replaces it. It returns EmptyInput when the stream ended after a complete
+  row, InvalidInput when something other than an object came (a server error
+  message after the rows, typically), Ok when the caller stopped, and the
+  parser's error otherwise (IncompleteInput for a truncated row).
+
+  Plain C++ with no Arduino dependency, so it also builds for host tests.
+*/
+#ifndef SPOTSTREAM_H_
+#define SPOTSTREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+#define SPOT_STREAM_BLOCK 512
+
+class SpotStreamReader {
+  public:
+    // Fills buf with up to size bytes and returns how many; 0 or less at the end of the stream
+    typedef int (*BlockSource)(void* context, uint8_t* buf, size_t size);
+
+  private:
+    BlockSource _source;
+    void* _context;
+    uint8_t _buf[SPOT_STREAM_BLOCK];
+    size_t _len;
+    size_t _pos;
+
+    bool fill();
+
+  public:
+    SpotStreamReader(BlockSource source, void* context) : _source(source), _context(context), _len(0), _pos(0) {}
+
+    // The reader interface ArduinoJson expects
+    int read();
+    size_t readBytes(char* out, size_t length);
+};
+
+// onRow(JsonObjectConst row) returns false to stop
+template <typename OnRow>
+DeserializationError readJsonRows(SpotStreamReader& reader, const JsonDocument& filter, JsonDocument& row, OnRow onRow){
+  DeserializationError error;
+  while(!(error = deserializeJson(row, reader, DeserializationOption::Filter(filter)))){
+    if(!row.is<JsonObject>())
+      return DeserializationError::InvalidInput;
+    if(!onRow(row.as<JsonObjectConst>()))
+      return DeserializationError::Ok;
+  }
+  return error;
+}
+
+// Remote text ends up in hand-written JSON: keep it printable and free of quotes and escapes
+void copySpotText(char* dst, const char* src, size_t size);
+
+#endif /* SPOTSTREAM_H_ */
@@ -0,0 +1,172 @@
+/*
+  WebAssetBundle - serves the web UI straight out of a memory-mapped flash partition.
+*/
+#include "WebAssetBundle.h"
+#include "WebResponseImpl.h"
+#include "esp_rom_crc.h"
+
+WebAssetBundle::WebAssetBundle()
+  : _base(NULL)
+  , _header(NULL)
+  , _table(NULL)
+  , _mmap(0)
+{}
+
+WebAssetBundle::~WebAssetBundle(){
+  end();
+}
+
+bool WebAssetBundle::begin(const char * partitionLabel){
+  end();
+
+  const esp_partition_t * partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+  if(!partition)
+    return false;
+
+  const void * mapped = NULL;
+  if(esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped, &_mmap) != ESP_OK)
+    return false;
+
+  const uint8_t * base = (const uint8_t *)mapped;
+  const WebBundleHeader * header = (const WebBundleHeader *)base;
+  size_t tableEnd = sizeof(WebBundleHeader) + (size_t)header->tableSize * sizeof(WebBundleEntry);
+
+  // An erased or half-written partition must never be served
+  bool valid = header->magic == WEB_BUNDLE_MAGIC
+    && header->tableSize && (header->tableSize & (header->tableSize - 1)) == 0
+    && header->count <= header->tableSize
+    && header->totalSize >= tableEnd && header->totalSize <= partition->size
+    && esp_rom_crc32_le(0, base + sizeof(WebBundleHeader), header->totalSize - sizeof(WebBundleHeader)) == header->crc;
+  if(!valid){
+    spi_flash_munmap(_mmap);
+    _mmap = 0;
+    return false;
+  }
+
+  _base = base;
+  _header = header;
+  _table = (const WebBundleEntry *)(base + sizeof(WebBundleHeader));
+  return true;
+}
+
+void WebAssetBundle::end(){
+  if(_mmap)
+    spi_flash_munmap(_mmap);
+  _mmap = 0;
+  _base = NULL;
+  _header = NULL;
+  _table = NULL;
+}
+
+uint32_t WebAssetBundle::hash(const char * path, size_t len, uint32_t seed){
+  // FNV-1a, seeded; must match scripts/pack_web_bundle.py
+  uint32_t h = 2166136261UL ^ seed;
+  for(size_t i = 0; i < len; i++){
+    h ^= (uint8_t)path[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+const WebBundleEntry * WebAssetBundle::find(const char * path, size_t len) const {
+  if(!_header)
+    return NULL;
+  const WebBundleEntry * entry = &_table[hash(path, len, _header->seed) & (_header->tableSize - 1)];
+  if(entry->pathLen != len || memcmp(_base + entry->pathOffset, path, len) != 0)
+    return NULL;
+  return entry;
+}
+
+String WebAssetBundle::contentType(const WebBundleEntry * entry) const {
+  String type;
+  type.reserve(entry->typeLen);
+  for(uint8_t i = 0; i < entry->typeLen; i++)
+    type += (char)_base[entry->typeOffset + i];
+  return type;
+}
+
+String WebAssetBundle::etag(const WebBundleEntry * entry) const {
+  char tag[sizeof(entry->etag) + 3];
+  tag[0] = '"';
+  memcpy(tag + 1, entry->etag, sizeof(entry->etag));
+  tag[sizeof(entry->etag) + 1] = '"';
+  tag[sizeof(entry->etag) + 2] = '\0';
+  return String(tag);
+}
+
+/*
+ * Handler
+ * */
+
+AsyncWebBundleHandler::AsyncWebBundleHandler(WebAssetBundle& bundle, fs::FS& fallback, const char * cache_control)
+  : _bundle(bundle)
+  , _fs(fallback)
+  , _defaultFile("index.html")
+  , _cache_control(cache_control)
+{}
+
+AsyncWebBundleHandler& AsyncWebBundleHandler::setDefaultFile(const char * filename){
+  _defaultFile = String(filename);
+  return *this;
+}
+
+AsyncWebBundleHandler& AsyncWebBundleHandler::setVersionedCacheControl(const char * cache_control){
+  _versioned_cache_control = String(cache_control);
+  return *this;
+}
+
+const WebBundleEntry * AsyncWebBundleHandler::_lookup(AsyncWebServerRequest * request) const {
+  const String& url = request->url();
+  if(url.endsWith("/"))
+    return _bundle.find(url + _defaultFile);
+  return _bundle.find(url);
+}
+
+bool AsyncWebBundleHandler::canHandle(AsyncWebServerRequest * request){
+  if(request->method() != HTTP_GET
+    || !request->isExpectedRequestedConnType(RCT_DEFAULT, RCT_HTTP)
+    || !_lookup(request)
+  ){
+    return false;
+  }
+  request->addInterestingHeader("If-None-Match");
+  request->addInterestingHeader("Accept-Encoding");
+  return true;
+}
+
+void AsyncWebBundleHandler::handleRequest(AsyncWebServerRequest * request){
+  const WebBundleEntry * entry = _lookup(request);
+  if(!entry){
+    request->send(404);
+    return;
+  }
+
+  // The bundle only holds the gzipped variant; LittleFS has a plain copy only of the files the firmware reads
+  bool gzipped = entry->flags & WEB_BUNDLE_FLAG_GZIP;
+  if(gzipped && request->hasHeader("Accept-Encoding") && request->header("Accept-Encoding").indexOf("gzip") < 0){
+    String path = request->url().endsWith("/") ? request->url() + _defaultFile : request->url();
+    request->send(_fs, path);
+    return;
+  }
+
+  String etag = _bundle.etag(entry);
+  String cacheControl = _cache_control;
+  if(_versioned_cache_control.length() && request->hasParam("v")
+    && request->getParam("v")->value().equals(etag.substring(1, etag.length() - 1)))
+    cacheControl = _versioned_cache_control;
+
+  AsyncWebServerResponse * response;
+  if(request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag)){
+    response = new AsyncBasicResponse(304); // Not modified
+  } else {
+    response = new AsyncMappedResponse(200, _bundle.contentType(entry), _bundle.data(entry), entry->dataLen);
+    if(gzipped)
+      response->addHeader("Content-Encoding", "gzip");
+  }
+  if(cacheControl.length())
+    response->addHeader("Cache-Control", cacheControl);
+  response->addHeader("ETag", etag);
+  if(gzipped)
+    response->addHeader("Vary", "Accept-Encoding");
+  request->send(response);
+}
@@ -0,0 +1,98 @@
+/*
+  WebAssetBundle - serves the web UI straight out of a memory-mapped flash partition.
+
+  The bundle is produced by scripts/pack_web_bundle.py and flashed to the
+  "webassets" data partition. Layout (little endian, 4-byte aligned):
+
+    WebBundleHeader
+    WebBundleEntry[tableSize]   perfect-hash slot table, empty slots have pathLen == 0
+    strings                     paths and content types
+    payloads                    pre-gzipped where that is smaller
+
+  Paths hash with a seeded FNV-1a that the packer picked so that no two paths
+  share a slot: a lookup is one hash, one slot and one compare.
+*/
+#ifndef WEBASSETBUNDLE_H_
+#define WEBASSETBUNDLE_H_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ESPAsyncWebServer.h>
+#include "esp_partition.h"
+
+#define WEB_BUNDLE_MAGIC 0x314E4257 // "WBN1"
+#define WEB_BUNDLE_PARTITION "webassets"
+#define WEB_BUNDLE_FLAG_GZIP 0x01
+
+struct WebBundleHeader {
+  uint32_t magic;
+  uint16_t count;
+  uint16_t tableSize;   // power of two
+  uint32_t seed;
+  uint32_t totalSize;   // header included
+  uint32_t crc;         // CRC-32 of everything after the header
+  uint32_t reserved;
+};
+
+struct WebBundleEntry {
+  uint32_t pathOffset;
+  uint16_t pathLen;
+  uint8_t typeLen;
+  uint8_t flags;
+  uint32_t typeOffset;
+  uint32_t dataOffset;
+  uint32_t dataLen;
+  char etag[16];        // content hash of the uncompressed asset, as in assets.manifest
+};
+
+class WebAssetBundle {
+  private:
+    const uint8_t * _base;
+    const WebBundleHeader * _header;
+    const WebBundleEntry * _table;
+    spi_flash_mmap_handle_t _mmap;
+
+  public:
+    WebAssetBundle();
+    ~WebAssetBundle();
+
+    // Maps the partition and validates header, table bounds and CRC
+    bool begin(const char * partitionLabel = WEB_BUNDLE_PARTITION);
+    void end();
+
+    bool mounted() const { return _header != NULL; }
+    uint16_t count() const { return _header ? _header->count : 0; }
+    uint32_t size() const { return _header ? _header->totalSize : 0; }
+
+    const WebBundleEntry * find(const char * path, size_t len) const;
+    const WebBundleEntry * find(const String& path) const { return find(path.c_str(), path.length()); }
+
+    const uint8_t * data(const WebBundleEntry * entry) const { return _base + entry->dataOffset; }
+    String contentType(const WebBundleEntry * entry) const;
+    String etag(const WebBundleEntry * entry) const;
+
+    static uint32_t hash(const char * path, size_t len, uint32_t seed);
+};
+
+// Static handler for the bundle. Register it ahead of the LittleFS serveStatic:
+// whatever the bundle lacks (or a client that refuses gzip) falls through to it.
+class AsyncWebBundleHandler: public AsyncWebHandler {
+  private:
+    WebAssetBundle& _bundle;
+    fs::FS& _fs;
+    String _defaultFile;
+    String _cache_control;
+    String _versioned_cache_control;
+
+    const WebBundleEntry * _lookup(AsyncWebServerRequest * request) const;
+
+  public:
+    AsyncWebBundleHandler(WebAssetBundle& bundle, fs::FS& fallback, const char * cache_control = "no-cache");
+    AsyncWebBundleHandler& setDefaultFile(const char * filename);
+    AsyncWebBundleHandler& setVersionedCacheControl(const char * cache_control);
+    virtual bool canHandle(AsyncWebServerRequest * request) override final;
+    virtual void handleRequest(AsyncWebServerRequest * request) override final;
+    virtual const char * _statsLabel() const override { return "bundle"; }
+};
+
+#endif
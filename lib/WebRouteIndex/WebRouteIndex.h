@@ -0,0 +1,126 @@
+/*
+  WebRouteIndex - finds the web handlers that may serve a URL without asking
+  every handler in turn.
+
+  A handler that only matches on a plain path answers for that path and its
+  subpaths. Such paths sit in a table sorted by path, so a lookup is one binary
+  search per path level ("/a/b" looks up "/a" and "/a/b"). Every other handler
+  (wildcards, regex, static files, websockets...) is offered every URL. Both
+  kinds are offered a URL in registration order, so the first handler added
+  still wins, as with a walk over the whole list.
+
+  Plain C++ with no Arduino dependency, so it also builds for host tests.
+*/
+#ifndef WEBROUTEINDEX_H_
+#define WEBROUTEINDEX_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#ifndef ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES
+#define ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES 8   // Plain paths matching one URL before find() gives up
+#endif
+
+template<typename Handler>
+class WebRouteIndex {
+  private:
+    struct Route {
+      const char* uri;
+      size_t len;
+      size_t order;                   // Registration order
+      Handler* handler;
+    };
+    std::vector<Route> _routes;       // Plain paths, sorted by uri, then order
+    std::vector<Route> _scanned;      // Everything else, in registration order
+    size_t _count;
+
+    static int compare(const char* a, size_t alen, const char* b, size_t blen){
+      int c = memcmp(a, b, std::min(alen, blen));
+      if(c)
+        return c;
+      return (alen < blen) ? -1 : (alen > blen) ? 1 : 0;
+    }
+
+    static bool before(const Route& a, const Route& b){
+      int c = compare(a.uri, a.len, b.uri, b.len);
+      return c < 0 || (c == 0 && a.order < b.order);
+    }
+
+  public:
+    WebRouteIndex(): _count(0) {}
+
+    void clear(){
+      _routes.clear();
+      _scanned.clear();
+      _count = 0;
+    }
+
+    // In registration order. uri is the handler's plain path, which must outlive the index,
+    // or NULL for a handler to offer every URL.
+    void add(Handler* handler, const char* uri, size_t len){
+      if(uri)
+        _routes.push_back({uri, len, _count, handler});
+      else
+        _scanned.push_back({NULL, 0, _count, handler});
+      _count++;
+    }
+
+    // After the last add(), before find()
+    void sort(){
+      std::sort(_routes.begin(), _routes.end(), before);
+    }
+
+    size_t size() const { return _count; }
+
+    /*
+      Offers url to the handlers that may serve it, in registration order,
+      until accept(handler) returns true, and returns that handler, or NULL.
+      When more than ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES plain paths match,
+      nothing is offered: overflow is set and the caller asks every handler.
+    */
+    template<typename Accept>
+    Handler* find(const char* url, size_t urlLen, Accept accept, bool& overflow) const {
+      const Route* candidates[ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES];
+      size_t count = 0;
+      overflow = false;
+      for(size_t end = 1; end <= urlLen; end++){
+        if(end != urlLen && url[end] != '/')
+          continue;
+        auto it = std::lower_bound(_routes.begin(), _routes.end(), end, [url](const Route& r, size_t len){
+          return compare(r.uri, r.len, url, len) < 0;
+        });
+        for(; it != _routes.end() && compare(it->uri, it->len, url, end) == 0; ++it){
+          if(count == ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES){
+            overflow = true;
+            return NULL;
+          }
+          // Keep candidates in registration order
+          size_t pos = count++;
+          while(pos && candidates[pos - 1]->order > it->order){
+            candidates[pos] = candidates[pos - 1];
+            pos--;
+          }
+          candidates[pos] = &*it;
+        }
+      }
+
+      size_t next = 0;
+      for(const Route& s: _scanned){
+        for(; next < count && candidates[next]->order < s.order; next++){
+          if(accept(candidates[next]->handler))
+            return candidates[next]->handler;
+        }
+        if(accept(s.handler))
+          return s.handler;
+      }
+      for(; next < count; next++){
+        if(accept(candidates[next]->handler))
+          return candidates[next]->handler;
+      }
+      return NULL;
+    }
+};
+
+#endif /* WEBROUTEINDEX_H_ */
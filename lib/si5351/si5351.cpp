@@ -42,6 +42,10 @@ Si5351::Si5351(uint8_t i2c_addr):
 	plla_ref_osc = SI5351_PLL_INPUT_XO;
 	pllb_ref_osc = SI5351_PLL_INPUT_XO;
 	clkin_div = SI5351_CLKIN_DIV_1;
+
+	i2c_stats.transactions = 0;
+	i2c_stats.bytes = 0;
+	i2c_stats.errors = 0;
 }
 
 /*
@@ -1315,7 +1319,9 @@ uint8_t Si5351::si5351_write_bulk(uint8_t addr, uint8_t bytes, uint8_t *data)
 	{
 		Wire.write(data[i]);
 	}
-	return Wire.endTransmission();
+	uint8_t ret = Wire.endTransmission();
+	count_i2c(bytes + 1, ret);
+	return ret;
 
 }
 
@@ -1324,7 +1330,9 @@ uint8_t Si5351::si5351_write(uint8_t addr, uint8_t data)
 	Wire.beginTransmission(i2c_bus_addr);
 	Wire.write(addr);
 	Wire.write(data);
-	return Wire.endTransmission();
+	uint8_t ret = Wire.endTransmission();
+	count_i2c(2, ret);
+	return ret;
 }
 
 uint8_t Si5351::si5351_read(uint8_t addr)
@@ -1333,9 +1341,10 @@ uint8_t Si5351::si5351_read(uint8_t addr)
 
 	Wire.beginTransmission(i2c_bus_addr);
 	Wire.write(addr);
-	Wire.endTransmission();
+	count_i2c(1, Wire.endTransmission());
 
-	Wire.requestFrom(i2c_bus_addr, (uint8_t)1, (uint8_t)false);
+	// A short read counts as an error, like a failed write
+	count_i2c(1, Wire.requestFrom(i2c_bus_addr, (uint8_t)1, (uint8_t)false) == 1 ? 0 : 4);
 
 	while(Wire.available())
 	{
@@ -1349,6 +1358,16 @@ uint8_t Si5351::si5351_read(uint8_t addr)
 /* Private functions */
 /*********************/
 
+void Si5351::count_i2c(uint8_t bytes, uint8_t result)
+{
+	i2c_stats.transactions.fetch_add(1, std::memory_order_relaxed);
+	i2c_stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	if(result != 0)
+	{
+		i2c_stats.errors.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
 uint64_t Si5351::pll_calc(enum si5351_pll pll, uint64_t freq, struct Si5351RegSet *reg, int32_t correction, uint8_t vcxo)
 {
 	uint64_t ref_freq;
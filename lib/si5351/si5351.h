@@ -32,6 +32,7 @@
 #include "Arduino.h"
 #include "Wire.h"
 #include <stdint.h>
+#include <atomic>
 
 /* Define definitions */
 
@@ -276,6 +277,14 @@ struct Si5351IntStatus
 	uint8_t LOS_STKY;
 };
 
+/* I2C traffic counters, readable from any task while the driver runs */
+struct Si5351I2CStats
+{
+	std::atomic<uint32_t> transactions;
+	std::atomic<uint32_t> bytes;
+	std::atomic<uint32_t> errors;
+};
+
 class Si5351
 {
 public:
@@ -317,7 +326,9 @@ public:
   enum si5351_pll_input plla_ref_osc;
   enum si5351_pll_input pllb_ref_osc;
 	uint32_t xtal_freq[2];
+	struct Si5351I2CStats i2c_stats;
 private:
+	void count_i2c(uint8_t, uint8_t);
 	uint64_t pll_calc(enum si5351_pll, uint64_t, struct Si5351RegSet *, int32_t, uint8_t);
 	uint64_t multisynth_calc(uint64_t, uint64_t, struct Si5351RegSet *);
 	uint64_t multisynth67_calc(uint64_t, uint64_t, struct Si5351RegSet *);
@@ -0,0 +1,187 @@
+# Pre-build step for the LittleFS image (pio run -t buildfs / uploadfs).
+#
+# The image is built from a staged copy of data/ (data_dir in platformio.ini), so
+# LittleFS holds one copy of each asset and nothing the firmware does not use:
+#
+# - text assets are staged gzipped only (<file>.gz); the web server picks the .gz
+#   up for the plain path
+# - files the firmware reads itself stay plain: index.html is a template,
+#   cesium.key is inlined into it
+# - private files (keys, editor leftovers) are never served: the manifest is the
+#   firmware's allowlist; the ones the firmware does not read are not staged at all
+# - hashes every asset and writes assets.manifest ("<path> <hash>" per line),
+#   used by the firmware for strong ETags
+# - appends ?v=<hash> to local asset references inside the HTML, so those assets
+#   can be cached for a year and are re-fetched only when their content changes
+# - fails the build when the image plus the files the firmware writes at run time
+#   (the record rings of src/WIP.cpp, the log) do not fit the LittleFS partition
+#
+# Can also be run by hand: python scripts/gzip_web_assets.py
+
+import csv
+import gzip
+import hashlib
+import io
+import os
+import re
+import shutil
+
+SOURCE_DIR = "data"
+STAGE_DIR = os.path.join(".pio", "littlefs")  # Hand runs; PlatformIO passes its data_dir
+COMPRESSIBLE = (".html", ".htm", ".css", ".js", ".json", ".svg", ".ico", ".ttf")
+MANIFEST = "assets.manifest"
+PRIVATE_SUFFIXES = (".key",)
+PRIVATE_FILES = ("/indexORI.html", "/pinegrow.json")
+FIRMWARE_FILES = ("/index.html", "/cesium.key")  # Opened by the firmware, so staged as they are
+
+FS_PARTITION = "spiffs"
+FS_BLOCK = 4096
+FS_SPARE_BLOCKS = 8         # Copy-on-write headroom: open appends, metadata compaction
+RING_SLOT_OVERHEAD = 12     # Magic, sequence and CRC around each record (lib/RecordRing)
+RINGS = (("TX_HISTORY", "TxHistoryRecord"), ("SPOT_CACHE", "SpotCacheRecord"))
+LOG_FILE_BYTES = 64 * 1024  # DeferredLogFileSink rotation size, kept twice with the .1 copy
+
+
+def is_web_asset(url):
+    return not url.endswith(PRIVATE_SUFFIXES) and url not in PRIVATE_FILES
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def gzip_bytes(data):
+    # mtime=0 keeps the output byte-identical between builds
+    out = io.BytesIO()
+    with gzip.GzipFile(fileobj=out, mode="wb", compresslevel=9, mtime=0) as gz:
+        gz.write(data)
+    return out.getvalue()
+
+
+def write_file(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as out:
+        out.write(data)
+
+
+def build_assets(source_dir, stage_dir):
+    if os.path.realpath(stage_dir) == os.path.realpath(source_dir):
+        raise RuntimeError("the LittleFS image is staged from %s, so data_dir must point elsewhere" % source_dir)
+    if os.path.isdir(stage_dir):
+        shutil.rmtree(stage_dir)
+    os.makedirs(stage_dir)
+
+    assets = {}
+    for root, dirs, files in os.walk(source_dir):
+        dirs[:] = [d for d in dirs if not d.startswith("_")]
+        for name in files:
+            if name.endswith(".gz") or name == MANIFEST:
+                continue  # Left in data/ by older builds
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, source_dir).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                data = f.read()
+            if is_web_asset(url):
+                assets[url] = data
+            elif url in FIRMWARE_FILES:
+                write_file(os.path.join(stage_dir, url[1:]), data)
+
+    # HTML is never versioned (always revalidated), so only other assets get ?v= references
+    static_hashes = {url: content_hash(data) for url, data in assets.items() if not url.endswith((".html", ".htm"))}
+    hashes = dict(static_hashes)
+
+    for url, data in sorted(assets.items()):
+        if url.endswith((".html", ".htm")):
+            text = data.decode("utf-8")
+            for ref, ref_hash in static_hashes.items():
+                for quote in ('"', "'"):
+                    for prefix in ("", "/"):
+                        needle = quote + prefix + ref[1:] + quote
+                        text = text.replace(needle, quote + prefix + ref[1:] + "?v=" + ref_hash + quote)
+            data = text.encode("utf-8")
+            hashes[url] = content_hash(data)
+
+        path = os.path.join(stage_dir, url[1:])
+        packed = gzip_bytes(data) if url.endswith(COMPRESSIBLE) and url not in FIRMWARE_FILES else data
+        if len(packed) < len(data):
+            write_file(path + ".gz", packed)
+        else:
+            write_file(path, data)
+
+    with open(os.path.join(stage_dir, MANIFEST), "w") as manifest:
+        for url in sorted(hashes):
+            manifest.write("%s %s\n" % (url, hashes[url]))
+
+    print("Web assets: %d hashed, staged in %s" % (len(hashes), stage_dir))
+
+
+def partition(csv_path, name):
+    with open(csv_path) as f:
+        for row in csv.reader(line for line in f if not line.lstrip().startswith("#")):
+            if row and row[0].strip() == name:
+                return int(row[3].strip(), 0), int(row[4].strip(), 0)
+    raise RuntimeError("partition '%s' not found in %s" % (name, csv_path))
+
+
+def blocks(size):
+    return max(1, -(-size // FS_BLOCK))
+
+
+def image_blocks(stage_dir):
+    total = 2  # Superblock and root directory metadata pair
+    for root, dirs, files in os.walk(stage_dir):
+        total += 2 * len(dirs)
+        total += sum(blocks(os.path.getsize(os.path.join(root, name))) for name in files)
+    return total
+
+
+def runtime_blocks(firmware_path):
+    with open(firmware_path) as f:
+        source = f.read()
+
+    def define(name):
+        match = re.search(r"^#define %s\s+(\w+)" % name, source, re.M)
+        if not match:
+            raise RuntimeError("%s not found in %s" % (name, firmware_path))
+        return match.group(1)
+
+    total = 0
+    for prefix, record in RINGS:
+        match = re.search(r"static_assert\(sizeof\(%s\) == (\d+)" % record, source)
+        if not match:
+            raise RuntimeError("size of %s not found in %s" % (record, firmware_path))
+        segment = blocks(int(define(prefix + "_SEGMENT_RECORDS")) * (int(match.group(1)) + RING_SLOT_OVERHEAD))
+        # One segment more than kept: the oldest lingers while a reader holds it open
+        total += 2 + (int(define(prefix + "_SEGMENTS")) + 1) * segment
+    if define("LOG_TO_FILE") == "true":
+        total += 2 * blocks(LOG_FILE_BYTES)
+    return total
+
+
+def check_fits(stage_dir, firmware_path, partitions_path):
+    available = partition(partitions_path, FS_PARTITION)[1] // FS_BLOCK
+    image = image_blocks(stage_dir)
+    runtime = runtime_blocks(firmware_path)
+    needed = image + runtime + FS_SPARE_BLOCKS
+    print("LittleFS: image %d + run-time files %d + spare %d = %d of %d blocks" % (image, runtime, FS_SPARE_BLOCKS, needed, available))
+    if needed > available:
+        raise RuntimeError("LittleFS needs %d blocks of %d bytes, the '%s' partition has %d" % (needed, FS_BLOCK, FS_PARTITION, available))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+
+    def before_fs_image(source, target, env):
+        project = env.subst("$PROJECT_DIR")
+        stage = env.subst("$PROJECT_DATA_DIR")
+        build_assets(os.path.join(project, SOURCE_DIR), stage)
+        check_fits(stage, os.path.join(project, "src", "WIP.cpp"),
+                   os.path.join(project, env.GetProjectOption("board_build.partitions")))
+
+    os.makedirs(env.subst("$PROJECT_DATA_DIR"), exist_ok=True)  # noqa: F821 - the image target needs it to exist
+    env.AddPreAction("$BUILD_DIR/${ESP32_FS_IMAGE_NAME}.bin", before_fs_image)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        build_assets(os.path.join(root, SOURCE_DIR), os.path.join(root, STAGE_DIR))
+        check_fits(os.path.join(root, STAGE_DIR), os.path.join(root, "src", "WIP.cpp"), os.path.join(root, "partitions.csv"))
@@ -0,0 +1,138 @@
+# Packs the web UI into a single flash-mapped bundle (pio run -t uploadwebbundle).
+#
+# The firmware maps the "webassets" partition and serves straight from it
+# (lib/WebAssetBundle): no LittleFS open/read per request, no heap copy of the body.
+#
+# - runs gzip_web_assets first, so payloads and hashes match the LittleFS image
+# - stores the gzipped variant whenever it is smaller, the plain file otherwise
+# - packs only the manifest's public assets (no keys or editor files)
+# - searches an FNV-1a seed that gives every path its own slot (perfect hash)
+#
+# Can also be run by hand: python scripts/pack_web_bundle.py [out.bin]
+
+import mimetypes
+import os
+import struct
+import sys
+import zlib
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)) if "__file__" in globals() else "scripts")
+from gzip_web_assets import COMPRESSIBLE, MANIFEST, SOURCE_DIR, STAGE_DIR, build_assets, gzip_bytes, is_web_asset, partition  # noqa: E402
+
+MAGIC = 0x314E4257  # "WBN1"
+FLAG_GZIP = 0x01
+HEADER = struct.Struct("<IHHIIII")
+ENTRY = struct.Struct("<IHBBIII16s")
+PARTITION = "webassets"
+
+CONTENT_TYPES = {
+    ".html": "text/html", ".htm": "text/html", ".css": "text/css", ".js": "application/javascript",
+    ".json": "application/json", ".svg": "image/svg+xml", ".ico": "image/x-icon", ".png": "image/png",
+    ".jpg": "image/jpeg", ".gif": "image/gif", ".ttf": "application/x-font-ttf",
+}
+
+
+def fnv1a(data, seed):
+    h = 2166136261 ^ seed
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def find_seed(paths, table_size):
+    for seed in range(1 << 20):
+        slots = {fnv1a(p, seed) & (table_size - 1) for p in paths}
+        if len(slots) == len(paths):
+            return seed
+    raise RuntimeError("no collision-free seed for %d paths in %d slots" % (len(paths), table_size))
+
+
+def align4(buf):
+    buf.extend(b"\0" * (-len(buf) % 4))
+
+
+def pack_bundle(source_dir, stage_dir, out_path):
+    build_assets(source_dir, stage_dir)
+
+    assets = []
+    with open(os.path.join(stage_dir, MANIFEST)) as manifest:
+        for line in manifest:
+            url, digest = line.split()
+            if not is_web_asset(url):
+                continue  # Stale manifest: never pack keys or editor files
+            path = os.path.join(stage_dir, url[1:])
+            flags = 0
+            if os.path.exists(path + ".gz"):
+                path += ".gz"
+                flags = FLAG_GZIP
+            with open(path, "rb") as f:
+                body = f.read()
+            if not flags and url.endswith(COMPRESSIBLE):
+                packed = gzip_bytes(body)  # Staged plain because the firmware reads it (index.html)
+                if len(packed) < len(body):
+                    body = packed
+                    flags = FLAG_GZIP
+            ext = os.path.splitext(url)[1].lower()
+            ctype = CONTENT_TYPES.get(ext) or mimetypes.guess_type(url)[0] or "application/octet-stream"
+            assets.append((url.encode(), ctype.encode(), flags, digest.encode(), body))
+
+    # 4x the slots keeps the seed search short; a slot is only 36 bytes
+    table_size = 1
+    while table_size < 4 * len(assets):
+        table_size <<= 1
+    seed = find_seed([a[0] for a in assets], table_size)
+
+    strings_at = HEADER.size + table_size * ENTRY.size
+    strings = bytearray()
+    payloads = bytearray()
+    placed = []
+    for url, ctype, flags, digest, body in assets:
+        path_off = strings_at + len(strings)
+        strings += url
+        type_off = strings_at + len(strings)
+        strings += ctype
+        placed.append((url, ctype, flags, digest, body, path_off, type_off))
+    align4(strings)
+
+    table = [ENTRY.pack(0, 0, 0, 0, 0, 0, 0, b"\0" * 16)] * table_size
+    payloads_at = strings_at + len(strings)
+    for url, ctype, flags, digest, body, path_off, type_off in placed:
+        data_off = payloads_at + len(payloads)
+        payloads += body
+        align4(payloads)
+        slot = fnv1a(url, seed) & (table_size - 1)
+        table[slot] = ENTRY.pack(path_off, len(url), len(ctype), flags, type_off, data_off, len(body), digest)
+
+    body = b"".join(table) + bytes(strings) + bytes(payloads)
+    header = HEADER.pack(MAGIC, len(assets), table_size, seed, HEADER.size + len(body), zlib.crc32(body) & 0xFFFFFFFF, 0)
+    with open(out_path, "wb") as out:
+        out.write(header + body)
+
+    print("Web bundle: %d assets, %d bytes, seed %d, %d slots -> %s" % (len(assets), HEADER.size + len(body), seed, table_size, out_path))
+    return HEADER.size + len(body)
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+
+    def upload_bundle(source, target, env):
+        table = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions"))
+        offset, size = partition(table, PARTITION)
+        out = env.subst("$BUILD_DIR/webassets.bin")
+        if pack_bundle(os.path.join(env.subst("$PROJECT_DIR"), SOURCE_DIR), env.subst("$PROJECT_DATA_DIR"), out) > size:
+            raise RuntimeError("web bundle does not fit the %d byte '%s' partition" % (size, PARTITION))
+        env.AutodetectUploadPort()
+        return env.Execute(" ".join([
+            '"$PYTHONEXE"', '"$UPLOADER"', "--chip", "esp32", "--port", '"$UPLOAD_PORT"', "--baud", "$UPLOAD_SPEED",
+            "write_flash", "0x%x" % offset, '"%s"' % out]))
+
+    env.AddCustomTarget(  # noqa: F821
+        name="uploadwebbundle",
+        dependencies=None,
+        actions=[upload_bundle],
+        title="Upload Web Bundle",
+        description="Pack data/ into the flash-mapped web asset bundle and flash it")
+except NameError:
+    if __name__ == "__main__":
+        root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+        pack_bundle(os.path.join(root, SOURCE_DIR), os.path.join(root, STAGE_DIR), sys.argv[1] if len(sys.argv) > 1 else "webassets.bin")
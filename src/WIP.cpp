@@ -9,10 +9,23 @@
 #include <JTEncode.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/event_groups.h>
 #include <time.h>
 #include <ArduinoJson.h>
+#include <atomic>
+#include <memory>
+#include <AsyncJson.h>
 #include <ESPmDNS.h> // Library to enable mDNS (Multicast DNS) for resolving local hostnames like "device.local"
 #include <TinyGPS++.h>
+#include <WiFiUdp.h>
+#include <NTPClient.h>
+#include <HTTPClient.h>
+#include <WebAssetBundle.h>
+#include <DeferredLog.h>
+#include <FrequencyPlanner.h>
+#include <SlotPlanner.h>
+#include <SpotStream.h>
+#include <RecordRing.h>
 #define SI5351_SDA 25
 #define SI5351_SCL 26
 #define GPS_RX 16             // GPS TX → ESP32 RX2
@@ -26,18 +39,94 @@ HardwareSerial GPSserial(2);
 extern "C"
 {
 #include "esp_sntp.h"
+#include "esp_rom_crc.h"
+#include "esp_private/esp_clk.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "esp_heap_caps.h"
+#include "nvs.h"
 }
-// Wi-Fi credentials
-const char *ssid = "MESH";
-const char *password = "Nestle2010Nestle";
+// Wi-Fi credentials, provisioned through the access point page (data/ap.html) and kept in NVS
+char wifiSSID[33] = "";
+char wifiPassword[65] = "";
 const char *hostname = "wspr";
+const char *apSSID = "WSPR-CONFIG";
+bool apModeActive = false;
+String scannedNetworksJson;
 
 bool TEST=true;
 
-// Globals for DHCP-learned values
+// 📝 Deferred logging: the TX path only queues binary records, a core-0 task formats them
+#define SYSLOG_HOST ""          // e.g. "192.168.1.10" to mirror the log to a syslog server
+#define SYSLOG_PORT 514
+#define LOG_TO_FILE false       // Keep the log in LittleFS as well (/log.txt, rotated at 64 KB)
+#define LOG_FILE_PATH "/log.txt"
+
+enum LogEvent : uint16_t
+{
+    LOG_CURRENT_TIME,
+    LOG_NEXT_TX_TIME,
+    LOG_COUNTDOWN,
+    LOG_WAIT_INTERRUPTED,
+    LOG_TX_CANCELLED,
+    LOG_WARMUP_START,
+    LOG_TX_FREQUENCY,
+    LOG_TX_ENCODED,
+    LOG_TX_START,
+    LOG_TX_SYMBOL,
+    LOG_TX_INTERRUPTED,
+    LOG_TX_COMPLETE,
+    LOG_TX_DURATION,
+    LOG_TX_DELTA,
+    LOG_TX_EDGES,
+    LOG_TX_CURRENT,
+    LOG_PLAN_BUILT,
+    LOG_PLAN_EMPTY,
+    LOG_BAND_SWITCH,
+    LOG_EVENT_COUNT
+};
+
+// Indexed by LogEvent. Arguments are 32-bit; %s only for literals and constant tables
+const char *const logEventFormats[] = {
+    "🕒 Current time: %02u:%02u:%02u",
+    "🕑 Next TX Time: %02u:%02u:%02u",
+    "\r⏳ TX starts in %d s   ",
+    "⚠️ Ongoing waiting for next transmission interrupted",
+    "⚠️ Next transmission cancelled",
+    "🔥 Radio Module 'Warming Up' Phase Started to stabilize ...(5s before begin)",
+    "📶 Setting TX Frequency to: %u.%03u.%03u (%s band, quietest part of the sub-band)",
+    "📝 WSPR message encoded: %d dBm",
+    "--- TX ON: Transmission Started at %02u:%02u:%02u ---",
+    "\r📡 Transmitting symbol %u of %u (%u%%)   ",
+    "⚠️ Ongoing transmission interrupted",
+    "📴 --- TX OFF: Transmission Complete ---",
+    "⏱️ TX Duration: %u ms (%02u:%02u & %03u ms)",
+    "📏 Delta vs Reference (110592 ms): %+d ms",
+    "🎯 Symbol edges vs their deadlines: max %u µs, RMS %u µs",
+    "🔋 Estimated average current: %u.%u mA (last full hour: %u.%u mA)",
+    "🗓️ Slot plan for %02u:00 UTC: %u of 30 slots transmit (%s, %s band hopping)",
+    "❌ No slot planned in the next %u hours: no enabled band inside its time window",
+    "✅ Switching to band index %u (%s)",
+};
+static_assert(sizeof(logEventFormats) / sizeof(logEventFormats[0]) == LOG_EVENT_COUNT, "logEventFormats out of sync with LogEvent");
+
+// Expand to several record arguments
+#define LOG_HMS(t) (uint32_t)(((t) % 86400) / 3600), (uint32_t)(((t) % 3600) / 60), (uint32_t)((t) % 60)
+#define LOG_FREQ(f) (uint32_t)((f) / 1000000UL), (uint32_t)((f) / 1000UL % 1000UL), (uint32_t)((f) % 1000UL)
+#define LOG_TENTHS(x) (uint32_t)((x) * 10.0f + 0.5f) / 10, (uint32_t)((x) * 10.0f + 0.5f) % 10
+
+DeferredLogPrintSink serialLogSink(Serial);
+DeferredLogSyslogSink syslogSink(SYSLOG_HOST, "wspr", "wspr", SYSLOG_PORT);
+DeferredLogFileSink fileLogSink(FILESYSTEM, LOG_FILE_PATH);
+
+// Globals for DHCP-learned values (cached in NVS for the fast static reconnect)
 IPAddress dhcp_ip;
 IPAddress dhcp_gateway;
 IPAddress dhcp_subnet;
+IPAddress dhcp_dns;
+uint8_t wifiBSSID[6];
+int32_t wifiChannel = 0;
 
 // Static DNS (hardcoded)
 IPAddress secondaryDNS(1, 1, 1, 1); // 🔵 Cloudflare DNS
@@ -57,9 +146,6 @@ JTEncode jtencode;
 // Create the TinyGPSPlus object
 TinyGPSPlus gps;
 
-// Create a Preferences object for storing and retrieving key-value
-Preferences preferences;
-
 // Calibration variables
 int32_t cal_factor = 0;
 int calFrequencyInMhz = 14;
@@ -73,6 +159,68 @@ const unsigned long timeReSynchInterval = 5 * 60 * 1000; // 5 minutes
 time_t lastManualSync = 0;                                // Last time we did a manual sync
 bool performCalibration = false;
 bool calibrationStarted = false;
+
+// ⏱️ Time holdover kept in RTC memory: survives software resets, crashes and
+// watchdog resets (not power loss), so a warm boot can schedule immediately.
+#define HOLDOVER_MAGIC 0x57535052           // "WSPR"
+#define GPS_SYNC_ERROR_US 500000            // NMEA sentence latency, no PPS
+#define HOLDOVER_MAX_ERROR_US 1000000       // Largest error still good enough to schedule a slot (WSPR decodes to about ±2 s DT)
+#define HOLDOVER_DEFAULT_DRIFT_PPM 200      // RTC slow-clock tolerance before a drift estimate exists
+#define HOLDOVER_RESIDUAL_DRIFT_PPM 20      // Tolerance left once the drift has been measured
+static_assert(HOLDOVER_MAX_ERROR_US >= 2 * GPS_SYNC_ERROR_US, "A GPS-disciplined holdover needs headroom for RTC drift");
+#define TIME_SOURCE_NONE 0
+#define TIME_SOURCE_GPS 1
+#define TIME_SOURCE_NTP 2
+#define TIME_SOURCE_HOLDOVER 3
+
+struct TimeHoldover
+{
+    uint32_t magic;
+    uint64_t rtcUs;        // esp_clk_rtc_time() when the clock was last disciplined
+    int64_t epochUs;       // UTC at that instant
+    int32_t driftPpb;      // RTC rate error, positive when the RTC runs fast
+    uint8_t driftValid;    // driftPpb has been measured at least once
+    uint8_t source;        // TIME_SOURCE_* of the last discipline
+    uint8_t inCalibration; // Calibration mode was active
+    uint32_t syncErrorUs;  // Error bound of the last discipline
+    uint64_t driftBaseRtcUs;   // Sync the drift is measured from, kept across re-syncs
+    int64_t driftBaseEpochUs;
+    uint32_t driftBaseErrorUs;
+    int32_t calFactor;     // Live Si5351 correction (may not be saved to NVS yet)
+    uint32_t crc;
+};
+RTC_NOINIT_ATTR TimeHoldover timeHoldover;
+portMUX_TYPE holdoverMux = portMUX_INITIALIZER_UNLOCKED; // timeHoldover is written from loop(), the web server and the time tasks
+uint8_t timeSource = TIME_SOURCE_NONE;
+TaskHandle_t timeVerifyTaskHandle = NULL;
+bool warmBoot = false;
+
+// 🚀 Boot orchestrator: each stage is a task that starts once its dependencies are done
+#define BOOT_FS BIT0
+#define BOOT_SETTINGS BIT1
+#define BOOT_WIFI BIT2
+#define BOOT_TIME BIT3
+#define BOOT_SI5351 BIT4
+#define BOOT_WEB BIT5
+#define BOOT_ALL (BOOT_FS | BOOT_SETTINGS | BOOT_WIFI | BOOT_TIME | BOOT_SI5351 | BOOT_WEB)
+#define BOOT_READY_TO_TX (BOOT_SETTINGS | BOOT_TIME | BOOT_SI5351)
+
+struct BootStage
+{
+    const char *name;
+    EventBits_t bit;
+    EventBits_t dependsOn;
+    bool (*run)();         // false: the stage's bit is never set, so what depends on it never starts
+    unsigned long startMs; // millis() since power-on
+    unsigned long endMs;
+    bool failed;
+};
+EventGroupHandle_t bootEvents = NULL;
+unsigned long bootReadyToTxMs = 0;
+portMUX_TYPE bootSummaryMux = portMUX_INITIALIZER_UNLOCKED;
+bool bootSummaryPrinted = false;
+EventBits_t bootFailedStages = 0; // Under bootSummaryMux
+
 // Timing variables
 volatile bool isFirstIteration = true;
 volatile bool interruptWSPRcurrentTX = false;
@@ -85,12 +233,27 @@ time_t intervalBetweenTx;
 int modeOfOperation = 2;    // inherited from MLA toolbox
 byte selectedBandIndex = 3; // inherited from MLA toolbox
 unsigned long now;
+// 💤 Low-power idle between transmissions (modem sleep + automatic light sleep)
+#define LOW_POWER_WAKE_LEAD_S 10 // Wake this long before the slot: warm-up starts 5 s before TX
+#define POWER_STATE_ACTIVE 0
+#define POWER_STATE_IDLE 1
+#define POWER_STATE_TX 2
+// Nominal supply currents per state (mA), used to estimate the hourly average; tune with a meter
+const float powerStateCurrent_mA[] = {110.0, 6.0, 140.0};
+bool lowPowerIdle = false; // User setting
+bool lowPowerActive = false;
+bool autoLightSleep = false; // esp_pm light sleep available in this build
+byte powerState = POWER_STATE_ACTIVE;
+unsigned long powerStateSince = 0;
+unsigned long powerStateMs[3] = {0, 0, 0};
+unsigned long powerWindowStart = 0;
+float lastHourAverage_mA = 0;
+
 // TX status
 bool tx_is_ON = false;
 int tx_ON_running_time_in_s = 0;
 
 #define TONE_SPACING 146 // ~1.46 Hz
-#define WSPR_DELAY 683   // Delay value for WSPR
 #define WSPR_CTC 10672   // CTC value for WSPR
 #define SYMBOL_COUNT WSPR_SYMBOL_COUNT
 
@@ -99,27 +262,296 @@ int tx_ON_running_time_in_s = 0;
 
 #define SI5351_REF 25000000UL // si5351’s crystal frequency, 25 Mhz or 27 MHz
 uint8_t tx_buffer[SYMBOL_COUNT];
-// Reference duration for a full WSPR message
-const unsigned long WSPR_REFERENCE_DURATION_MS = 110646;
+// Reference duration for a full WSPR message: 162 symbols of 8192 / 12000 s
+const unsigned long WSPR_REFERENCE_DURATION_MS = 110592;
 // Async web server runs on port 80
 AsyncWebServer server(80);
+// 🗂️ Content hashes of the web assets, generated by scripts/gzip_web_assets.py
+#define MAX_WEB_ASSETS 32
+struct WebAssetHash
+{
+    char path[40];
+    char hash[17];
+};
+WebAssetHash webAssetHashes[MAX_WEB_ASSETS];
+byte numWebAssetHashes = 0;
+// ⚡ Same assets packed into the flash-mapped "webassets" partition (scripts/pack_web_bundle.py)
+WebAssetBundle webBundle;
+
+// 📣 Server-Sent Events: state changes are pushed instead of polled
+AsyncEventSource events("/events");
+#define EVENTS_KEEPALIVE_MS 15000
+
+// Last state pushed on /events; only fields that differ are sent again
+struct PublishedState
+{
+    long currentRemainingSeconds;
+    int txRunningTime;
+    unsigned long long TX_referenceFrequ;
+    unsigned long long WSPR_TX_operatingFrequ;
+    long intervalBetweenTx;
+    int modeOfOperation;
+    int selectedBandIndex;
+    uint32_t power;
+    char callsign[8];
+    char locator[7];
+};
+PublishedState publishedState;
+bool publishedStateValid = false;
+unsigned long lastEventMs = 0;
+
+// 📡 Binary telemetry on /ws: little-endian packed structs, first byte is the message type
+AsyncWebSocket telemetry("/ws");
+#define WSPR_SYMBOL_EDGE_US(n) ((uint32_t)((uint64_t)(n) * 8192000000ULL / 12000)) // Start of symbol n: n * 8192 / 12000 s
+#define WS_MSG_SYMBOL 0x01           // Device → client: per-symbol TX progress
+#define WS_MSG_CALIBRATION 0x02      // Device → client: current calibration factor
+#define WS_CMD_SET_CALIBRATION 0x81  // Client → device: apply a calibration factor (not saved)
+
+struct __attribute__((packed)) WsSymbolMessage
+{
+    uint8_t type;
+    uint8_t index;       // 0..161
+    uint8_t tone;        // 0..3
+    int32_t edgeErrorUs; // Actual minus ideal symbol edge, relative to the first symbol
+};
+
+struct __attribute__((packed)) WsCalibrationMessage
+{
+    uint8_t type;       // WS_MSG_CALIBRATION or WS_CMD_SET_CALIBRATION
+    int32_t calFactor;
+};
+
+// Symbol messages reuse these once every client has sent them, so txPublisherTask never allocates
+#define SYMBOL_BUFFERS 4
+AsyncWebSocketMessageBuffer *symbolBuffers[SYMBOL_BUFFERS];
+
+// The symbol loop only queues its progress; txPublisherTask does the /ws and /events sends on core 0
+#define TX_PROGRESS_QUEUE_LEN 8
+QueueHandle_t txProgressQueue = NULL;
+// Serializes /events publishing between the loop and txPublisherTask (recursive: publishTxEvent → publishState)
+SemaphoreHandle_t eventsLock = NULL;
+
+// Live calibration factor asked for by the web UI, applied by loop() (sole Si5351 user) in calibration mode
+#define CAL_FACTOR_NONE INT32_MIN
+std::atomic<int32_t> requestedCalFactor(CAL_FACTOR_NONE);
+
+// 📈 Runtime counters for /metrics: updated lock-free on the TX path, read by the web task
+#define SYMBOL_JITTER_BUCKETS 6
+const uint32_t symbolJitterBoundsUs[SYMBOL_JITTER_BUCKETS - 1] = {100, 500, 1000, 2000, 5000}; // Last bucket is +Inf
+std::atomic<uint32_t> symbolJitterBuckets[SYMBOL_JITTER_BUCKETS]; // |symbol edge - its deadline|, per bucket
+std::atomic<uint32_t> symbolJitterCount(0);
+std::atomic<uint32_t> symbolJitterSumUs(0);
+std::atomic<uint32_t> txCompleted(0);
+std::atomic<uint32_t> txInterrupted(0);
+std::atomic<int32_t> txLastDurationDeltaMs(0); // Measured minus WSPR_REFERENCE_DURATION_MS
+std::atomic<int32_t> txLastEdgeDriftUs(0);     // Edge error of the last symbol
+std::atomic<uint32_t> txLastJitterMaxUs(0);
+std::atomic<uint32_t> txLastJitterRmsUs(0);
+std::atomic<int32_t> timeLastStepUs(0); // Clock step applied by the last sync (0 for plain SNTP)
+TaskHandle_t loopTaskHandle = NULL;
+
+// 📜 Transmission history: one fixed-size record per TX, appended to segment files in /history.
+// The TX path only queues the record; historyWriterTask does the flash write.
+#define TX_HISTORY_DIR "/history"
+#define TX_HISTORY_SEGMENT_RECORDS 128 // 7 KB per segment file
+#define TX_HISTORY_SEGMENTS 4          // 384 to 512 records kept, 28 KB at most
+#define TX_HISTORY_MAGIC 0x48585457    // "WTXH"
+#define TX_HISTORY_QUEUE_LEN 4
+#define TX_END_COMPLETED 0
+#define TX_END_INTERRUPTED 1 // Stopped from the web UI
+#define TX_END_CALIBRATION 2 // Calibration mode requested
+
+// RecordRing adds the sequence and a CRC to each record
+struct TxHistoryRecord
+{
+    uint32_t startEpoch;   // Scheduled slot (UTC)
+    int32_t startOffsetUs; // First symbol minus startEpoch
+    uint32_t frequencyHz;  // Carrier of tone 0
+    uint32_t durationMs;
+    uint32_t jitterMaxUs;  // Largest symbol edge error against its deadline
+    int32_t edgeDriftUs;   // Edge error of the last symbol sent
+    uint8_t bandIndex;
+    uint8_t dbm;
+    uint8_t endReason;     // TX_END_*
+    uint8_t timeSource;    // TIME_SOURCE_* when the TX started
+    char callsign[8];
+    char locator[8];
+};
+static_assert(sizeof(TxHistoryRecord) == 44, "TxHistoryRecord layout is stored in flash");
+QueueHandle_t txHistoryQueue = NULL;
+std::atomic<uint32_t> txHistoryNextSequence(0); // Records [oldest(next), next) may exist
+
+// 🗃️ RecordRing segments as LittleFS files <dir>/<segment>. Appends go to one open file until flush()
+// closes it, which syncs them; reads keep the last segment open for the next record.
+class FsRecordStore : public RecordStore
+{
+public:
+    FsRecordStore(const char *dir) : _dir(dir), _openSegment(UINT32_MAX), _appendSegment(UINT32_MAX) {}
+    ~FsRecordStore() { flush(); }
+
+    size_t size(uint32_t segment) override
+    {
+        char path[32];
+        if (!FILESYSTEM.exists(segmentPath(segment, path)))
+            return 0;
+        File f = FILESYSTEM.open(path, "r");
+        return f ? f.size() : 0;
+    }
+
+    bool append(uint32_t segment, const uint8_t *data, size_t len) override
+    {
+        if (segment != _appendSegment)
+        {
+            flush();
+            char path[32];
+            _appendFile = FILESYSTEM.open(segmentPath(segment, path), FILE_APPEND);
+            _appendSegment = segment;
+        }
+        return _appendFile && _appendFile.write(data, len) == len;
+    }
+
+    // Also drops the read handle, which may predate the appends
+    void flush() override
+    {
+        if (_appendFile)
+            _appendFile.close();
+        _appendSegment = UINT32_MAX;
+        close();
+    }
+
+    bool read(uint32_t segment, size_t offset, uint8_t *data, size_t len) override
+    {
+        if (segment != _openSegment)
+        {
+            close();
+            char path[32];
+            if (!FILESYSTEM.exists(segmentPath(segment, path)))
+                return false;
+            _file = FILESYSTEM.open(path, "r");
+            _openSegment = segment;
+        }
+        return _file && _file.seek(offset) && _file.read(data, len) == len;
+    }
+
+    bool remove(uint32_t segment) override
+    {
+        if (segment == _openSegment)
+            close();
+        if (segment == _appendSegment)
+            flush();
+        char path[32];
+        return !FILESYSTEM.exists(segmentPath(segment, path)) || FILESYSTEM.remove(path);
+    }
+
+    void list(void (*found)(uint32_t segment, void *context), void *context) override
+    {
+        File dir = FILESYSTEM.open(_dir);
+        if (!dir || !dir.isDirectory())
+            return;
+        for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+        {
+            const char *name = strrchr(f.name(), '/') ? strrchr(f.name(), '/') + 1 : f.name();
+            char *end;
+            uint32_t segment = strtoul(name, &end, 10);
+            if (end != name && *end == 0)
+                found(segment, context);
+        }
+    }
+
+    void close()
+    {
+        if (_file)
+            _file.close();
+        _openSegment = UINT32_MAX;
+    }
+
+private:
+    const char *_dir;
+    File _file;
+    uint32_t _openSegment;
+    File _appendFile;
+    uint32_t _appendSegment;
+
+    const char *segmentPath(uint32_t segment, char *path)
+    {
+        snprintf(path, 32, "%s/%u", _dir, segment);
+        return path;
+    }
+};
+
+RecordRing txHistoryRing(RecordStore &store)
+{
+    return RecordRing(store, TX_HISTORY_MAGIC, sizeof(TxHistoryRecord), TX_HISTORY_SEGMENT_RECORDS, TX_HISTORY_SEGMENTS);
+}
 
 // prototypes
 
-void initSI5351();
-String convertPosixToHHMMSS(time_t posixTime);
+bool initSI5351();
+char *convertPosixToHHMMSS(time_t posixTime, char *buf);
 void si5351_WarmingUp();
 void transmitWSPR();
 void startTransmission();
-String formatFrequencyWithDots(unsigned freq);
+char *formatFrequencyWithDots(unsigned long freq, char *buf, size_t size);
 void TX_ON_counter_core0(void *parameter);
 void manuallyResyncTime();
 void initialTimeSyncViaSNTP();
+bool syncTimeViaNTPClient(const char *server);
 bool syncTimeFromGPS();
+bool holdoverIsValid(const TimeHoldover &holdover);
+void holdoverSnapshot(TimeHoldover &holdover);
+bool holdoverPredict(const TimeHoldover &holdover, int64_t *epochUs, uint32_t *errorBoundUs);
+void saveHoldover();
+void recordTimeDiscipline(uint8_t source, uint32_t errorBoundUs);
+bool restoreTimeFromHoldover();
+void timeVerifyTask(void *parameter);
+void enterLowPowerIdle();
+void exitLowPowerIdle();
+void accountPowerState(byte newState);
+float averageCurrent_mA();
+void loadWebAssetManifest();
+String webAssetHash(const String &path);
+bool isWebAsset(AsyncWebServerRequest *request);
+void fillAllSettings(JsonObject settings);
+void fillSelectedBands(JsonArray bands);
+String indexTemplateProcessor(const String &var);
+void publishState();
+void publishChangedState();
+void publishTxEvent(bool on);
+void publishSymbolProgress(int symbol);
+void startTxPublisher();
+void txPublisherTask(void *parameter);
+void waitUntilMicros(uint32_t deadline);
+void sendEvent(const JsonDocument &doc, const char *event);
+void broadcastTelemetry(const void *message, size_t len);
+void broadcastSymbol(const WsSymbolMessage &message);
+bool requestCalFactor(int32_t calFactor);
+void applyRequestedCalFactor();
+void recordSymbolJitter(uint32_t jitterUs);
+void startHistoryWriter();
+void historyWriterTask(void *parameter);
+void queueTxHistory(uint8_t endReason, uint32_t durationMs, int32_t startOffsetUs, uint32_t jitterMaxUs, int32_t edgeDriftUs);
+void sendTxHistory(AsyncWebServerRequest *request);
+void startSpotFetcher();
+void spotFetchTask(void *parameter);
+void sendSpotCache(AsyncWebServerRequest *request);
+void sendSpotSummary(AsyncWebServerRequest *request);
+void sendMetrics(AsyncWebServerRequest *request);
+void onTelemetryEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+void startBootOrchestrator();
+void bootStageTask(void *parameter);
+bool bootStageFS();
+bool bootStageSettings();
+bool bootStageWiFi();
+bool bootStageTime();
+bool bootStageSi5351();
+bool bootStageWeb();
+void printBootTimings();
 String latLonToMaidenhead(float lat, float lon);
-bool connectToWiFi_DHCP_then_Static();
-byte getNextEnabledBandIndex(byte currentIndex);
-byte getFirstEnabledBandIndex();
+bool connectToWiFi();
+bool waitForWiFiConnection(unsigned long timeoutMs);
+bool loadWiFiLease();
+void saveWiFiLease();
+void startAPMode();
 // ################################################################################################
 // Prototype declarations
 // related to WSPR
@@ -140,8 +572,221 @@ const byte numWSPRbands = sizeof(WSPRbandNames) / sizeof(WSPRbandNames[0]);
 
 bool wsprBandEnabled[numWSPRbands] = {false}; // All disabled initially
 
-// ✅ Returns a randomized safe WSPR transmit frequency for a given band index
-unsigned long setRandomWSPRfrequency(byte bandIndex);
+// 🗓️ Slot schedule: the loop task turns the rules into a plan for one hour (band or idle per
+// even-minute slot, see SlotPlanner) and only looks slots up until the hour ends or the rules change.
+// The web API reads a copy taken under slotPlanMux.
+#define SLOT_LOOKAHEAD_HOURS 24 // Time windows repeat daily: an empty day stays empty
+const char *scheduleModeNames[] = {"interval", "percent", "manual"};  // By SP_MODE_*
+const char *bandHopNames[] = {"rotate", "coordinated"};               // By SP_HOP_*
+// WSJT-X band hopping: minute 00 160m, 02 80m, 04 60m, 06 40m, 08 30m, 10 20m, 12 17m, 14 15m,
+// 16 12m, 18 10m, then again from minute 20. Band indices above, -1 where we have no such band.
+const int8_t bandHopCycle[SP_HOP_CYCLE] = {-1, 0, -1, 1, 2, 3, 4, 5, 6, 7};
+static_assert(numWSPRbands <= SP_MAX_BANDS, "SlotPlanner covers at most SP_MAX_BANDS bands");
+
+struct ScheduleSettings
+{
+    uint8_t mode;                        // SP_MODE_*
+    uint8_t txPercent;                   // Percent mode: share of the slots that transmit, 1 to 100
+    uint8_t bandHop;                     // SP_HOP_*
+    uint8_t bandWindow[numWSPRbands][2]; // UTC hours [start, end), wrapping past midnight; start == end: all day
+    uint8_t manualPlan[SP_SLOTS];        // Manual mode: band per slot or SP_IDLE
+};
+ScheduleSettings txSchedule; // Loop task only, like wsprBandEnabled
+SlotPlanner slotPlan;        // Written by the loop task only
+portMUX_TYPE slotPlanMux = portMUX_INITIALIZER_UNLOCKED;
+bool txSlotPlanned = true;   // nextPosixTxTime is a planned slot, not a re-check after an empty look-ahead
+
+void defaultSchedule(ScheduleSettings &schedule);
+bool isValidSchedule(const ScheduleSettings &schedule);
+uint32_t windowHours(uint8_t start, uint8_t end);
+void fillSlotRules(SlotRules &rules);
+void invalidateSlotPlan();
+bool findNextSlot(time_t after, time_t &slotStart, byte &bandIndex);
+void scheduleNextTransmission(time_t after);
+void fillScheduleSettings(JsonObject settings, const ScheduleSettings &schedule);
+void fillApiSchedule(JsonObject doc);
+
+// 📡 Spot cache and analytics: spotFetchTask asks wspr.live once per slot for the reports of our callsign
+// newer than the last one it holds, appends them as fixed records to a circular LittleFS file and folds
+// them into per-band, per-hour aggregates. Dashboards read /api/spots from that file (ETag-revalidated)
+// instead of each querying wspr.live; /api/spots/summary serves the aggregates.
+#define SPOT_SOURCE_URL "https://db1.wspr.live/" // Or a local server replaying recorded responses
+#define SPOT_FETCH_INTERVAL_S 120  // Once per slot
+#define SPOT_OVERLAP_S 600         // Reports for a slot keep arriving for minutes: re-ask, skip known rows
+#define SPOT_MAX_ROWS 2000         // Per request, and per /api/spots response, as the web UI
+#define SPOT_READ_TIMEOUT_MS 5000
+#define SPOT_ERROR_PARSE -100      // The body stopped being JSONEachRow part way
+#define SPOT_CACHE_DIR "/spots"
+#define SPOT_CACHE_SEGMENT_RECORDS 256 // 19 KB per segment file
+#define SPOT_CACHE_SEGMENTS 6          // 1280 to 1536 reports kept, 114 KB at most
+#define SPOT_CACHE_MAGIC 0x54505357    // "WSPT"
+#define SPOT_RECENT_KEYS 1024      // Rows of the overlap window already stored
+#define SPOT_WINDOW_HOURS 24
+#define SPOT_MAX_REPORTERS 64      // Per band; the least recently heard is replaced when full
+#define SPOT_SNR_BUCKETS 8
+#define SPOT_OCCUPANCY_INTERVAL_S 900
+#define SPOT_OCCUPANCY_WINDOW_S 3600 // Other stations heard by our receivers within this
+#define SPOT_OCCUPANCY_MAX_ROWS 4000
+const int8_t spotSnrBoundsDb[SPOT_SNR_BUCKETS - 1] = {-25, -20, -15, -10, -5, 0, 5}; // Last bucket is above
+
+// RecordRing adds the sequence and a CRC to each record
+struct SpotCacheRecord
+{
+    uint32_t time; // Slot start (UTC)
+    uint32_t frequencyHz;
+    float rxLat;
+    float rxLon;
+    float txLat;
+    float txLon;
+    uint16_t distanceKm;
+    int16_t band; // wspr.live band: MHz, so 14 for 20m
+    int8_t snr;
+    char rxSign[12];
+    char rxLoc[7];
+    char txSign[8];
+    char version[8];
+};
+static_assert(sizeof(SpotCacheRecord) == 64, "SpotCacheRecord layout is stored in flash");
+
+struct SpotHour
+{
+    uint32_t hour; // epoch / 3600 of the counts below; anything older than the window is stale
+    uint16_t spots;
+    uint16_t maxDistanceKm;
+    uint16_t snr[SPOT_SNR_BUCKETS];
+};
+
+struct SpotReporter
+{
+    uint32_t hash; // FNV-1a of rx_sign, 0 for a free entry
+    uint32_t lastHour;
+};
+
+struct SpotBandStats
+{
+    SpotHour hours[SPOT_WINDOW_HOURS]; // Slot hour % SPOT_WINDOW_HOURS
+    SpotReporter reporters[SPOT_MAX_REPORTERS];
+};
+SpotBandStats spotBands[numWSPRbands];
+SemaphoreHandle_t spotLock = NULL; // Held per folded row and while /api/spots/summary copies the table
+std::atomic<uint32_t> spotCacheNext(0); // Records [oldest(next), next) may exist
+uint32_t spotRecentKeys[SPOT_RECENT_KEYS];
+uint16_t spotRecentPos = 0;
+uint32_t spotLastSeen = 0; // Newest report in the cache for the current callsign
+uint32_t spotLastFetch = 0;
+uint32_t spotRowsAdded = 0;
+int spotLastStatus = 0; // HTTP status of the last request, negative for a client error
+
+// 🎯 Band occupancy seen by the receivers that hear us, refreshed by spotFetchTask and read by the
+// warm-up to pick the TX frequency. A band is copied whole under plannerMux.
+FrequencyPlanner bandPlanners[numWSPRbands];
+portMUX_TYPE plannerMux = portMUX_INITIALIZER_UNLOCKED;
+uint8_t lastTxOffsetHz[numWSPRbands] = {0}; // Offset + 1 of the last TX per band, 0 for none
+
+RecordRing spotCacheRing(RecordStore &store);
+void loadSpotCache(RecordRing &ring, const char *callsign);
+int readSpotClient(void *context, uint8_t *buf, size_t size);
+int fetchSpots(RecordRing &ring, const char *callsign, uint32_t since, uint32_t &rows, uint32_t &added, uint32_t &lastEpoch);
+int fetchOccupancy(const char *callsign);
+void foldSpot(const SpotCacheRecord &record);
+
+// 🧩 Settings model behind /api/state. A PATCH is validated as a whole and published as a new
+// version, the loop applies it to the TX engine between transmissions and a background task
+// persists it once the edits have settled.
+#define SETTINGS_WRITE_DEBOUNCE_MS 2000
+#define SETTINGS_WRITE_CHANGED BIT0     // Writer notification: persist once the edits settle
+#define SETTINGS_WRITE_FLUSH BIT1       // Persist now and stop: a reboot follows
+#define SETTINGS_WRITE_DISCARD BIT2     // Drop pending edits and stop: NVS is about to be erased
+#define SETTINGS_WRITER_STOP_TIMEOUT_MS 3000
+
+struct Settings
+{
+    char callsign[sizeof(call)];
+    char locator[sizeof(loc)];
+    uint32_t power_mW;
+    uint8_t intervalMinutes; // 2, 4, 6, 8 or 10
+    bool bandEnabled[numWSPRbands];
+    int32_t calFactor;
+    bool lowPowerIdle;
+    ScheduleSettings schedule; // Since v2
+};
+
+// 🔁 Published settings, RCU-style: a writer fills a slot no reader holds and swaps the current
+// index; a reader pins the current slot with a counter and never waits. Writers serialize on
+// settingsWriteLock. The TX engine copies one version per transmission into txSettings.
+#define SETTINGS_VERSIONS 3
+
+struct SettingsVersion
+{
+    Settings settings;
+    uint32_t generation;
+    std::atomic<uint8_t> readers;
+};
+SettingsVersion settingsVersions[SETTINGS_VERSIONS];
+std::atomic<uint8_t> currentSettingsVersion(0);
+std::atomic<uint32_t> publishedSettingsGeneration(0);
+SemaphoreHandle_t settingsWriteLock = NULL;
+
+// Pins the current version for as long as it lives
+class SettingsRef
+{
+public:
+    SettingsRef();
+    ~SettingsRef() { version->readers--; }
+    const Settings *operator->() const { return &version->settings; }
+    const Settings &operator*() const { return version->settings; }
+    uint32_t generation() const { return version->generation; }
+
+private:
+    SettingsRef(const SettingsRef &) = delete;
+    SettingsRef &operator=(const SettingsRef &) = delete;
+    SettingsVersion *version;
+};
+
+Settings txSettings;                           // Loop task only: the version the TX engine runs with
+std::atomic<uint32_t> txSettingsGeneration(0); // Generation of txSettings
+Settings persistedSettings;                    // What the settings blob holds
+TaskHandle_t settingsWriterTaskHandle = NULL;
+SemaphoreHandle_t settingsWriterStopped = NULL; // Given once the writer has flushed or discarded for good
+
+// 💾 Persistent form of Settings: one versioned record with a CRC, read back with a single
+// nvs_get_blob. `length` is the payload size the writer used, so older layouts can be migrated.
+#define SETTINGS_NAMESPACE "settings"
+#define SETTINGS_BLOB_KEY "blob"
+#define SETTINGS_BLOB_MAGIC 0x53525057 // "WPRS"
+#define SETTINGS_BLOB_VERSION 2
+#define SETTINGS_BLOB_MAX_SIZE 256     // Largest record any version may write
+
+struct SettingsBlob
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;   // sizeof(payload) at the time of writing
+    Settings settings; // Payload
+    uint32_t crc;      // esp_rom_crc32_le over header and payload
+};
+
+void defaultSettings(Settings &settings);
+bool loadSettingsBlob(Settings &settings);
+bool storeSettingsBlob(const Settings &settings);
+bool migrateSettings(uint16_t version, const uint8_t *payload, uint16_t length, Settings &settings);
+bool importLegacySettings(Settings &settings);
+bool sameSettings(const Settings &a, const Settings &b);
+Settings settingsSnapshot();
+void captureSettings(Settings &settings);
+void initSettingsVersions(const Settings &initial);
+void publishSettings(const Settings &next);
+bool patchSettings(JsonObjectConst patch, String &error);
+bool patchSettingsLocked(JsonObjectConst patch, String &error);
+void applyPendingSettings();
+void persistSettings(const Settings &settings);
+void settingsWriterTask(void *parameter);
+void stopSettingsWriter(uint32_t request);
+void fillApiState(JsonObject state);
+void sendLegacyPatch(AsyncWebServerRequest *request, JsonDocument &patch, const char *okMessage);
+
+// ✅ Returns a safe WSPR transmit frequency for a given band index, away from other signals
+unsigned long chooseWSPRfrequency(byte bandIndex);
 void displaySelectedBandInformation(byte bandIndex);
 
 void initializeNextTransmissionTime();
@@ -149,47 +794,50 @@ void retrieveUserSettings();
 
 void configure_web_server();
 void setFrequencyInMhz(float freqMHz);
+
+// Dependencies: settings/FS/Wi-Fi need nothing, the RF module needs the calibration
+// factor, time needs the stored locator (GPS may update it) and Wi-Fi for its SNTP fallback.
+BootStage bootStages[] = {
+    {"LittleFS", BOOT_FS, 0, bootStageFS, 0, 0, false},
+    {"Settings", BOOT_SETTINGS, 0, bootStageSettings, 0, 0, false},
+    {"Wi-Fi", BOOT_WIFI, 0, bootStageWiFi, 0, 0, false},
+    {"Time", BOOT_TIME, BOOT_SETTINGS, bootStageTime, 0, 0, false},
+    {"Si5351", BOOT_SI5351, BOOT_SETTINGS, bootStageSi5351, 0, 0, false},
+    {"Web server", BOOT_WEB, BOOT_FS | BOOT_WIFI | BOOT_SETTINGS, bootStageWeb, 0, 0, false},
+};
+const byte numBootStages = sizeof(bootStages) / sizeof(bootStages[0]);
 //----------------------------------------------------------------------------------------
 
 //---------------------------------------------------------------------------------------------
 void setup()
 {
     Serial.begin(115200);
-    delay(5000);
-
-    // Initialize LittleFS
-    if (!FILESYSTEM.begin(true))
-    {
-        Serial.println("An error occurred while mounting LittleFS");
-        return;
-    }
-    Serial.println("LittleFS mounted successfully");
-    // Connect to Wi-Fi
-    connectToWiFi_DHCP_then_Static();
-
-    // Retrieve user settings
-    retrieveUserSettings();
-    if (!syncTimeFromGPS())
-    {
-        initialTimeSyncViaSNTP(); // your existing SNTP fallback
-    }
+    loopTaskHandle = xTaskGetCurrentTaskHandle(); // setup() and loop() share the Arduino loop task
+    DLog.addSink(&serialLogSink);
+    if (strlen(SYSLOG_HOST))
+        DLog.addSink(&syslogSink);
+    DLog.begin(logEventFormats, LOG_EVENT_COUNT, 1, 0);
 
-    // init RF module
-    initSI5351();
-    // Start server
+    // ♻️ Warm boot: restore time from RTC holdover and skip the slow boot chain
+    warmBoot = restoreTimeFromHoldover();
 
-    configure_web_server();
+    // 🚀 Run the boot stages concurrently and only wait for what the scheduler needs
+    startBootOrchestrator();
+    xEventGroupWaitBits(bootEvents, BOOT_READY_TO_TX, pdFALSE, pdTRUE, portMAX_DELAY);
+    bootReadyToTxMs = millis();
 
-    selectedBandIndex = getFirstEnabledBandIndex();
-    Serial.printf("🎯 Starting on first enabled band: %s (%d)\n", WSPRbandNames[selectedBandIndex], selectedBandIndex);
+    Serial.printf("🚀 Ready to transmit %lu ms after power-on\n", bootReadyToTxMs);
 }
 //---------------------------------------------------------------------------------------------
 
 
 void loop()
 {
+    applyPendingSettings(); // Safe point: no transmission in progress
+
     if (calibrationStarted)
     {
+        applyRequestedCalFactor();
         delay(5);
         yield();
         ;
@@ -200,6 +848,7 @@ void loop()
     if (isFirstIteration)
     {
         Serial.println("\n🔁 First Loop Iteration: Determining next TX start time...");
+        si5351.set_clock_pwr(SI5351_CLK0, 0); // Calibration carrier or a cancelled warm-up
         initializeNextTransmissionTime();
         isFirstIteration = false;
         interruptWSPRcurrentTX = false;
@@ -209,21 +858,23 @@ void loop()
     TX_referenceFrequ = WSPRbandStart[selectedBandIndex];
     // Get current time once per loop
     currentEpochTime = time(nullptr);
-    Serial.print("\n🕒 Current time: ");
-    Serial.println(convertPosixToHHMMSS(currentEpochTime));
-    Serial.print("🕑 Next TX Time: ");
-    Serial.println(convertPosixToHHMMSS(nextPosixTxTime));
+    DLOG_I(LOG_CURRENT_TIME, LOG_HMS(currentEpochTime));
+    DLOG_I(LOG_NEXT_TX_TIME, LOG_HMS(nextPosixTxTime));
 
     // Countdown loop until it's time to transmit or interrupted
     unsigned long lastUpdate = 0;
     while (true)
     {
+        if (!warmingup)
+            applyPendingSettings();
+
         currentEpochTime = time(nullptr);
         currentRemainingSeconds = nextPosixTxTime - currentEpochTime;
 
         if (interruptWSPRcurrentTX || performCalibration)
         {
-            Serial.println("⚠️ Ongoing waiting for next transmission interrupted");
+            exitLowPowerIdle();
+            DLOG_W(LOG_WAIT_INTERRUPTED);
             return;
         }
 
@@ -234,37 +885,54 @@ void loop()
         // Update serial output every 1 second (not every loop)
         if (millis() - lastUpdate >= 1000)
         {
-            Serial.printf("\r⏳ TX starts in %ld s   ", currentRemainingSeconds);
+            DLOG_I(LOG_COUNTDOWN, currentRemainingSeconds);
+            publishState();
+            telemetry.cleanupClients();
             lastUpdate = millis();
         }
+
+        // 💤 Sleep in 1 s chunks until the wake lead time, so interruptions stay responsive
+        if (lowPowerIdle && currentRemainingSeconds > LOW_POWER_WAKE_LEAD_S)
+        {
+            enterLowPowerIdle();
+            delay(min<unsigned long>((currentRemainingSeconds - LOW_POWER_WAKE_LEAD_S) * 1000UL, 1000UL));
+            continue;
+        }
+        exitLowPowerIdle();
         // Start warming up if close to TX time
-        if (currentRemainingSeconds <= 5 && !warmingup)
+        if (currentRemainingSeconds <= 5 && !warmingup && txSlotPlanned)
         {
             si5351_WarmingUp();
         }
         delay(5); // Small sleep to avoid tight spin
         yield();  // Allow Wi-Fi + web tasks to run
     }
+    exitLowPowerIdle(); // In case the clock stepped past the wake lead time
 
     // Break the loop if required
     if (interruptWSPRcurrentTX || performCalibration)
     {
-        Serial.println("⚠️ Next transmission cancelled");
+        DLOG_W(LOG_TX_CANCELLED);
         return;
     }
 
-    // Begin transmission
-    startTransmission();
+    // Begin transmission; after an empty look-ahead this was only the time to look again
+    if (txSlotPlanned)
+        startTransmission();
 
-    nextPosixTxTime += intervalBetweenTx;
-    // 🔁 Switch to next enabled band for next TX
-    selectedBandIndex = getNextEnabledBandIndex(selectedBandIndex);
+    // 🗓️ Next planned slot and its band
+    scheduleNextTransmission(nextPosixTxTime);
+    TX_referenceFrequ = WSPRbandStart[selectedBandIndex];
+    publishState(); // Band change
 
     if (performCalibration && !calibrationStarted)
     {
         calibrationStarted = true;
+        saveHoldover();
         setFrequencyInMhz(calFrequencyInMhz);
-        Serial.printf("📡 Frequency set to %s Hz and clock powered ON.\n", formatFrequencyWithDots(calFrequencyInMhz * 1e6).c_str());
+        char freqText[16];
+        Serial.printf("📡 Frequency set to %s Hz and clock powered ON.\n",
+                      formatFrequencyWithDots(calFrequencyInMhz * 1e6, freqText, sizeof(freqText)));
     }
 
     // 🔁 Try to resync time from GPS if not yet synced
@@ -296,7 +964,7 @@ void loop()
         }
     }
 
-    if (WiFi.status() != WL_CONNECTED)
+    if (!apModeActive && WiFi.status() != WL_CONNECTED)
     {
         Serial.println("Wi-Fi disconnected. Attempting to reconnect...");
         WiFi.reconnect();
@@ -306,293 +974,1605 @@ void loop()
 }
 //---------------------------------------------------------------------------------------------
 
-void initSI5351()
+void loadWebAssetManifest()
 {
-    const uint8_t SI5351_ADDRESS = 0x60;
-    Serial.println("");
-    Serial.println("📡 Initializing Si5351...");
-
-    // 🔌 Start I²C bus at 400 kHz (fast mode) — reliable and quick on ESP32
-    Wire.begin(SI5351_SDA, SI5351_SCL);
-    Wire.setClock(400000);
-
-    // 🔍 Probe Si5351 I²C address to check if device is present
-    Wire.beginTransmission(SI5351_ADDRESS);
-
-    if (Wire.endTransmission() != 0)
+    File manifest = FILESYSTEM.open("/assets.manifest", "r");
+    if (!manifest)
     {
-        Serial.println("❌ Si5351 not found at 0x60. Check wiring or power.");
-        while (true)
-            ;
+        Serial.println("⚠️ No web asset manifest: only the dashboard routes are served.");
+        return;
     }
 
-    // ✅ Found and ready to initialize
-    Serial.println("✅ Success! Si5351 module found!! 🎉");
-
-    // ⚙️ Initialize Si5351 with 8pF crystal load (typical for cheap boards)
-    si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0); // 0, 0 = use default XTAL + correction
-
-    // 🔧 Apply frequency calibration correction (in parts per billion)
-    Serial.print("🔧 Applying Calibration Factor: ");
-    Serial.println(cal_factor);
-    si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
-
-    // 📶 Set frequency for selected TX clock output (CLK0, CLK1, or CLK2)
-    Serial.print("📶 Setting TX Reference Frequency: ");
-    Serial.print(TX_referenceFrequ);
-    Serial.println(" Hz");
-    si5351.set_freq(TX_referenceFrequ, SI5351_CLK0);
-
-    // 💪 Set drive strength for the selected clock output (strongest = 8 mA)
-    Serial.print("💪 Setting RF output strength to max ");
-
-    si5351.drive_strength(SI5351_CLK0, SI5351_DRIVE_8MA);
-
-    // 📴 Disable all unused outputs among CLK0, CLK1, and CLK2
-    Serial.println("🔌 Disabling unused clock outputs: ");
-    bool first = true;
-    si5351_clock clocks[] = {SI5351_CLK0, SI5351_CLK1, SI5351_CLK2};
-
-    for (si5351_clock clk : clocks)
+    numWebAssetHashes = 0;
+    char line[64];
+    while (manifest.available() && numWebAssetHashes < MAX_WEB_ASSETS)
     {
-        si5351.set_clock_pwr(clk, 0); // Disable unused clock output
-        // Serial.print("Disabling CLK");
-        // Serial.println((int)clk); // newline for better readability
+        size_t len = manifest.readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = '\0';
+        char *space = strchr(line, ' ');
+        if (!space || space - line >= (int)sizeof(webAssetHashes[0].path))
+            continue;
+
+        *space = '\0';
+        WebAssetHash &asset = webAssetHashes[numWebAssetHashes++];
+        strncpy(asset.path, line, sizeof(asset.path) - 1);
+        asset.path[sizeof(asset.path) - 1] = '\0';
+        strncpy(asset.hash, space + 1, sizeof(asset.hash) - 1);
+        asset.hash[sizeof(asset.hash) - 1] = '\0';
     }
-    Serial.println();
-    // switch OFF
-    si5351.set_clock_pwr(SI5351_CLK0, 0);
-    Serial.println("");
+    manifest.close();
+    Serial.printf("🗂️ Web asset manifest: %d entries\n", numWebAssetHashes);
 }
-void initializeNextTransmissionTime()
-{
-
-    // 🕒 Get Current Epoch Time
-
-    currentEpochTime = time(nullptr);
-    int currentHour = (currentEpochTime % 86400L) / 3600;
-    int currentMinute = (currentEpochTime % 3600) / 60;
-    int currentSecond = currentEpochTime % 60;
-
-    // 🗓️ Determine Next Even Minute
-    int nextEvenMinute = (currentMinute % 2 == 0) ? currentMinute + 2 : currentMinute + 1;
-    int nextHour = currentHour;
-
-    // ⏭️ Handle Hour Rollover
-    if (nextEvenMinute >= 60)
-    {
-        nextEvenMinute = 0;
-        nextHour = (currentHour + 1) % 24;
-    }
 
-    // 📅 Calculate Next Transmission Time
-    if (nextHour != currentHour)
-    {
-        nextPosixTxTime = currentEpochTime + ((60 - currentMinute) * 60 - currentSecond) + (nextEvenMinute * 60);
-    }
-    else
+String webAssetHash(const String &path)
+{
+    for (byte i = 0; i < numWebAssetHashes; i++)
     {
-        nextPosixTxTime = currentEpochTime + (nextEvenMinute - currentMinute) * 60 - currentSecond;
+        if (path == webAssetHashes[i].path)
+            return String(webAssetHashes[i].hash);
     }
-
-    // ✅ Log the Result
-    //Serial.print("📅 Next Transmission Time (POSIX): ");
-    //Serial.println(nextPosixTxTime);
-    Serial.print("🕑 Next TX Time:  ");
-    Serial.println(convertPosixToHHMMSS(nextPosixTxTime));
+    return String();
 }
 
-String convertPosixToHHMMSS(time_t posixTime)
+// 🔒 Static handlers serve only what the manifest lists: keys, editor files and runtime data stay private
+bool isWebAsset(AsyncWebServerRequest *request)
 {
-    // Convert epoch time to struct tm
-    struct tm *timeInfo;
-    timeInfo = gmtime(&posixTime); // Use localtime() for local time or gmtime() for UTC time
-
-    // Format the time
-    char formattedTime[9]; // HH:MM:SS + null terminator
-    sprintf(formattedTime, "%02d:%02d:%02d", timeInfo->tm_hour, timeInfo->tm_min, timeInfo->tm_sec);
-
-    // Return formatted time as String
-    return String(formattedTime);
+    String path = request->url();
+    if (path.endsWith("/"))
+        path += "index.html";
+    return webAssetHash(path).length() > 0;
 }
 
-void si5351_WarmingUp()
+void fillAllSettings(JsonObject settings)
 {
-    warmingup = true;
-    Serial.println();
-    Serial.println("🔥 Radio Module 'Warming Up' Phase Started to stabilize ...(5s before begin)");
-
-    // 🎛️ Apply small random frequency offset (-100 to +100 Hz)
-
-    WSPR_TX_operatingFrequ = setRandomWSPRfrequency(selectedBandIndex) * 100ULL; /// Hz * 100 for module
-
-    // 📡 Log the new TX frequency with formatting
-    Serial.print("📶 Setting TX Frequency to: ");
-    Serial.print(formatFrequencyWithDots(WSPR_TX_operatingFrequ / 100ULL));
-    Serial.print(" (ref. ");
-    Serial.print(formatFrequencyWithDots(TX_referenceFrequ));
-    Serial.println(")");
-    // ⚙️ Configure Si5351 for transmission
-    si5351.set_freq(WSPR_TX_operatingFrequ, SI5351_CLK0);
-    si5351.set_clock_pwr(SI5351_CLK0, 1); // Power ON
+    SettingsRef current; // Web tasks read the published version, never the TX engine's globals
+    settings["version"] = "Ver. " + String(VERSION);
+    settings["callsign"] = current->callsign;
+    settings["locator"] = current->locator;
+    settings["power"] = current->power_mW;
+    settings["TX_referenceFrequ"] = TX_referenceFrequ;
+    settings["WSPR_TX_operatingFrequ"] = WSPR_TX_operatingFrequ;
+    if (current->schedule.mode == SP_MODE_PERCENT)
+        settings["scheduleState"] = "schedule6";
+    else if (current->schedule.mode == SP_MODE_INTERVAL)
+        settings["scheduleState"] = "schedule" + String(current->intervalMinutes / 2);
+    settings["txPercent"] = current->schedule.txPercent;
+    settings["lowPowerIdle"] = current->lowPowerIdle;
 }
 
-void startTransmission()
+void fillSelectedBands(JsonArray bands)
 {
-    tx_is_ON = true;
-
-    xTaskCreatePinnedToCore(
-        TX_ON_counter_core0,  // Task function
-        "TXCounterTask",      // Name of the task
-        2048,                 // Stack size in words
-        NULL,                 // Task input parameter
-        1,                    // Priority of the task
-        &txCounterTaskHandle, // Task handle
-        0                     // Core to pin the task to (0 in this case)
-    );
-
-    transmitWSPR();
-    warmingup = false;
-    tx_is_ON = false;
-    tx_ON_running_time_in_s = 0;
-
-    // Wait for the task to complete and clean up
-    vTaskDelete(txCounterTaskHandle);
-    txCounterTaskHandle = NULL;
+    SettingsRef current;
+    for (int i = 0; i < numWSPRbands; i++)
+    {
+        if (current->bandEnabled[i])
+            bands.add(i);
+    }
 }
 
-// ✅ Returns a randomized safe WSPR transmit frequency for a given band index
-unsigned long setRandomWSPRfrequency(byte bandIndex)
+// 🖼️ ~INITIAL_STATE~ in index.html: everything the dashboard used to fetch before its first paint
+String indexTemplateProcessor(const String &var)
 {
-    Serial.println("🎯 Selecting random freq within available range");
-
-    unsigned long officialStart = WSPRbandStart[bandIndex];
-    unsigned long officialEnd = WSPRbandEnd[bandIndex];
+    if (var != "INITIAL_STATE")
+        return String();
 
-    // Make sure there's space for the 6 Hz bandwidth of WSPR signal
-    unsigned long minF = officialStart + 15; // Should be 3, but add 15 as "safety" margin
-    unsigned long maxF = officialEnd - 15;   // Should be 3, but deduct 15 as "safety" margin
+    DynamicJsonDocument doc(1024);
+    doc["modeOfOperation"] = modeOfOperation;
+    fillAllSettings(doc.createNestedObject("settings"));
+    fillSelectedBands(doc.createNestedArray("selectedBands"));
 
-    unsigned long freq = random(minF, maxF + 1); // inclusive range
+    File key = FILESYSTEM.open("/cesium.key", "r");
+    if (key)
+    {
+        doc["cesiumKey"] = key.readString();
+        key.close();
+    }
 
-    return freq;
+    String json;
+    serializeJson(doc, json);
+    json.replace("</", "<\\/"); // Keep user strings from closing the <script> block
+    return json;
 }
 
-String formatFrequencyWithDots(unsigned freq)
+void captureSettings(Settings &settings)
 {
-    String s = String(freq);
-    int len = s.length();
+    strlcpy(settings.callsign, call, sizeof(settings.callsign));
+    strlcpy(settings.locator, loc, sizeof(settings.locator));
+    settings.power_mW = power_mW;
+    settings.intervalMinutes = intervalBetweenTx / 60;
+    memcpy(settings.bandEnabled, wsprBandEnabled, sizeof(settings.bandEnabled));
+    settings.calFactor = cal_factor;
+    settings.lowPowerIdle = lowPowerIdle;
+    settings.schedule = txSchedule;
+}
 
-    // Insert dots every 3 digits from the right
-    for (int i = len - 3; i > 0; i -= 3)
+bool isValidCallsign(const char *callsign)
+{
+    size_t len = strlen(callsign);
+    if (len == 0 || len >= sizeof(call))
+        return false;
+    for (size_t i = 0; i < len; i++)
     {
-        s = s.substring(0, i) + "." + s.substring(i);
+        if (!isalnum((unsigned char)callsign[i]) && callsign[i] != '/')
+            return false;
     }
-
-    return s;
+    return true;
 }
 
-void TX_ON_counter_core0(void *parameter)
+bool isValidLocator(const char *locator)
 {
-    tx_ON_running_time_in_s = 0;
-
-    while (tx_is_ON == true)
+    size_t len = strlen(locator);
+    if (len != 4 && len != 6)
+        return false;
+    for (size_t i = 0; i < len; i++)
     {
-        tx_ON_running_time_in_s = tx_ON_running_time_in_s + 1;
-        // The transmission occupies exactly 110.592 seconds ( rounded to 110).
-
-        // Serial.printf("TX ON counter: %d seconds\n", tx_ON_running_time_in_s);
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        char c = toupper((unsigned char)locator[i]);
+        bool ok = (i < 2) ? (c >= 'A' && c <= 'R') : (i < 4) ? isdigit((unsigned char)c) : (c >= 'A' && c <= 'X');
+        if (!ok)
+            return false;
     }
-
-    // Delete the task if tx_is_ON is false to free resources
-    vTaskDelete(NULL);
-    txCounterTaskHandle = NULL;
+    return true;
 }
 
-void displaySelectedBandInformation(byte bandIndex)
+// Validates every field first and only then publishes: a batch is applied whole or not at all.
+// The write lock spans read-modify-publish, so concurrent patches cannot lose each other's fields.
+bool patchSettings(JsonObjectConst patch, String &error)
 {
-    unsigned long officialStart = WSPRbandStart[bandIndex];
-    unsigned long officialEnd = WSPRbandEnd[bandIndex];
-    unsigned long minF = officialStart + 3;
-    unsigned long maxF = officialEnd - 3;
-
-    Serial.println();
-    Serial.println(F("📶 --- WSPR Transmission Setup --------------------------------------"));
-
-    Serial.printf("🔹 %-20s %s\n", "Band:", WSPRbandNames[bandIndex]);
-    Serial.printf("🔹 %-20s %lu – %lu Hz\n", "Sub-band:", officialStart, officialEnd);
-    Serial.printf("🔹 %-20s %lu – %lu Hz (excludes ±3 Hz edges)\n", "Usable range:", minF, maxF);
-    Serial.printf("🔹 %-20s ~6 Hz centered around selected frequency\n", "Bandwidth used:");
-    Serial.printf("🧾 %-20s %s\n", "Callsign:", call);
-    Serial.printf("🌍 %-20s %s\n", "Locator:", loc);
-    Serial.printf("⚡ %-20s %d mW → %d dBm\n", "Power:", power_mW, dbm);
-    Serial.printf("📅 %-20s %d minutes\n", "Scheduled Interval:", intervalBetweenTx / 60);
-
-    Serial.println(F("---------------------------------------------------------------------"));
+    if (!settingsWriteLock)
+    {
+        error = "settings not loaded yet";
+        return false;
+    }
+    xSemaphoreTake(settingsWriteLock, portMAX_DELAY);
+    bool ok = patchSettingsLocked(patch, error);
+    xSemaphoreGive(settingsWriteLock);
+    return ok;
 }
 
-void transmitWSPR()
+bool patchSettingsLocked(JsonObjectConst patch, String &error)
 {
-    uint8_t i;
-
-    // 🎙️ Encode WSPR message
-    Serial.println("\n📝 Preparing WSPR message for encoding...");
-    Serial.print("📡 Callsign: ");
-    Serial.println(call);
-
-    Serial.print("🌍 Locator: ");
-    Serial.println(loc);
-
-    Serial.print("⚡ Power: ");
-    Serial.print(dbm);
-    Serial.println(" dBm");
-
-    jtencode.wspr_encode(call, loc, dbm, tx_buffer);
-
-    // 🚀 Transmission Start
-    Serial.println("\n--- TX ON: Transmission Started ---");
-    // Record start time (both POSIX and millis)
-    unsigned long txStartEpoch = time(nullptr);
-    unsigned long txStartMillis = millis();
-    // Get current time once per loop
-    currentEpochTime = time(nullptr);
-    Serial.print("🕒 Current time: ");
-    Serial.println(convertPosixToHHMMSS(currentEpochTime));
-    // 🔊 Transmit each WSPR symbol
+    Settings next = settingsSnapshot();
 
-    for (int i = 0; i < SYMBOL_COUNT; i++)
+    bool changed = false;
+    for (JsonPairConst field : patch)
     {
-        uint64_t toneFreq = WSPR_TX_operatingFrequ + (tx_buffer[i] * TONE_SPACING);
-        si5351.set_freq(toneFreq, SI5351_CLK0);
-
-    int correction = 1;
-      if (TEST){
-    // Calculate percentage
-        float progress = ((float)(i + 1) / SYMBOL_COUNT) * 100.0;
-                // Print on the same line with percentage
-                Serial.printf("\r📡 Transmitting symbol %d of %d (%.0f%%)   ",
-                              i + 1, SYMBOL_COUNT, progress);
-                Serial.flush();
-
-                if (interruptWSPRcurrentTX || performCalibration)
-                {
-                    Serial.println("\n⚠️ Ongoing transmission interrupted");
-                    return; // goes back to main loop
-                }
-correction=6;
-                yield();
-               }
-        delay(WSPR_DELAY - correction); // 5from experiments
-    }
-    Serial.println(); // Move to a new line after completion
+        const char *key = field.key().c_str();
+        JsonVariantConst value = field.value();
 
-    // Record end time
+        if (!strcmp(key, "callsign"))
+        {
+            const char *callsign = value.as<const char *>();
+            if (!callsign || !isValidCallsign(callsign))
+            {
+                error = "callsign: 1 to 7 letters, digits or '/'";
+                return false;
+            }
+            strlcpy(next.callsign, callsign, sizeof(next.callsign));
+            for (char *c = next.callsign; *c; c++)
+                *c = toupper((unsigned char)*c);
+            changed = true;
+        }
+        else if (!strcmp(key, "locator"))
+        {
+            const char *locator = value.as<const char *>();
+            if (!locator || !isValidLocator(locator))
+            {
+                error = "locator: 4 or 6 character Maidenhead locator";
+                return false;
+            }
+            strlcpy(next.locator, locator, sizeof(next.locator));
+            changed = true;
+        }
+        else if (!strcmp(key, "power"))
+        {
+            if (!value.is<uint32_t>() || value.as<uint32_t>() < 1 || value.as<uint32_t>() > 1000000)
+            {
+                error = "power: 1 to 1000000 mW";
+                return false;
+            }
+            next.power_mW = value.as<uint32_t>();
+            changed = true;
+        }
+        else if (!strcmp(key, "intervalMinutes"))
+        {
+            int minutes = value.is<int>() ? value.as<int>() : 0;
+            if (minutes < 2 || minutes > 10 || minutes % 2)
+            {
+                error = "intervalMinutes: 2, 4, 6, 8 or 10";
+                return false;
+            }
+            next.intervalMinutes = minutes;
+            changed = true;
+        }
+        else if (!strcmp(key, "bands"))
+        {
+            JsonArrayConst bands = value.as<JsonArrayConst>();
+            if (bands.isNull() || bands.size() == 0)
+            {
+                error = "bands: non-empty array of band indices";
+                return false;
+            }
+            memset(next.bandEnabled, 0, sizeof(next.bandEnabled));
+            for (JsonVariantConst band : bands)
+            {
+                int index = band.is<int>() ? band.as<int>() : -1;
+                if (index < 0 || index >= numWSPRbands)
+                {
+                    error = "bands: index out of range";
+                    return false;
+                }
+                next.bandEnabled[index] = true;
+            }
+            changed = true;
+        }
+        else if (!strcmp(key, "calFactor"))
+        {
+            if (!value.is<int32_t>())
+            {
+                error = "calFactor: integer";
+                return false;
+            }
+            next.calFactor = value.as<int32_t>();
+            changed = true;
+        }
+        else if (!strcmp(key, "lowPowerIdle"))
+        {
+            if (!value.is<bool>())
+            {
+                error = "lowPowerIdle: boolean";
+                return false;
+            }
+            next.lowPowerIdle = value.as<bool>();
+            changed = true;
+        }
+        else if (!strcmp(key, "scheduleMode"))
+        {
+            const char *mode = value.as<const char *>();
+            int index = -1;
+            for (int i = 0; mode && i < (int)(sizeof(scheduleModeNames) / sizeof(scheduleModeNames[0])); i++)
+            {
+                if (!strcmp(mode, scheduleModeNames[i]))
+                    index = i;
+            }
+            if (index < 0)
+            {
+                error = "scheduleMode: \"interval\", \"percent\" or \"manual\"";
+                return false;
+            }
+            next.schedule.mode = index;
+            changed = true;
+        }
+        else if (!strcmp(key, "txPercent"))
+        {
+            int percent = value.is<int>() ? value.as<int>() : 0;
+            if (percent < 1 || percent > 100)
+            {
+                error = "txPercent: 1 to 100";
+                return false;
+            }
+            next.schedule.txPercent = percent;
+            changed = true;
+        }
+        else if (!strcmp(key, "bandHop"))
+        {
+            const char *hop = value.as<const char *>();
+            int index = -1;
+            for (int i = 0; hop && i < (int)(sizeof(bandHopNames) / sizeof(bandHopNames[0])); i++)
+            {
+                if (!strcmp(hop, bandHopNames[i]))
+                    index = i;
+            }
+            if (index < 0)
+            {
+                error = "bandHop: \"rotate\" or \"coordinated\"";
+                return false;
+            }
+            next.schedule.bandHop = index;
+            changed = true;
+        }
+        else if (!strcmp(key, "bandWindows"))
+        {
+            JsonArrayConst windows = value.as<JsonArrayConst>();
+            if (windows.isNull() || windows.size() != numWSPRbands)
+            {
+                error = "bandWindows: one [startHour, endHour] per band";
+                return false;
+            }
+            int i = 0;
+            for (JsonVariantConst window : windows)
+            {
+                int start = window[0].is<int>() ? window[0].as<int>() : -1;
+                int end = window[1].is<int>() ? window[1].as<int>() : -1;
+                if (window.size() != 2 || start < 0 || start > 23 || end < 0 || end > 24)
+                {
+                    error = "bandWindows: UTC hours, start 0 to 23, end 0 to 24";
+                    return false;
+                }
+                next.schedule.bandWindow[i][0] = start;
+                next.schedule.bandWindow[i][1] = end;
+                i++;
+            }
+            changed = true;
+        }
+        else if (!strcmp(key, "manualPlan"))
+        {
+            JsonArrayConst slots = value.as<JsonArrayConst>();
+            if (slots.isNull() || slots.size() != SP_SLOTS)
+            {
+                error = "manualPlan: 30 entries, band index or null";
+                return false;
+            }
+            int i = 0;
+            for (JsonVariantConst slot : slots)
+            {
+                int band = slot.isNull() ? SP_IDLE : slot.is<int>() ? slot.as<int>() : -1;
+                if (band != SP_IDLE && (band < 0 || band >= numWSPRbands))
+                {
+                    error = "manualPlan: band index out of range";
+                    return false;
+                }
+                next.schedule.manualPlan[i++] = band;
+            }
+            changed = true;
+        }
+        else
+        {
+            error = String(key) + ": unknown or read-only field";
+            return false;
+        }
+    }
+
+    if (!changed)
+        return true;
+    publishSettings(next);
+    if (settingsWriterTaskHandle)
+        xTaskNotify(settingsWriterTaskHandle, SETTINGS_WRITE_CHANGED, eSetBits);
+    return true;
+}
+
+SettingsRef::SettingsRef()
+{
+    while (true)
+    {
+        uint8_t index = currentSettingsVersion.load();
+        version = &settingsVersions[index];
+        version->readers++;
+        if (currentSettingsVersion.load() == index)
+            return;
+        version->readers--; // Swapped meanwhile, so a writer may refill this slot: pin the new one
+    }
+}
+
+// Boot only, before any reader or writer exists
+void initSettingsVersions(const Settings &initial)
+{
+    settingsVersions[0].settings = initial;
+    settingsVersions[0].generation = 1;
+    currentSettingsVersion = 0;
+    publishedSettingsGeneration = 1;
+    txSettings = initial;
+    txSettingsGeneration = 1;
+    persistedSettings = initial;
+    settingsWriteLock = xSemaphoreCreateMutex();
+}
+
+// Writers only, with settingsWriteLock held
+void publishSettings(const Settings &next)
+{
+    uint8_t current = currentSettingsVersion.load();
+    uint8_t slot = current;
+    while (slot == current)
+    {
+        for (uint8_t i = 1; i < SETTINGS_VERSIONS; i++)
+        {
+            uint8_t candidate = (current + i) % SETTINGS_VERSIONS;
+            if (settingsVersions[candidate].readers.load() == 0)
+            {
+                slot = candidate;
+                break;
+            }
+        }
+        if (slot == current)
+            vTaskDelay(1); // Every spare slot is still pinned by a reader
+    }
+
+    settingsVersions[slot].settings = next;
+    settingsVersions[slot].generation = settingsVersions[current].generation + 1;
+    currentSettingsVersion.store(slot);
+    publishedSettingsGeneration.store(settingsVersions[slot].generation);
+}
+
+// Loop task only, between transmissions: takes the one snapshot the next transmission runs with
+void applyPendingSettings()
+{
+    if (publishedSettingsGeneration.load() == txSettingsGeneration.load())
+        return;
+
+    Settings previous = txSettings;
+    uint32_t generation;
+    {
+        SettingsRef current;
+        txSettings = *current;
+        generation = current.generation();
+    }
+    const Settings &next = txSettings;
+
+    strlcpy(call, next.callsign, sizeof(call));
+    strlcpy(loc, next.locator, sizeof(loc));
+    if (next.power_mW != previous.power_mW)
+    {
+        power_mW = next.power_mW;
+        dbm = round(10 * log10(power_mW));
+    }
+    bool scheduleChanged = next.intervalMinutes != previous.intervalMinutes ||
+                           memcmp(next.bandEnabled, previous.bandEnabled, sizeof(next.bandEnabled)) ||
+                           memcmp(&next.schedule, &previous.schedule, sizeof(next.schedule));
+    memcpy(wsprBandEnabled, next.bandEnabled, sizeof(wsprBandEnabled));
+    txSchedule = next.schedule;
+    intervalBetweenTx = next.intervalMinutes * 60;
+    if (next.calFactor != previous.calFactor)
+    {
+        cal_factor = next.calFactor;
+        si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
+        saveHoldover();
+    }
+    lowPowerIdle = next.lowPowerIdle;
+    if (scheduleChanged)
+    {
+        invalidateSlotPlan();
+        interruptWSPRcurrentTX = true; // Reschedule on the new plan
+        isFirstIteration = true;
+    }
+    txSettingsGeneration = generation;
+
+    Serial.printf("\n🧩 Settings v%u applied: %s %s %u mW, every %d min, cal %d, low-power %s\n",
+                  generation, call, loc, power_mW, (int)(intervalBetweenTx / 60), cal_factor, lowPowerIdle ? "on" : "off");
+    publishState();
+}
+
+// Writer task only: the record is rewritten whole, and only if something changed
+void persistSettings(const Settings &settings)
+{
+    if (sameSettings(settings, persistedSettings))
+        return;
+    if (!storeSettingsBlob(settings))
+    {
+        Serial.println("\n⚠️ Settings could not be persisted, will retry on the next change");
+        return;
+    }
+    persistedSettings = settings;
+    Serial.printf("\n💾 Settings persisted (%u-byte record, v%d)\n", (unsigned)sizeof(SettingsBlob), SETTINGS_BLOB_VERSION);
+}
+
+void settingsWriterTask(void *parameter)
+{
+    const uint32_t stopRequests = SETTINGS_WRITE_FLUSH | SETTINGS_WRITE_DISCARD;
+    while (true)
+    {
+        uint32_t request = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &request, portMAX_DELAY);
+        // Every further edit restarts the quiet period, so a burst costs one NVS session
+        uint32_t more;
+        while (!(request & stopRequests) && xTaskNotifyWait(0, UINT32_MAX, &more, pdMS_TO_TICKS(SETTINGS_WRITE_DEBOUNCE_MS)))
+            request |= more;
+
+        if (!(request & SETTINGS_WRITE_DISCARD))
+            persistSettings(settingsSnapshot());
+        if (request & stopRequests)
+        {
+            xSemaphoreGive(settingsWriterStopped);
+            vTaskSuspend(NULL); // Until the restart
+        }
+    }
+}
+
+// 🛑 Before a restart or an NVS erase: SETTINGS_WRITE_FLUSH or SETTINGS_WRITE_DISCARD, waits for the writer
+void stopSettingsWriter(uint32_t request)
+{
+    if (!settingsWriterTaskHandle)
+        return; // Settings not loaded yet: nothing pending
+    xTaskNotify(settingsWriterTaskHandle, request, eSetBits);
+    if (xSemaphoreTake(settingsWriterStopped, pdMS_TO_TICKS(SETTINGS_WRITER_STOP_TIMEOUT_MS)) != pdTRUE)
+        Serial.println("\n⚠️ Settings writer did not stop in time");
+}
+
+// Adapter for the original per-field GET/POST routes: same validation and write-behind as PATCH /api/state
+void sendLegacyPatch(AsyncWebServerRequest *request, JsonDocument &patch, const char *okMessage)
+{
+    String error;
+    if (patch.as<JsonObjectConst>().size() == 0)
+        error = "missing parameter";
+    else
+        patchSettings(patch.as<JsonObjectConst>(), error);
+
+    if (error.isEmpty())
+        request->send(200, "text/plain", okMessage);
+    else
+        request->send(400, "text/plain", error);
+}
+
+void fillApiState(JsonObject state)
+{
+    Settings snapshot = settingsSnapshot();
+    bool pending = publishedSettingsGeneration.load() != txSettingsGeneration.load();
+
+    JsonObject settings = state.createNestedObject("settings");
+    settings["callsign"] = snapshot.callsign;
+    settings["locator"] = snapshot.locator;
+    settings["power"] = snapshot.power_mW;
+    settings["intervalMinutes"] = snapshot.intervalMinutes;
+    JsonArray bands = settings.createNestedArray("bands");
+    for (int i = 0; i < numWSPRbands; i++)
+    {
+        if (snapshot.bandEnabled[i])
+            bands.add(i);
+    }
+    settings["calFactor"] = snapshot.calFactor;
+    settings["lowPowerIdle"] = snapshot.lowPowerIdle;
+    fillScheduleSettings(settings, snapshot.schedule);
+
+    JsonObject status = state.createNestedObject("status");
+    status["version"] = VERSION;
+    status["modeOfOperation"] = modeOfOperation;
+    status["selectedBandIndex"] = selectedBandIndex;
+    status["txOn"] = tx_is_ON;
+    status["currentRemainingSeconds"] = currentRemainingSeconds;
+    status["txRunningTime"] = tx_ON_running_time_in_s;
+    status["TX_referenceFrequ"] = TX_referenceFrequ;
+    status["WSPR_TX_operatingFrequ"] = WSPR_TX_operatingFrequ;
+    status["applyPending"] = pending; // Accepted, waiting for the end of the current transmission
+}
+
+void fillScheduleSettings(JsonObject settings, const ScheduleSettings &schedule)
+{
+    settings["scheduleMode"] = scheduleModeNames[schedule.mode];
+    settings["txPercent"] = schedule.txPercent;
+    settings["bandHop"] = bandHopNames[schedule.bandHop];
+    JsonArray windows = settings.createNestedArray("bandWindows");
+    for (int i = 0; i < numWSPRbands; i++)
+    {
+        JsonArray window = windows.createNestedArray();
+        window.add(schedule.bandWindow[i][0]);
+        window.add(schedule.bandWindow[i][1]);
+    }
+    JsonArray manual = settings.createNestedArray("manualPlan");
+    for (int s = 0; s < SP_SLOTS; s++)
+    {
+        if (schedule.manualPlan[s] == SP_IDLE)
+            manual.add(nullptr);
+        else
+            manual.add(schedule.manualPlan[s]);
+    }
+}
+
+// 🗓️ Schedule rules as published, plus the plan the TX engine currently runs (null until it has one)
+void fillApiSchedule(JsonObject doc)
+{
+    Settings snapshot = settingsSnapshot();
+    doc["intervalMinutes"] = snapshot.intervalMinutes;
+    JsonArray bands = doc.createNestedArray("bands");
+    for (int i = 0; i < numWSPRbands; i++)
+    {
+        if (snapshot.bandEnabled[i])
+            bands.add(i);
+    }
+    fillScheduleSettings(doc, snapshot.schedule);
+    if (snapshot.schedule.mode == SP_MODE_PERCENT)
+        doc["maxSpacingMinutes"] = SlotPlanner::maxSpacing(snapshot.schedule.txPercent) * SP_SLOT_S / 60;
+    doc["applyPending"] = publishedSettingsGeneration.load() != txSettingsGeneration.load();
+
+    portENTER_CRITICAL(&slotPlanMux);
+    SlotPlanner plan = slotPlan;
+    portEXIT_CRITICAL(&slotPlanMux);
+    if (plan.hour() == SP_NO_HOUR)
+    {
+        doc["plan"] = nullptr;
+        return;
+    }
+    JsonObject current = doc.createNestedObject("plan");
+    current["start"] = (uint32_t)plan.hour() * 3600UL;
+    current["transmissions"] = plan.txCount();
+    JsonArray slots = current.createNestedArray("slots");
+    for (int s = 0; s < SP_SLOTS; s++)
+    {
+        if (plan.band(s) == SP_IDLE)
+            slots.add(nullptr);
+        else
+            slots.add(plan.band(s));
+    }
+    if (txSlotPlanned)
+    {
+        doc["nextTx"] = (uint32_t)nextPosixTxTime;
+        doc["nextBand"] = selectedBandIndex;
+    }
+}
+
+void sendEvent(const JsonDocument &doc, const char *event)
+{
+    char json[384];
+    serializeJson(doc, json, sizeof(json));
+    events.send(json, event, millis());
+    lastEventMs = millis();
+}
+
+// 📣 Push the fields that changed since the last event (or a keep-alive when idle).
+// Called from the loop and from txPublisherTask, so publishedState is only touched under eventsLock.
+void publishState()
+{
+    if (eventsLock == NULL)
+        return; // Web server not up yet: nobody to publish to
+    xSemaphoreTakeRecursive(eventsLock, portMAX_DELAY);
+    if (events.count() == 0)
+        publishedStateValid = false; // Next client gets a full snapshot on connect anyway
+    else
+        publishChangedState();
+    xSemaphoreGiveRecursive(eventsLock);
+}
+
+// eventsLock held
+void publishChangedState()
+{
+    PublishedState current;
+    memset(&current, 0, sizeof(current));
+    current.currentRemainingSeconds = currentRemainingSeconds;
+    current.txRunningTime = tx_ON_running_time_in_s;
+    current.TX_referenceFrequ = TX_referenceFrequ;
+    current.WSPR_TX_operatingFrequ = WSPR_TX_operatingFrequ;
+    current.modeOfOperation = modeOfOperation;
+    current.selectedBandIndex = selectedBandIndex;
+    {
+        // The published settings, as on connect: call and loc belong to the loop
+        SettingsRef settings;
+        current.intervalBetweenTx = settings->intervalMinutes * 60;
+        current.power = settings->power_mW;
+        strncpy(current.callsign, settings->callsign, sizeof(current.callsign) - 1);
+        strncpy(current.locator, settings->locator, sizeof(current.locator) - 1);
+    }
+
+    bool all = !publishedStateValid;
+    StaticJsonDocument<384> doc;
+    if (all || current.currentRemainingSeconds != publishedState.currentRemainingSeconds)
+        doc["currentRemainingSeconds"] = current.currentRemainingSeconds;
+    if (all || current.txRunningTime != publishedState.txRunningTime)
+        doc["txRunningTime"] = current.txRunningTime;
+    if (all || current.TX_referenceFrequ != publishedState.TX_referenceFrequ)
+        doc["TX_referenceFrequ"] = current.TX_referenceFrequ;
+    if (all || current.WSPR_TX_operatingFrequ != publishedState.WSPR_TX_operatingFrequ)
+        doc["WSPR_TX_operatingFrequ"] = current.WSPR_TX_operatingFrequ;
+    if (all || current.intervalBetweenTx != publishedState.intervalBetweenTx)
+        doc["intervalBetweenTx"] = current.intervalBetweenTx;
+    if (all || current.modeOfOperation != publishedState.modeOfOperation)
+        doc["modeOfOperation"] = current.modeOfOperation;
+    if (all || current.selectedBandIndex != publishedState.selectedBandIndex)
+        doc["selectedBandIndex"] = current.selectedBandIndex;
+    if (all || current.power != publishedState.power)
+        doc["power"] = current.power;
+    if (all || strcmp(current.callsign, publishedState.callsign) != 0)
+        doc["callsign"] = current.callsign;
+    if (all || strcmp(current.locator, publishedState.locator) != 0)
+        doc["locator"] = current.locator;
+
+    publishedState = current;
+    publishedStateValid = true;
+
+    if (doc.size() > 0)
+        sendEvent(doc, "state");
+    else if (millis() - lastEventMs >= EVENTS_KEEPALIVE_MS)
+        sendEvent(doc, "keepalive");
+}
+
+void publishTxEvent(bool on)
+{
+    if (eventsLock == NULL || events.count() == 0)
+        return;
+
+    StaticJsonDocument<128> doc;
+    doc["on"] = on;
+    doc["band"] = selectedBandIndex;
+    doc["frequency"] = WSPR_TX_operatingFrequ / 100ULL;
+    xSemaphoreTakeRecursive(eventsLock, portMAX_DELAY);
+    sendEvent(doc, "tx");
+    publishState();
+    xSemaphoreGiveRecursive(eventsLock);
+}
+
+// txPublisherTask only
+void publishSymbolProgress(int symbol)
+{
+    if (events.count() == 0)
+        return;
+
+    StaticJsonDocument<64> doc;
+    doc["symbol"] = symbol + 1;
+    doc["count"] = SYMBOL_COUNT;
+    xSemaphoreTakeRecursive(eventsLock, portMAX_DELAY);
+    sendEvent(doc, "symbol");
+
+    // txRunningTime ticks once per second, i.e. roughly every other symbol
+    if (tx_ON_running_time_in_s != publishedState.txRunningTime)
+        publishState();
+    xSemaphoreGiveRecursive(eventsLock);
+}
+
+void startTxPublisher()
+{
+    eventsLock = xSemaphoreCreateRecursiveMutex();
+    txProgressQueue = xQueueCreate(TX_PROGRESS_QUEUE_LEN, sizeof(WsSymbolMessage));
+    xTaskCreatePinnedToCore(txPublisherTask, "TxPublisher", 4096, NULL, 1, NULL, 0);
+}
+
+// 📣 Sends what the symbol loop queued, so a slow client or a heap stall never delays a symbol
+void txPublisherTask(void *parameter)
+{
+    WsSymbolMessage symbol;
+    while (true)
+    {
+        if (xQueueReceive(txProgressQueue, &symbol, portMAX_DELAY) == pdTRUE)
+        {
+            broadcastSymbol(symbol);
+            publishSymbolProgress(symbol.index);
+        }
+    }
+}
+
+// 📡 One shared buffer for all clients instead of a copy per client
+void broadcastTelemetry(const void *message, size_t len)
+{
+    if (telemetry.count() == 0)
+        return;
+
+    AsyncWebSocketMessageBuffer *buffer = telemetry.makeBuffer((uint8_t *)message, len);
+    if (buffer)
+        telemetry.binaryAll(buffer);
+}
+
+// txPublisherTask only: a symbol is skipped while slow clients still hold every buffer
+void broadcastSymbol(const WsSymbolMessage &message)
+{
+    if (telemetry.count() == 0)
+        return;
+
+    for (AsyncWebSocketMessageBuffer *buffer : symbolBuffers)
+    {
+        if (buffer && buffer->count() == 0)
+        {
+            memcpy(buffer->get(), &message, sizeof(message));
+            telemetry.binaryAll(buffer);
+            return;
+        }
+    }
+}
+
+void recordSymbolJitter(uint32_t jitterUs)
+{
+    byte i = 0;
+    while (i < SYMBOL_JITTER_BUCKETS - 1 && jitterUs > symbolJitterBoundsUs[i])
+        i++;
+    symbolJitterBuckets[i].fetch_add(1, std::memory_order_relaxed);
+    symbolJitterSumUs.fetch_add(jitterUs, std::memory_order_relaxed);
+    symbolJitterCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void metricHeader(Print &out, const char *name, const char *type, const char *help)
+{
+    out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void taskStackMetric(Print &out, TaskHandle_t task)
+{
+    if (task)
+        out.printf("wspr_task_stack_free_bytes{task=\"%s\"} %u\n", pcTaskGetName(task), (unsigned)uxTaskGetStackHighWaterMark(task));
+}
+
+// 📈 Prometheus text exposition (format 0.0.4). Counters only read atomics or word-sized
+// variables, so scraping never takes a lock the TX path could be waiting for.
+void sendMetrics(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4", 4096);
+    Print &out = *response;
+
+    metricHeader(out, "wspr_uptime_seconds", "counter", "Time since boot");
+    out.printf("wspr_uptime_seconds %.3f\n", esp_timer_get_time() / 1e6);
+
+    // 🧮 Heap
+    metricHeader(out, "wspr_heap_free_bytes", "gauge", "Free 8-bit capable heap");
+    out.printf("wspr_heap_free_bytes %u\n", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    metricHeader(out, "wspr_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+    out.printf("wspr_heap_min_free_bytes %u\n", heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    metricHeader(out, "wspr_heap_largest_free_block_bytes", "gauge", "Largest allocatable block");
+    out.printf("wspr_heap_largest_free_block_bytes %u\n", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    const AsyncWebArenaStats &arena = AsyncWebArena::stats();
+    metricHeader(out, "wspr_http_arena_bytes", "gauge", "Request parse arenas held by open connections");
+    out.printf("wspr_http_arena_bytes %u\n", arena.liveBytes);
+    metricHeader(out, "wspr_http_arena_peak_bytes", "gauge", "High-water mark of wspr_http_arena_bytes");
+    out.printf("wspr_http_arena_peak_bytes %u\n", arena.peakBytes);
+
+    // 🧵 Tasks
+    metricHeader(out, "wspr_task_stack_free_bytes", "gauge", "Stack never used by the task (high-water mark)");
+#if configUSE_TRACE_FACILITY
+    UBaseType_t maxTasks = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = (TaskStatus_t *)malloc(maxTasks * sizeof(TaskStatus_t));
+    UBaseType_t numTasks = 0;
+    uint32_t totalRunTime = 0;
+    if (tasks)
+        numTasks = uxTaskGetSystemState(tasks, maxTasks, &totalRunTime);
+    for (UBaseType_t i = 0; i < numTasks; i++)
+        out.printf("wspr_task_stack_free_bytes{task=\"%s\"} %u\n", tasks[i].pcTaskName, (unsigned)tasks[i].usStackHighWaterMark);
+#if configGENERATE_RUN_TIME_STATS
+    metricHeader(out, "wspr_task_cpu_seconds_total", "counter", "CPU time used by the task");
+    for (UBaseType_t i = 0; i < numTasks; i++)
+        out.printf("wspr_task_cpu_seconds_total{task=\"%s\"} %.6f\n", tasks[i].pcTaskName, tasks[i].ulRunTimeCounter / 1e6);
+#endif
+    free(tasks);
+#else
+    // No trace facility in this FreeRTOS build: report the tasks this firmware knows about
+    taskStackMetric(out, loopTaskHandle);
+    taskStackMetric(out, xTaskGetCurrentTaskHandle()); // async_tcp
+    taskStackMetric(out, settingsWriterTaskHandle);
+    taskStackMetric(out, timeVerifyTaskHandle);
+    taskStackMetric(out, txCounterTaskHandle);
+#endif
+
+    // 📡 Si5351 I2C traffic
+    metricHeader(out, "wspr_si5351_i2c_transactions_total", "counter", "I2C transactions with the Si5351");
+    out.printf("wspr_si5351_i2c_transactions_total %u\n", si5351.i2c_stats.transactions.load(std::memory_order_relaxed));
+    metricHeader(out, "wspr_si5351_i2c_bytes_total", "counter", "Bytes moved over I2C, register address included");
+    out.printf("wspr_si5351_i2c_bytes_total %u\n", si5351.i2c_stats.bytes.load(std::memory_order_relaxed));
+    metricHeader(out, "wspr_si5351_i2c_errors_total", "counter", "NACKed or short I2C transactions");
+    out.printf("wspr_si5351_i2c_errors_total %u\n", si5351.i2c_stats.errors.load(std::memory_order_relaxed));
+
+    // 🔊 Transmissions and symbol timing
+    metricHeader(out, "wspr_tx_completed_total", "counter", "Transmissions sent to the end");
+    out.printf("wspr_tx_completed_total %u\n", txCompleted.load(std::memory_order_relaxed));
+    metricHeader(out, "wspr_tx_interrupted_total", "counter", "Transmissions cut short");
+    out.printf("wspr_tx_interrupted_total %u\n", txInterrupted.load(std::memory_order_relaxed));
+    metricHeader(out, "wspr_tx_last_duration_delta_seconds", "gauge", "Last TX duration minus the nominal 110.592 s");
+    out.printf("wspr_tx_last_duration_delta_seconds %.3f\n", txLastDurationDeltaMs.load(std::memory_order_relaxed) / 1e3);
+    metricHeader(out, "wspr_tx_last_edge_drift_seconds", "gauge", "Last symbol edge minus its ideal time in the last TX");
+    out.printf("wspr_tx_last_edge_drift_seconds %.6f\n", txLastEdgeDriftUs.load(std::memory_order_relaxed) / 1e6);
+    metricHeader(out, "wspr_tx_last_jitter_max_seconds", "gauge", "Largest symbol edge error against its deadline in the last TX");
+    out.printf("wspr_tx_last_jitter_max_seconds %.6f\n", txLastJitterMaxUs.load(std::memory_order_relaxed) / 1e6);
+    metricHeader(out, "wspr_tx_last_jitter_rms_seconds", "gauge", "RMS symbol edge error against its deadline in the last TX");
+    out.printf("wspr_tx_last_jitter_rms_seconds %.6f\n", txLastJitterRmsUs.load(std::memory_order_relaxed) / 1e6);
+    metricHeader(out, "wspr_symbol_jitter_seconds", "histogram", "Symbol edge error against its deadline, all transmissions");
+    uint32_t cumulative = 0;
+    for (byte i = 0; i < SYMBOL_JITTER_BUCKETS; i++)
+    {
+        cumulative += symbolJitterBuckets[i].load(std::memory_order_relaxed);
+        if (i < SYMBOL_JITTER_BUCKETS - 1)
+            out.printf("wspr_symbol_jitter_seconds_bucket{le=\"%g\"} %u\n", symbolJitterBoundsUs[i] / 1e6, cumulative);
+        else
+            out.printf("wspr_symbol_jitter_seconds_bucket{le=\"+Inf\"} %u\n", cumulative);
+    }
+    out.printf("wspr_symbol_jitter_seconds_sum %.6f\n", symbolJitterSumUs.load(std::memory_order_relaxed) / 1e6);
+    out.printf("wspr_symbol_jitter_seconds_count %u\n", cumulative);
+
+    // 🕒 Time discipline
+    static const char *const timeSourceNames[] = {"none", "gps", "ntp", "holdover"};
+    metricHeader(out, "wspr_time_source", "gauge", "Source of the current time (1 for the active one)");
+    for (byte i = 0; i < 4; i++)
+        out.printf("wspr_time_source{source=\"%s\"} %d\n", timeSourceNames[i], timeSource == i);
+    metricHeader(out, "wspr_time_last_step_seconds", "gauge", "Clock step applied by the last sync");
+    out.printf("wspr_time_last_step_seconds %.6f\n", timeLastStepUs.load(std::memory_order_relaxed) / 1e6);
+    TimeHoldover holdover;
+    holdoverSnapshot(holdover);
+    int64_t predictedUs;
+    uint32_t errorBoundUs;
+    if (holdoverPredict(holdover, &predictedUs, &errorBoundUs))
+    {
+        metricHeader(out, "wspr_time_sync_age_seconds", "gauge", "Time since the clock was last disciplined");
+        out.printf("wspr_time_sync_age_seconds %.3f\n", (esp_clk_rtc_time() - holdover.rtcUs) / 1e6);
+        metricHeader(out, "wspr_time_error_bound_seconds", "gauge", "Worst-case clock error now");
+        out.printf("wspr_time_error_bound_seconds %.6f\n", errorBoundUs / 1e6);
+    }
+
+    // 🌐 Web requests per route
+    metricHeader(out, "wspr_http_request_duration_seconds", "histogram", "Accept to close or hand-over, per route");
+    server.routeStats([&out](const char *route, const AsyncWebRouteSnapshot &stats)
+                      {
+        if (stats.requests == 0)
+            return;
+        uint32_t cumulative = 0;
+        for (byte i = 0; i < ASYNCWEB_LATENCY_BUCKETS; i++)
+        {
+            cumulative += stats.buckets[i];
+            if (i < ASYNCWEB_LATENCY_BUCKETS - 1)
+                out.printf("wspr_http_request_duration_seconds_bucket{route=\"%s\",le=\"%g\"} %u\n", route, AsyncWebLatencyBoundsUs[i] / 1e6, cumulative);
+            else
+                out.printf("wspr_http_request_duration_seconds_bucket{route=\"%s\",le=\"+Inf\"} %u\n", route, cumulative);
+        }
+        out.printf("wspr_http_request_duration_seconds_sum{route=\"%s\"} %.6f\n", route, stats.sumUs / 1e6);
+        out.printf("wspr_http_request_duration_seconds_count{route=\"%s\"} %u\n", route, stats.requests); });
+
+    // 🔌 AsyncTCP event queue
+    async_tcp_stats_t tcp;
+    async_tcp_get_stats(&tcp);
+    metricHeader(out, "wspr_async_tcp_queue_depth", "gauge", "Events waiting for the async_tcp task");
+    out.printf("wspr_async_tcp_queue_depth %u\n", tcp.queueDepth);
+    metricHeader(out, "wspr_async_tcp_queue_high_water", "gauge", "Deepest the event queue has been");
+    out.printf("wspr_async_tcp_queue_high_water %u\n", tcp.queueHighWater);
+    metricHeader(out, "wspr_async_tcp_pool_free", "gauge", "Free preallocated event packets");
+    out.printf("wspr_async_tcp_pool_free %u\n", tcp.poolFree);
+    metricHeader(out, "wspr_async_tcp_pool_misses_total", "counter", "Event packets allocated from the heap because the pool was empty");
+    out.printf("wspr_async_tcp_pool_misses_total %u\n", tcp.poolMisses);
+    metricHeader(out, "wspr_async_tcp_polls_coalesced_total", "counter", "Polls skipped because one was still queued for the client");
+    out.printf("wspr_async_tcp_polls_coalesced_total %u\n", tcp.pollsCoalesced);
+    metricHeader(out, "wspr_async_tcp_polls_dropped_total", "counter", "Polls skipped because the queue was nearly full");
+    out.printf("wspr_async_tcp_polls_dropped_total %u\n", tcp.pollsDropped);
+    metricHeader(out, "wspr_async_tcp_recv_deferred_total", "counter", "Received data handed back to LwIP to retry later");
+    out.printf("wspr_async_tcp_recv_deferred_total %u\n", tcp.recvDeferred);
+    metricHeader(out, "wspr_async_tcp_stalls_total", "counter", "LwIP-side waits for queue space");
+    out.printf("wspr_async_tcp_stalls_total %u\n", tcp.stalls);
+    metricHeader(out, "wspr_async_tcp_dropped_total", "counter", "Events lost because no event packet could be allocated");
+    out.printf("wspr_async_tcp_dropped_total %u\n", tcp.dropped);
+
+    // 📝 Deferred log
+    DeferredLogStats logStats = DLog.stats();
+    metricHeader(out, "wspr_log_records_total", "counter", "Records queued by the deferred logger");
+    out.printf("wspr_log_records_total %u\n", logStats.logged);
+    metricHeader(out, "wspr_log_dropped_total", "counter", "Records lost to a full log ring");
+    out.printf("wspr_log_dropped_total %u\n", logStats.dropped);
+    metricHeader(out, "wspr_log_ring_high_water", "gauge", "Most records ever waiting in the log ring");
+    out.printf("wspr_log_ring_high_water %u\n", logStats.highWater);
+
+    // 🔋 Power
+    static const char *const powerStateNames[] = {"active", "idle", "tx"};
+    metricHeader(out, "wspr_power_state_seconds", "gauge", "Time per power state in the current accounting hour");
+    for (byte i = 0; i < 3; i++)
+        out.printf("wspr_power_state_seconds{state=\"%s\"} %.3f\n", powerStateNames[i], powerStateMs[i] / 1e3);
+    metricHeader(out, "wspr_current_average_amperes", "gauge", "Estimated average supply current");
+    out.printf("wspr_current_average_amperes %.4f\n", averageCurrent_mA() / 1e3);
+
+    // 🚀 Boot
+    metricHeader(out, "wspr_boot_stage_seconds", "gauge", "Duration of each boot stage");
+    for (byte i = 0; i < numBootStages; i++)
+        out.printf("wspr_boot_stage_seconds{stage=\"%s\"} %.3f\n", bootStages[i].name, (bootStages[i].endMs - bootStages[i].startMs) / 1e3);
+    metricHeader(out, "wspr_boot_stage_failed", "gauge", "Boot stage that failed (1) and whose dependents never ran");
+    for (byte i = 0; i < numBootStages; i++)
+        out.printf("wspr_boot_stage_failed{stage=\"%s\"} %d\n", bootStages[i].name, bootStages[i].failed);
+    metricHeader(out, "wspr_boot_ready_to_tx_seconds", "gauge", "Power-on to ready to transmit");
+    out.printf("wspr_boot_ready_to_tx_seconds %.3f\n", bootReadyToTxMs / 1e3);
+
+    request->send(response);
+}
+
+void onTelemetryEvent(AsyncWebSocket *ws, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    if (type == WS_EVT_CONNECT)
+    {
+        WsCalibrationMessage state = {WS_MSG_CALIBRATION, cal_factor};
+        client->binary((uint8_t *)&state, sizeof(state));
+        return;
+    }
+    if (type != WS_EVT_DATA)
+        return;
+
+    // Commands are small: only accept complete single-frame binary messages
+    AwsFrameInfo *info = (AwsFrameInfo *)arg;
+    if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_BINARY)
+        return;
+
+    if (len == sizeof(WsCalibrationMessage) && data[0] == WS_CMD_SET_CALIBRATION)
+    {
+        WsCalibrationMessage command;
+        memcpy(&command, data, sizeof(command));
+        if (!requestCalFactor(command.calFactor))
+        {
+            // Not in calibration mode: tell the sender the factor still in use
+            WsCalibrationMessage state = {WS_MSG_CALIBRATION, cal_factor};
+            client->binary((uint8_t *)&state, sizeof(state));
+        }
+    }
+}
+
+// Any task: only honoured in calibration mode, where no transmission runs
+bool requestCalFactor(int32_t calFactor)
+{
+    if (!performCalibration || calFactor == CAL_FACTOR_NONE)
+        return false;
+    requestedCalFactor.store(calFactor);
+    return true;
+}
+
+// loop() only: Si5351 writes stay on the core that transmits
+void applyRequestedCalFactor()
+{
+    int32_t calFactor = requestedCalFactor.exchange(CAL_FACTOR_NONE);
+    if (calFactor == CAL_FACTOR_NONE)
+        return;
+
+    cal_factor = calFactor;
+    si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
+    saveHoldover();
+    Serial.printf("📏 Calibration factor set to %d\n", cal_factor);
+
+    // Echo to every client so all open calibration pages show the applied value
+    WsCalibrationMessage state = {WS_MSG_CALIBRATION, cal_factor};
+    broadcastTelemetry(&state, sizeof(state));
+}
+
+void enterLowPowerIdle()
+{
+    if (lowPowerActive)
+        return;
+    lowPowerActive = true;
+    accountPowerState(POWER_STATE_IDLE);
+
+    // 📴 RF output fully off while idle
+    si5351.set_clock_pwr(SI5351_CLK0, 0);
+    si5351.output_enable(SI5351_CLK0, 0);
+
+    // 📶 Modem sleep: the radio wakes on every DTIM beacon, so the web UI stays reachable
+    WiFi.setSleep(true);
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+    // 😴 Automatic light sleep when FreeRTOS is idle; DFS only if the build has no PM support
+    esp_pm_config_esp32_t pm = {.max_freq_mhz = 240, .min_freq_mhz = 80, .light_sleep_enable = true};
+    autoLightSleep = esp_pm_configure(&pm) == ESP_OK;
+    if (!autoLightSleep)
+        setCpuFrequencyMhz(80);
+
+    Serial.printf("\n💤 Low-power idle (%s) until %d s before the slot\n",
+                  autoLightSleep ? "light sleep" : "80 MHz", LOW_POWER_WAKE_LEAD_S);
+}
+
+void exitLowPowerIdle()
+{
+    if (!lowPowerActive)
+        return;
+    lowPowerActive = false;
+
+    if (autoLightSleep)
+    {
+        esp_pm_config_esp32_t pm = {.max_freq_mhz = 240, .min_freq_mhz = 240, .light_sleep_enable = false};
+        esp_pm_configure(&pm);
+    }
+    else
+    {
+        setCpuFrequencyMhz(240);
+    }
+    WiFi.setSleep(false); // Full-speed radio for time sync and web traffic around TX
+
+    accountPowerState(POWER_STATE_ACTIVE);
+    Serial.println("\n⏰ Woke up from low-power idle");
+}
+
+// 🔋 Time spent in each state, rolled over every hour to report the average current
+void accountPowerState(byte newState)
+{
+    unsigned long nowMs = millis();
+    powerStateMs[powerState] += nowMs - powerStateSince;
+    powerStateSince = nowMs;
+    powerState = newState;
+
+    if (nowMs - powerWindowStart >= 3600000UL)
+    {
+        lastHourAverage_mA = averageCurrent_mA();
+        powerWindowStart = nowMs;
+        powerStateMs[POWER_STATE_ACTIVE] = powerStateMs[POWER_STATE_IDLE] = powerStateMs[POWER_STATE_TX] = 0;
+    }
+}
+
+float averageCurrent_mA()
+{
+    unsigned long totalMs = 0;
+    float charge = 0;
+    for (byte i = 0; i < 3; i++)
+    {
+        unsigned long ms = powerStateMs[i] + (i == powerState ? millis() - powerStateSince : 0);
+        totalMs += ms;
+        charge += ms * powerStateCurrent_mA[i];
+    }
+    return totalMs ? charge / totalMs : powerStateCurrent_mA[POWER_STATE_ACTIVE];
+}
+
+void startBootOrchestrator()
+{
+    bootEvents = xEventGroupCreate();
+
+    for (byte i = 0; i < numBootStages; i++)
+    {
+        xTaskCreatePinnedToCore(bootStageTask, bootStages[i].name, 6144, &bootStages[i], 1, NULL, 0);
+    }
+}
+
+void bootStageTask(void *parameter)
+{
+    BootStage *stage = (BootStage *)parameter;
+
+    if (stage->dependsOn)
+        xEventGroupWaitBits(bootEvents, stage->dependsOn, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    stage->startMs = millis();
+    stage->failed = !stage->run();
+    stage->endMs = millis();
+
+    EventBits_t done;
+    if (stage->failed)
+    {
+        Serial.printf("❌ Boot stage %s failed\n", stage->name);
+        done = xEventGroupGetBits(bootEvents);
+    }
+    else
+        done = xEventGroupSetBits(bootEvents, stage->bit);
+
+    // 🧾 Last stage to finish prints the summary
+    bool printSummary = false;
+    portENTER_CRITICAL(&bootSummaryMux);
+    if (stage->failed)
+        bootFailedStages |= stage->bit;
+    if (((done | bootFailedStages) & BOOT_ALL) == BOOT_ALL && !bootSummaryPrinted)
+    {
+        bootSummaryPrinted = true;
+        printSummary = true;
+    }
+    portEXIT_CRITICAL(&bootSummaryMux);
+    if (printSummary)
+        printBootTimings();
+
+    vTaskDelete(NULL);
+}
+
+bool bootStageFS()
+{
+    if (!FILESYSTEM.begin(true))
+    {
+        Serial.println("An error occurred while mounting LittleFS");
+        return true; // The web server still runs, without its pages
+    }
+    Serial.println("LittleFS mounted successfully");
+    if (LOG_TO_FILE)
+        DLog.addSink(&fileLogSink);
+    startHistoryWriter();
+    loadWebAssetManifest();
+
+    if (webBundle.begin())
+        Serial.printf("⚡ Web bundle mapped: %u assets, %u bytes\n", webBundle.count(), webBundle.size());
+    else
+        Serial.println("⚠️ No valid web bundle, serving from LittleFS.");
+    return true;
+}
+
+bool bootStageSettings()
+{
+    retrieveUserSettings();
+    Settings initial;
+    captureSettings(initial);
+    initSettingsVersions(initial);
+    settingsWriterStopped = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(settingsWriterTask, "SettingsWriter", 4096, NULL, 1, &settingsWriterTaskHandle, 0);
+
+    // 🔧 Resume an interrupted calibration with the live (unsaved) factor
+    TimeHoldover holdover;
+    holdoverSnapshot(holdover);
+    if (warmBoot && holdover.inCalibration)
+    {
+        cal_factor = holdover.calFactor;
+        performCalibration = true;
+    }
+    return true;
+}
+
+bool bootStageWiFi()
+{
+    connectToWiFi();
+    startSpotFetcher();
+    return true;
+}
+
+bool bootStageTime()
+{
+    if (warmBoot)
+    {
+        // ✅ Confirm the holdover time against GPS/NTP without delaying the schedule
+        lastGPSretry = millis();
+        xTaskCreatePinnedToCore(timeVerifyTask, "TimeVerifyTask", 4096, NULL, 1, &timeVerifyTaskHandle, 0);
+        return true;
+    }
+
+    if (!syncTimeFromGPS())
+    {
+        xEventGroupWaitBits(bootEvents, BOOT_WIFI, pdFALSE, pdTRUE, portMAX_DELAY);
+        initialTimeSyncViaSNTP(); // your existing SNTP fallback
+    }
+    return true;
+}
+
+bool bootStageSi5351()
+{
+    if (!initSI5351())
+        return false; // Nothing to transmit with: BOOT_READY_TO_TX never comes, the web UI stays up
+    if (performCalibration)
+    {
+        calibrationStarted = true;
+        setFrequencyInMhz(calFrequencyInMhz);
+        Serial.printf("🔧 Calibration resumed with factor %d\n", cal_factor);
+    }
+    return true;
+}
+
+bool bootStageWeb()
+{
+    configure_web_server();
+    return true;
+}
+
+void printBootTimings()
+{
+    Serial.println(F("\n⏱️ --- Boot timings (ms since power-on) ------------------------------"));
+    for (byte i = 0; i < numBootStages; i++)
+    {
+        Serial.printf("   %-12s %6lu → %6lu  (%lu ms)%s\n", bootStages[i].name,
+                      bootStages[i].startMs, bootStages[i].endMs, bootStages[i].endMs - bootStages[i].startMs,
+                      bootStages[i].failed ? "  FAILED" : "");
+    }
+    Serial.printf("   %-12s %6lu\n", "Ready to TX", bootReadyToTxMs);
+    Serial.println(F("---------------------------------------------------------------------"));
+}
+
+bool initSI5351()
+{
+    const uint8_t SI5351_ADDRESS = 0x60;
+    Serial.println("");
+    Serial.println("📡 Initializing Si5351...");
+
+    // 🔌 Start I²C bus at 400 kHz (fast mode) — reliable and quick on ESP32
+    Wire.begin(SI5351_SDA, SI5351_SCL);
+    Wire.setClock(400000);
+
+    // 🔍 Probe Si5351 I²C address to check if device is present
+    Wire.beginTransmission(SI5351_ADDRESS);
+
+    if (Wire.endTransmission() != 0)
+    {
+        Serial.println("❌ Si5351 not found at 0x60. Check wiring or power.");
+        return false;
+    }
+
+    // ✅ Found and ready to initialize
+    Serial.println("✅ Success! Si5351 module found!! 🎉");
+
+    // ⚙️ Initialize Si5351 with 8pF crystal load (typical for cheap boards)
+    si5351.init(SI5351_CRYSTAL_LOAD_8PF, 0, 0); // 0, 0 = use default XTAL + correction
+
+    // 🔧 Apply frequency calibration correction (in parts per billion)
+    Serial.print("🔧 Applying Calibration Factor: ");
+    Serial.println(cal_factor);
+    si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
+
+    // 📶 Set frequency for selected TX clock output (CLK0, CLK1, or CLK2)
+    Serial.print("📶 Setting TX Reference Frequency: ");
+    Serial.print(TX_referenceFrequ);
+    Serial.println(" Hz");
+    si5351.set_freq(TX_referenceFrequ, SI5351_CLK0);
+
+    // 💪 Set drive strength for the selected clock output (strongest = 8 mA)
+    Serial.print("💪 Setting RF output strength to max ");
+
+    si5351.drive_strength(SI5351_CLK0, SI5351_DRIVE_8MA);
+
+    // 📴 Disable all unused outputs among CLK0, CLK1, and CLK2
+    Serial.println("🔌 Disabling unused clock outputs: ");
+    bool first = true;
+    si5351_clock clocks[] = {SI5351_CLK0, SI5351_CLK1, SI5351_CLK2};
+
+    for (si5351_clock clk : clocks)
+    {
+        si5351.set_clock_pwr(clk, 0); // Disable unused clock output
+        // Serial.print("Disabling CLK");
+        // Serial.println((int)clk); // newline for better readability
+    }
+    Serial.println();
+    // switch OFF
+    si5351.set_clock_pwr(SI5351_CLK0, 0);
+    Serial.println("");
+    return true;
+}
+void initializeNextTransmissionTime()
+{
+    // 🕒 Get Current Epoch Time
+    currentEpochTime = time(nullptr);
+
+    // 🗓️ First planned slot after now
+    scheduleNextTransmission(currentEpochTime);
+
+    // ✅ Log the Result
+    DLOG_I(LOG_NEXT_TX_TIME, LOG_HMS(nextPosixTxTime));
+}
+
+// Hours [start, end) as a mask of UTC hours; a window ending before it starts wraps past midnight
+uint32_t windowHours(uint8_t start, uint8_t end)
+{
+    uint32_t mask = 0;
+    for (uint8_t h = 0; h < 24; h++)
+    {
+        if (start < end ? (h >= start && h < end) : (h >= start || h < end))
+            mask |= 1UL << h;
+    }
+    return mask;
+}
+
+// Loop task only: the rules the TX engine runs with
+void fillSlotRules(SlotRules &rules)
+{
+    memset(&rules, 0, sizeof(rules));
+    rules.mode = txSchedule.mode;
+    rules.intervalSlots = intervalBetweenTx / SP_SLOT_S;
+    rules.txPercent = txSchedule.txPercent;
+    rules.hop = txSchedule.bandHop;
+    rules.bandCount = numWSPRbands;
+    uint64_t mac = ESP.getEfuseMac(); // Per device, so neighbours in percent mode follow different sequences
+    rules.seed = (uint32_t)mac ^ (uint32_t)(mac >> 32);
+    for (int i = 0; i < numWSPRbands; i++)
+        rules.bandHours[i] = wsprBandEnabled[i] ? windowHours(txSchedule.bandWindow[i][0], txSchedule.bandWindow[i][1]) : 0;
+    memcpy(rules.hopBand, bandHopCycle, sizeof(rules.hopBand));
+    memcpy(rules.manual, txSchedule.manualPlan, sizeof(rules.manual));
+}
+
+void invalidateSlotPlan()
+{
+    portENTER_CRITICAL(&slotPlanMux);
+    slotPlan.invalidate();
+    portEXIT_CRITICAL(&slotPlanMux);
+}
+
+// Loop task only: the first planned slot starting after `after`, one lookup per slot
+bool findNextSlot(time_t after, time_t &slotStart, byte &bandIndex)
+{
+    uint32_t slot = after / SP_SLOT_S + 1;
+    uint32_t last = slot + SLOT_LOOKAHEAD_HOURS * SP_SLOTS;
+    for (; slot < last; slot++)
+    {
+        uint32_t hour = slot / SP_SLOTS;
+        if (!slotPlan.covers(hour))
+        {
+            SlotRules rules;
+            fillSlotRules(rules);
+            SlotPlanner plan;
+            plan.build(rules, hour);
+            portENTER_CRITICAL(&slotPlanMux);
+            slotPlan = plan;
+            portEXIT_CRITICAL(&slotPlanMux);
+            DLOG_I(LOG_PLAN_BUILT, hour % 24, plan.txCount(), DLOG_STR(scheduleModeNames[rules.mode]),
+                   DLOG_STR(bandHopNames[rules.hop]));
+        }
+
+        byte band = slotPlan.band(slot % SP_SLOTS);
+        if (band != SP_IDLE)
+        {
+            slotStart = (time_t)slot * SP_SLOT_S;
+            bandIndex = band;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Loop task only: sets nextPosixTxTime and moves to the band of that slot
+void scheduleNextTransmission(time_t after)
+{
+    time_t slotStart;
+    byte band;
+    txSlotPlanned = findNextSlot(after, slotStart, band);
+    if (!txSlotPlanned)
+    {
+        DLOG_W(LOG_PLAN_EMPTY, SLOT_LOOKAHEAD_HOURS);
+        nextPosixTxTime = after + 3600; // Look again; a settings change reschedules at once
+        return;
+    }
+
+    nextPosixTxTime = slotStart;
+    if (band != selectedBandIndex)
+        DLOG_I(LOG_BAND_SWITCH, band, DLOG_STR(WSPRbandNames[band]));
+    selectedBandIndex = band;
+}
+
+// buf must hold 9 chars (HH:MM:SS + null terminator); returns buf
+char *convertPosixToHHMMSS(time_t posixTime, char *buf)
+{
+    struct tm timeInfo;
+    gmtime_r(&posixTime, &timeInfo); // UTC, without gmtime()'s shared static buffer
+
+    snprintf(buf, 9, "%02d:%02d:%02d", timeInfo.tm_hour, timeInfo.tm_min, timeInfo.tm_sec);
+    return buf;
+}
+
+void si5351_WarmingUp()
+{
+    warmingup = true;
+    DLOG_I(LOG_WARMUP_START);
+
+    // 🎛️ Pick the TX frequency within the 200 Hz sub-band, away from the signals reported around us
+
+    WSPR_TX_operatingFrequ = chooseWSPRfrequency(selectedBandIndex) * 100ULL; /// Hz * 100 for module
+
+    // 📡 Log the new TX frequency with formatting
+    unsigned long txFrequency = WSPR_TX_operatingFrequ / 100ULL;
+    DLOG_I(LOG_TX_FREQUENCY, LOG_FREQ(txFrequency), DLOG_STR(WSPRbandNames[selectedBandIndex]));
+    // ⚙️ Configure Si5351 for transmission
+    si5351.set_freq(WSPR_TX_operatingFrequ, SI5351_CLK0);
+    si5351.output_enable(SI5351_CLK0, 1); // May have been disabled by the low-power idle
+    si5351.set_clock_pwr(SI5351_CLK0, 1); // Power ON
+}
+
+void startTransmission()
+{
+    tx_is_ON = true;
+    accountPowerState(POWER_STATE_TX);
+    publishTxEvent(true);
+
+    xTaskCreatePinnedToCore(
+        TX_ON_counter_core0,  // Task function
+        "TXCounterTask",      // Name of the task
+        2048,                 // Stack size in words
+        NULL,                 // Task input parameter
+        1,                    // Priority of the task
+        &txCounterTaskHandle, // Task handle
+        0                     // Core to pin the task to (0 in this case)
+    );
+
+    transmitWSPR();
+    warmingup = false;
+    tx_is_ON = false;
+    tx_ON_running_time_in_s = 0;
+    accountPowerState(POWER_STATE_ACTIVE);
+    publishTxEvent(false);
+    float average_mA = averageCurrent_mA();
+    DLOG_I(LOG_TX_CURRENT, LOG_TENTHS(average_mA), LOG_TENTHS(lastHourAverage_mA));
+
+    // Wait for the task to complete and clean up
+    vTaskDelete(txCounterTaskHandle);
+    txCounterTaskHandle = NULL;
+}
+
+// ✅ Returns a safe WSPR transmit frequency for a given band index: random among the least occupied
+// 6 Hz channels of the sub-band, never on top of the previous TX on that band
+unsigned long chooseWSPRfrequency(byte bandIndex)
+{
+    unsigned long officialStart = WSPRbandStart[bandIndex];
+    unsigned long officialEnd = WSPRbandEnd[bandIndex];
+
+    // Make sure there's space for the 6 Hz bandwidth of WSPR signal
+    int minHz = 15;                                    // Should be 3, but add 15 as "safety" margin
+    int maxHz = (int)(officialEnd - officialStart) - 15; // Should be 3, but deduct 15 as "safety" margin
+
+    portENTER_CRITICAL(&plannerMux);
+    FrequencyPlanner planner = bandPlanners[bandIndex];
+    portEXIT_CRITICAL(&plannerMux);
+    int offset = planner.choose(minHz, maxHz, (int)lastTxOffsetHz[bandIndex] - 1, esp_random);
+    lastTxOffsetHz[bandIndex] = offset + 1;
+
+    return officialStart + offset;
+}
+
+// Writes freq with a dot every 3 digits from the right into buf; returns buf
+char *formatFrequencyWithDots(unsigned long freq, char *buf, size_t size)
+{
+    char digits[11];
+    int len = snprintf(digits, sizeof(digits), "%lu", freq);
+
+    size_t out = 0;
+    for (int i = 0; i < len && out + 1 < size; i++)
+    {
+        if (i > 0 && (len - i) % 3 == 0)
+        {
+            buf[out++] = '.';
+            if (out + 1 >= size)
+                break;
+        }
+        buf[out++] = digits[i];
+    }
+    buf[out] = '\0';
+    return buf;
+}
+
+void TX_ON_counter_core0(void *parameter)
+{
+    tx_ON_running_time_in_s = 0;
+
+    while (tx_is_ON == true)
+    {
+        tx_ON_running_time_in_s = tx_ON_running_time_in_s + 1;
+        // The transmission occupies exactly 110.592 seconds ( rounded to 110).
+
+        // Serial.printf("TX ON counter: %d seconds\n", tx_ON_running_time_in_s);
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+
+    // Delete the task if tx_is_ON is false to free resources
+    vTaskDelete(NULL);
+    txCounterTaskHandle = NULL;
+}
+
+void displaySelectedBandInformation(byte bandIndex)
+{
+    unsigned long officialStart = WSPRbandStart[bandIndex];
+    unsigned long officialEnd = WSPRbandEnd[bandIndex];
+    unsigned long minF = officialStart + 3;
+    unsigned long maxF = officialEnd - 3;
+
+    Serial.println();
+    Serial.println(F("📶 --- WSPR Transmission Setup --------------------------------------"));
+
+    Serial.printf("🔹 %-20s %s\n", "Band:", WSPRbandNames[bandIndex]);
+    Serial.printf("🔹 %-20s %lu – %lu Hz\n", "Sub-band:", officialStart, officialEnd);
+    Serial.printf("🔹 %-20s %lu – %lu Hz (excludes ±3 Hz edges)\n", "Usable range:", minF, maxF);
+    Serial.printf("🔹 %-20s ~6 Hz centered around selected frequency\n", "Bandwidth used:");
+    Serial.printf("🧾 %-20s %s\n", "Callsign:", call);
+    Serial.printf("🌍 %-20s %s\n", "Locator:", loc);
+    Serial.printf("⚡ %-20s %d mW → %d dBm\n", "Power:", power_mW, dbm);
+    if (txSchedule.mode == SP_MODE_PERCENT)
+        Serial.printf("📅 %-20s %u%% of slots, at most %u minutes apart\n", "TX Percentage:", txSchedule.txPercent,
+                      SlotPlanner::maxSpacing(txSchedule.txPercent) * SP_SLOT_S / 60);
+    else if (txSchedule.mode == SP_MODE_MANUAL)
+        Serial.printf("📅 %-20s %s\n", "Schedule:", "manual slot plan");
+    else
+        Serial.printf("📅 %-20s %d minutes\n", "Scheduled Interval:", intervalBetweenTx / 60);
+
+    Serial.println(F("---------------------------------------------------------------------"));
+}
+
+void transmitWSPR()
+{
+    // 🎙️ Encode WSPR message (callsign and locator were shown with the band information)
+    jtencode.wspr_encode(call, loc, dbm, tx_buffer);
+    DLOG_I(LOG_TX_ENCODED, dbm);
+
+    // 🚀 Transmission Start
+    // Record start time (both POSIX and millis)
+    unsigned long txStartEpoch = time(nullptr);
+    unsigned long txStartMillis = millis();
+    // Get current time once per loop
+    currentEpochTime = time(nullptr);
+    struct timeval txStartTime;
+    gettimeofday(&txStartTime, nullptr);
+    int32_t startOffsetUs = (int32_t)(((int64_t)txStartTime.tv_sec - nextPosixTxTime) * 1000000LL + txStartTime.tv_usec);
+    DLOG_I(LOG_TX_START, LOG_HMS(currentEpochTime));
+    // 🔊 Transmit each WSPR symbol
+    unsigned long firstEdgeMicros = micros();
+    int32_t lastEdgeErrorUs = 0;
+    uint32_t jitterMaxUs = 0;
+    uint64_t jitterSquaresUs = 0;
+
+    for (int i = 0; i < SYMBOL_COUNT; i++)
+    {
+        uint64_t toneFreq = WSPR_TX_operatingFrequ + (tx_buffer[i] * TONE_SPACING);
+        si5351.set_freq(toneFreq, SI5351_CLK0);
+
+        int32_t edgeErrorUs = (int32_t)(micros() - firstEdgeMicros - WSPR_SYMBOL_EDGE_US(i));
+        WsSymbolMessage symbolMessage = {WS_MSG_SYMBOL, (uint8_t)i, tx_buffer[i], edgeErrorUs};
+        // Residual error the deadline pacing leaves: set_freq() latency plus any late wake-up
+        uint32_t residualUs = abs(edgeErrorUs);
+        recordSymbolJitter(residualUs);
+        jitterMaxUs = max(jitterMaxUs, residualUs);
+        jitterSquaresUs += (uint64_t)residualUs * residualUs;
+        lastEdgeErrorUs = edgeErrorUs;
+        if (txProgressQueue)
+            xQueueSend(txProgressQueue, &symbolMessage, 0); // Full queue: this symbol is not shown on /ws or /events
+
+        if (TEST)
+        {
+            // Progress on the same line with percentage
+            DLOG_I(LOG_TX_SYMBOL, i + 1, SYMBOL_COUNT, (i + 1) * 100 / SYMBOL_COUNT);
+
+            if (interruptWSPRcurrentTX || performCalibration)
+            {
+                DLOG_W(LOG_TX_INTERRUPTED);
+                txInterrupted.fetch_add(1, std::memory_order_relaxed);
+                queueTxHistory(performCalibration ? TX_END_CALIBRATION : TX_END_INTERRUPTED, millis() - txStartMillis,
+                               startOffsetUs, jitterMaxUs, lastEdgeErrorUs);
+                return; // goes back to main loop
+            }
+        }
+        // Next edge at its absolute time from the first one: a late symbol does not push back the rest
+        waitUntilMicros(firstEdgeMicros + WSPR_SYMBOL_EDGE_US(i + 1));
+    }
+    // Record end time
     unsigned long txEndEpoch = time(nullptr);
     unsigned long txEndMillis = millis();
     // Shutdown Si5351 output after TX
     si5351.set_clock_pwr(SI5351_CLK0, 0);
-    Serial.println("\n📴 --- TX OFF: Transmission Complete ---\n");
+    DLOG_I(LOG_TX_COMPLETE);
 
     // --- Calculate durations ---
     unsigned long txDuration = txEndMillis - txStartMillis;
@@ -600,413 +2580,1241 @@ correction=6;
     unsigned int seconds = (txDuration % 60000) / 1000;
     unsigned int milliseconds = txDuration % 1000;
 
-    Serial.printf("⏱️ TX Duration: %lu ms (%02d:%02d & %03d ms)\n",
-                  txDuration, minutes, seconds, milliseconds);
+    DLOG_I(LOG_TX_DURATION, txDuration, minutes, seconds, milliseconds);
 
     // --- Delta with reference ---
     long delta = (long)txDuration - (long)WSPR_REFERENCE_DURATION_MS;
-    Serial.printf("📏 Delta vs Reference (110646 ms): %+ld ms\n", delta);
+    DLOG_I(LOG_TX_DELTA, delta);
+
+    txLastDurationDeltaMs.store(delta, std::memory_order_relaxed);
+    txLastEdgeDriftUs.store(lastEdgeErrorUs, std::memory_order_relaxed);
+    txLastJitterMaxUs.store(jitterMaxUs, std::memory_order_relaxed);
+    uint32_t jitterRmsUs = (uint32_t)sqrt((double)jitterSquaresUs / SYMBOL_COUNT);
+    DLOG_I(LOG_TX_EDGES, jitterMaxUs, jitterRmsUs);
+    txLastJitterRmsUs.store(jitterRmsUs, std::memory_order_relaxed);
+    txCompleted.fetch_add(1, std::memory_order_relaxed);
+    queueTxHistory(TX_END_COMPLETED, txDuration, startOffsetUs, jitterMaxUs, lastEdgeErrorUs);
     delay(2000);
 }
 
-void retrieveUserSettings()
+// Sleeps through whole ticks, then spins out the last one: vTaskDelay alone is only tick-accurate
+void waitUntilMicros(uint32_t deadline)
+{
+    int32_t remainingUs = (int32_t)(deadline - micros());
+    if (remainingUs > 2000)
+        delay((remainingUs - 2000) / 1000);
+    while ((int32_t)(deadline - micros()) > 0)
+    {
+    }
+}
+
+void startHistoryWriter()
+{
+    txHistoryQueue = xQueueCreate(TX_HISTORY_QUEUE_LEN, sizeof(TxHistoryRecord));
+    xTaskCreatePinnedToCore(historyWriterTask, "HistoryWriter", 4096, NULL, 1, NULL, 0);
+}
+
+// Never blocks: a record that finds the queue full is lost, not waited for
+void queueTxHistory(uint8_t endReason, uint32_t durationMs, int32_t startOffsetUs, uint32_t jitterMaxUs, int32_t edgeDriftUs)
 {
-    Serial.println("📂 Loading user settings from NVS...");
+    if (txHistoryQueue == NULL)
+        return;
 
-    // ✅ Open preferences namespace
-    preferences.begin("settings", false);
+    TxHistoryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.startEpoch = nextPosixTxTime;
+    record.startOffsetUs = startOffsetUs;
+    record.frequencyHz = WSPR_TX_operatingFrequ / 100ULL;
+    record.durationMs = durationMs;
+    record.jitterMaxUs = jitterMaxUs;
+    record.edgeDriftUs = edgeDriftUs;
+    record.bandIndex = selectedBandIndex;
+    record.dbm = dbm;
+    record.endReason = endReason;
+    record.timeSource = timeSource;
+    strlcpy(record.callsign, call, sizeof(record.callsign));
+    strlcpy(record.locator, loc, sizeof(record.locator));
+    xQueueSend(txHistoryQueue, &record, 0);
+}
 
-    // 📡 Retrieve Callsign
-    String storedCall = preferences.getString("callsign");
-    if (storedCall.isEmpty())
+void historyWriterTask(void *parameter)
+{
+    // The single-file ring of earlier firmware rewrote its slots in place
+    if (FILESYSTEM.exists("/history.bin"))
+        FILESYSTEM.remove("/history.bin");
+    if (!FILESYSTEM.exists(TX_HISTORY_DIR) && !FILESYSTEM.mkdir(TX_HISTORY_DIR))
     {
-        Serial.println("⚠️ Callsign not found! Setting default to 'HB9IIU' 🆕");
-        storedCall = "NOCALL";
-        preferences.putString("callsign", storedCall);
+        Serial.println("⚠️ TX history unavailable: cannot create " TX_HISTORY_DIR);
+        vTaskDelete(NULL);
+        return;
     }
-    else
+
+    FsRecordStore store(TX_HISTORY_DIR);
+    RecordRing ring = txHistoryRing(store);
+    uint32_t next = ring.begin();
+    txHistoryNextSequence.store(next, std::memory_order_release);
+    Serial.printf("📜 TX history: %u records in " TX_HISTORY_DIR "\n", next - ring.oldest());
+
+    TxHistoryRecord record;
+    while (true)
     {
-        Serial.println("✅ Callsign retrieved successfully.");
+        xQueueReceive(txHistoryQueue, &record, portMAX_DELAY);
+        // Append-only: a record costs at most one block copy, never a rewrite of the file after it
+        if (!ring.append(&record))
+            Serial.println("⚠️ TX history write failed");
+        ring.flush();
+        txHistoryNextSequence.store(ring.next(), std::memory_order_release);
     }
-    storedCall.toCharArray(call, sizeof(call));
-    Serial.printf("📢 Callsign: %s\n", call);
+}
 
-    // 🌍 Retrieve Locator
-    String storedLoc = preferences.getString("locator");
-    if (storedLoc.isEmpty())
+// 🧵 Chunked JSON arrays read from flash: one element at a time is formatted into pending and copied
+// out over as many chunks as it needs.
+struct JsonArrayStream
+{
+    const char *open;
+    const char *close;
+    bool opened;
+    bool closed;
+    bool any;
+    char pending[320];
+    size_t pendingLen;
+    size_t pendingPos;
+};
+
+// element(buf, size, first) formats the next element with its separator; 0 ends the array
+template <typename Element>
+size_t fillJsonArray(JsonArrayStream &s, uint8_t *buffer, size_t maxLen, Element element)
+{
+    size_t written = 0;
+    while (written < maxLen)
     {
-        Serial.println("⚠️ Locator not found! Setting default to 'XX00XX' 🆕");
-        storedLoc = "XX00XX";
-        preferences.putString("locator", storedLoc);
+        if (s.pendingPos < s.pendingLen)
+        {
+            size_t n = min(maxLen - written, s.pendingLen - s.pendingPos);
+            memcpy(buffer + written, s.pending + s.pendingPos, n);
+            written += n;
+            s.pendingPos += n;
+            continue;
+        }
+        if (s.closed)
+            break;
+
+        s.pendingPos = 0;
+        if (!s.opened)
+        {
+            s.pendingLen = strlcpy(s.pending, s.open, sizeof(s.pending));
+            s.opened = true;
+        }
+        else if ((s.pendingLen = element(s.pending, sizeof(s.pending), !s.any)) > 0)
+        {
+            s.any = true;
+        }
+        else
+        {
+            s.pendingLen = strlcpy(s.pending, s.close, sizeof(s.pending));
+            s.closed = true;
+        }
     }
-    else
+    return written;
+}
+
+// 📜 GET /api/history?from=<epoch>&to=<epoch>&band=<index or name>&limit=<n>
+// Streams a JSON array, oldest first, one record read from flash at a time.
+struct TxHistoryCursor
+{
+    FsRecordStore store;
+    RecordRing ring;
+    uint32_t sequence;
+    uint32_t end;
+    uint32_t from;
+    uint32_t to;
+    int band; // -1 for all
+    uint32_t remaining;
+    JsonArrayStream out;
+
+    TxHistoryCursor() : store(TX_HISTORY_DIR), ring(txHistoryRing(store)), out() {}
+};
+
+// Leaves the record's sequence in c.sequence - 1
+bool nextTxHistory(TxHistoryCursor &c, TxHistoryRecord &record)
+{
+    while (c.remaining && c.sequence < c.end)
     {
-        Serial.println("✅ Locator retrieved successfully.");
+        if (c.ring.read(c.sequence++, &record) && record.startEpoch >= c.from && record.startEpoch <= c.to &&
+            (c.band < 0 || record.bandIndex == c.band))
+        {
+            c.remaining--;
+            return true;
+        }
     }
-    storedLoc.toCharArray(loc, sizeof(loc));
-    Serial.printf("📢 Locator: %s\n", loc);
+    return false;
+}
+
+size_t formatTxHistory(uint32_t sequence, const TxHistoryRecord &r, bool first, char *buf, size_t size)
+{
+    static const char *const endReasons[] = {"completed", "interrupted", "calibration"};
+    static const char *const timeSources[] = {"none", "gps", "ntp", "holdover"};
+    char callsign[sizeof(r.callsign) + 1];
+    char locator[sizeof(r.locator) + 1];
+    strlcpy(callsign, r.callsign, sizeof(callsign));
+    strlcpy(locator, r.locator, sizeof(locator));
+    int n = snprintf(buf, size,
+                     "%s{\"seq\":%u,\"start\":%u,\"startOffsetUs\":%d,\"frequency\":%u,\"band\":\"%s\",\"bandIndex\":%u,"
+                     "\"callsign\":\"%s\",\"locator\":\"%s\",\"dbm\":%u,\"durationMs\":%u,\"jitterMaxUs\":%u,"
+                     "\"edgeDriftUs\":%d,\"end\":\"%s\",\"timeSource\":\"%s\"}",
+                     first ? "" : ",", sequence, r.startEpoch, r.startOffsetUs, r.frequencyHz,
+                     r.bandIndex < numWSPRbands ? WSPRbandNames[r.bandIndex] : "?", r.bandIndex,
+                     callsign, locator, r.dbm, r.durationMs, r.jitterMaxUs, r.edgeDriftUs,
+                     r.endReason < 3 ? endReasons[r.endReason] : "unknown",
+                     r.timeSource < 4 ? timeSources[r.timeSource] : "unknown");
+    return n < 0 ? 0 : min<size_t>(n, size - 1);
+}
 
-    // ⚡ Retrieve Power in mW
-    power_mW = preferences.getUInt("power", 0);
-    if (power_mW == 0)
+void sendTxHistory(AsyncWebServerRequest *request)
+{
+    std::shared_ptr<TxHistoryCursor> cursor(new TxHistoryCursor());
+    cursor->end = txHistoryNextSequence.load(std::memory_order_acquire);
+    cursor->sequence = cursor->ring.oldest(cursor->end);
+    cursor->from = request->hasParam("from") ? request->getParam("from")->value().toInt() : 0;
+    cursor->to = request->hasParam("to") ? request->getParam("to")->value().toInt() : UINT32_MAX;
+    cursor->remaining = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : cursor->ring.capacity();
+    cursor->band = -1;
+    if (request->hasParam("band"))
     {
-        Serial.println("⚠️ Power value not found! Setting default to 250 mW 🆕");
-        power_mW = 250;
-        preferences.putUInt("power", power_mW);
+        const String &band = request->getParam("band")->value();
+        cursor->band = band.toInt();
+        for (byte i = 0; i < numWSPRbands; i++)
+        {
+            if (band.equalsIgnoreCase(WSPRbandNames[i]))
+                cursor->band = i;
+        }
     }
-    else
+    cursor->out.open = "[";
+    cursor->out.close = "]";
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+                                                                     [cursor](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                     {
+        TxHistoryCursor &c = *cursor;
+        return fillJsonArray(c.out, buffer, maxLen, [&c](char *buf, size_t size, bool first) -> size_t
+                             {
+            TxHistoryRecord record;
+            if (nextTxHistory(c, record))
+                return formatTxHistory(c.sequence - 1, record, first, buf, size);
+            c.store.close();
+            return 0; }); });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+void startSpotFetcher()
+{
+    spotLock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(spotFetchTask, "SpotFetch", 8192, NULL, 1, NULL, 0);
+}
+
+uint32_t fnv1a(const void *data, size_t len, uint32_t hash)
+{
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ ((const uint8_t *)data)[i]) * 16777619u;
+    return hash;
+}
+
+// One report per receiver, slot and band
+uint32_t spotRowKey(const SpotCacheRecord &r)
+{
+    uint32_t key = fnv1a(r.rxSign, strlen(r.rxSign), 2166136261u);
+    key = fnv1a(&r.time, sizeof(r.time), key);
+    key = fnv1a(&r.band, sizeof(r.band), key);
+    return key ? key : 1; // 0 marks a free entry
+}
+
+bool knownSpotKey(uint32_t key)
+{
+    for (uint32_t known : spotRecentKeys)
     {
-        Serial.println("✅ Power retrieved successfully.");
+        if (known == key)
+            return true;
     }
-    dbm = round(10 * log10(power_mW));
-    Serial.printf("📢 Power: %d mW → %d dBm\n", power_mW, dbm);
+    return false;
+}
 
-    // ⏲️ Retrieve Schedule State
-    String scheduleState = preferences.getString("scheduleState");
-    if (scheduleState.isEmpty())
+void rememberSpotKey(uint32_t key)
+{
+    spotRecentKeys[spotRecentPos] = key;
+    spotRecentPos = (spotRecentPos + 1) % SPOT_RECENT_KEYS;
+}
+
+RecordRing spotCacheRing(RecordStore &store)
+{
+    return RecordRing(store, SPOT_CACHE_MAGIC, sizeof(SpotCacheRecord), SPOT_CACHE_SEGMENT_RECORDS, SPOT_CACHE_SEGMENTS);
+}
+
+// 🔁 Rebuilds the aggregates, duplicate keys and last-seen time of callsign from the cache
+void loadSpotCache(RecordRing &ring, const char *callsign)
+{
+    uint32_t lastSeen = 0;
+    uint32_t rows = 0;
+    SpotCacheRecord record;
+    for (uint32_t seq = ring.oldest(); seq < ring.next(); seq++)
     {
-        Serial.println("⚠️ Schedule state not found! Setting default to 2 minutes 🆕");
-        scheduleState = "schedule1";
-        preferences.putString("scheduleState", scheduleState);
+        if (ring.read(seq, &record) && !strcmp(record.txSign, callsign))
+            lastSeen = max(lastSeen, record.time);
     }
-    else
+
+    xSemaphoreTake(spotLock, portMAX_DELAY);
+    memset(spotBands, 0, sizeof(spotBands));
+    spotLastSeen = lastSeen;
+    xSemaphoreGive(spotLock);
+    memset(spotRecentKeys, 0, sizeof(spotRecentKeys));
+
+    for (uint32_t seq = ring.oldest(); seq < ring.next(); seq++)
+    {
+        if (!ring.read(seq, &record) || strcmp(record.txSign, callsign) != 0)
+            continue;
+        foldSpot(record);
+        if (record.time + SPOT_OVERLAP_S > lastSeen)
+            rememberSpotKey(spotRowKey(record));
+        rows++;
+    }
+    Serial.printf("📡 Spot cache: %u reports for %s in " SPOT_CACHE_DIR "\n", rows, callsign);
+}
+
+void spotFetchTask(void *parameter)
+{
+    xEventGroupWaitBits(bootEvents, BOOT_FS | BOOT_SETTINGS, pdFALSE, pdTRUE, portMAX_DELAY);
+    // The single-file ring of earlier firmware rewrote its slots in place
+    if (FILESYSTEM.exists("/spots.bin"))
+        FILESYSTEM.remove("/spots.bin");
+    if (!FILESYSTEM.exists(SPOT_CACHE_DIR) && !FILESYSTEM.mkdir(SPOT_CACHE_DIR))
     {
-        Serial.println("✅ Schedule state retrieved successfully.");
+        Serial.println("⚠️ Spot cache unavailable: cannot create " SPOT_CACHE_DIR);
+        vTaskDelete(NULL);
+        return;
     }
+    FsRecordStore store(SPOT_CACHE_DIR);
+    RecordRing ring = spotCacheRing(store);
+    spotCacheNext.store(ring.begin(), std::memory_order_release);
 
-    if (scheduleState == "schedule1")
-        intervalBetweenTx = 2 * 60;
-    else if (scheduleState == "schedule2")
-        intervalBetweenTx = 4 * 60;
-    else if (scheduleState == "schedule3")
-        intervalBetweenTx = 6 * 60;
-    else if (scheduleState == "schedule4")
-        intervalBetweenTx = 8 * 60;
-    else if (scheduleState == "schedule5")
-        intervalBetweenTx = 10 * 60;
-    else
-        intervalBetweenTx = 2 * 60;
+    char callsign[sizeof(call)] = "";
+    uint32_t lastOccupancy = 0;
+    while (true)
+    {
+        Settings snapshot = settingsSnapshot();
+        if (strcmp(snapshot.callsign, callsign) != 0)
+        {
+            strlcpy(callsign, snapshot.callsign, sizeof(callsign));
+            loadSpotCache(ring, callsign);
+        }
 
-    Serial.printf("📢 Transmission Interval: %d seconds (%d minutes)\n",
-                  intervalBetweenTx, intervalBetweenTx / 60);
+        if (callsign[0] && WiFi.status() == WL_CONNECTED && timeSource != TIME_SOURCE_NONE)
+        {
+            uint32_t now = time(nullptr);
+            uint32_t since = now - SPOT_WINDOW_HOURS * 3600;
+            if (spotLastSeen > since + SPOT_OVERLAP_S)
+                since = spotLastSeen - SPOT_OVERLAP_S;
+            while (true)
+            {
+                uint32_t rows = 0;
+                uint32_t added = 0;
+                uint32_t lastEpoch = since;
+                int status = fetchSpots(ring, callsign, since, rows, added, lastEpoch);
+                xSemaphoreTake(spotLock, portMAX_DELAY);
+                spotLastStatus = status;
+                spotLastFetch = now;
+                spotRowsAdded += added;
+                xSemaphoreGive(spotLock);
+                if (status != HTTP_CODE_OK)
+                {
+                    Serial.printf("⚠️ Spot fetch failed (%d) after %u rows\n", status, rows);
+                    break;
+                }
+                // A full answer may have more rows behind it: ask again from its last slot, which
+                // the duplicate keys make safe to receive twice
+                if (rows < SPOT_MAX_ROWS || lastEpoch - 1 <= since)
+                    break;
+                since = lastEpoch - 1;
+            }
 
-    // 📻 Retrieve Selected WSPR Bands
-    String storedBands = preferences.getString("enabledBands", "");
+            if (now - lastOccupancy >= SPOT_OCCUPANCY_INTERVAL_S)
+            {
+                int status = fetchOccupancy(callsign);
+                if (status == HTTP_CODE_OK)
+                    lastOccupancy = now;
+                else
+                    Serial.printf("⚠️ Band occupancy fetch failed (%d)\n", status);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(SPOT_FETCH_INTERVAL_S * 1000UL));
+    }
+}
 
-    if (storedBands.isEmpty())
+// 📥 Block source for SpotStreamReader: waits up to SPOT_READ_TIMEOUT_MS for the next bytes
+int readSpotClient(void *context, uint8_t *buf, size_t size)
+{
+    WiFiClient &client = *(WiFiClient *)context;
+    unsigned long start = millis();
+    int avail;
+    while ((avail = client.available()) <= 0)
     {
-        Serial.println("⚠️ Enabled bands not found! Defaulting to 20m (index 3) 🆕");
-        storedBands = "3"; // Default to 20m only
-        preferences.putString("enabledBands", storedBands);
+        if (!client.connected() || millis() - start > SPOT_READ_TIMEOUT_MS)
+            return 0;
+        delay(1);
     }
-    else
+    return client.read(buf, min<size_t>(avail, size));
+}
+
+void appendUrlEncoded(String &out, const char *text)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (const char *c = text; *c; c++)
+    {
+        if (isalnum((unsigned char)*c) || *c == '-' || *c == '_' || *c == '.')
+        {
+            out += *c;
+        }
+        else
+        {
+            out += '%';
+            out += hex[(uint8_t)*c >> 4];
+            out += hex[*c & 0x0F];
+        }
+    }
+}
+
+// Sends query and returns the HTTP status; on HTTP_CODE_OK the body is left to read from http
+int beginSpotQuery(HTTPClient &http, const char *query)
+{
+    String url = SPOT_SOURCE_URL "?query=";
+    appendUrlEncoded(url, query);
+    http.useHTTP10(true); // No chunked transfer encoding: the body is the JSON stream itself
+    http.setTimeout(SPOT_READ_TIMEOUT_MS);
+    if (!http.begin(url))
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    int status = http.GET();
+    if (status != HTTP_CODE_OK)
+        http.end();
+    return status;
+}
+
+// Appends the reports newer than since and returns the HTTP status. The response is JSONEachRow: one
+// object per line, each parsed into a small document that is discarded once stored.
+int fetchSpots(RecordRing &ring, const char *callsign, uint32_t since, uint32_t &rows, uint32_t &added, uint32_t &lastEpoch)
+{
+    char query[320];
+    snprintf(query, sizeof(query),
+             "SELECT toUnixTimestamp(time) AS t, band, toUInt32(frequency) AS frequency, rx_sign, rx_loc, "
+             "rx_lat, rx_lon, tx_lat, tx_lon, distance, snr, version FROM wspr.rx "
+             "WHERE tx_sign = '%s' AND time > toDateTime(%u) "
+             "ORDER BY time LIMIT %u FORMAT JSONEachRow",
+             callsign, since, SPOT_MAX_ROWS);
+    HTTPClient http;
+    int status = beginSpotQuery(http, query);
+    if (status != HTTP_CODE_OK)
+        return status;
+
+    // 🧹 Whatever else the source sends (a recorded SELECT *, say) is skipped by the parser
+    JsonDocument filter;
+    for (const char *field : {"t", "band", "frequency", "rx_sign", "rx_loc", "rx_lat", "rx_lon", "tx_lat", "tx_lon",
+                              "distance", "snr", "version"})
+        filter[field] = true;
+
+    SpotStreamReader reader(readSpotClient, http.getStreamPtr());
+    JsonDocument document; // One row at a time
+    SpotCacheRecord record;
+    DeserializationError error = readJsonRows(reader, filter, document, [&](JsonObjectConst row)
+                                              {
+        rows++;
+        memset(&record, 0, sizeof(record));
+        record.time = row["t"] | 0u;
+        record.frequencyHz = row["frequency"] | 0u;
+        record.rxLat = row["rx_lat"] | 0.0f;
+        record.rxLon = row["rx_lon"] | 0.0f;
+        record.txLat = row["tx_lat"] | 0.0f;
+        record.txLon = row["tx_lon"] | 0.0f;
+        record.distanceKm = min<uint32_t>(row["distance"] | 0u, UINT16_MAX);
+        record.band = row["band"] | 0;
+        record.snr = row["snr"] | 0;
+        copySpotText(record.rxSign, row["rx_sign"], sizeof(record.rxSign));
+        copySpotText(record.rxLoc, row["rx_loc"], sizeof(record.rxLoc));
+        copySpotText(record.version, row["version"], sizeof(record.version));
+        strlcpy(record.txSign, callsign, sizeof(record.txSign));
+        lastEpoch = max(lastEpoch, record.time);
+
+        uint32_t key = spotRowKey(record);
+        if (knownSpotKey(key))
+            return true;
+
+        if (!ring.append(&record))
+        {
+            Serial.println("⚠️ Spot cache write failed");
+            return false;
+        }
+        added++;
+        rememberSpotKey(key);
+        foldSpot(record);
+        return true; });
+    http.end();
+    ring.flush();
+    spotCacheNext.store(ring.next(), std::memory_order_release); // Also past the slots a failed write gave up
+    if (added)
+    {
+        xSemaphoreTake(spotLock, portMAX_DELAY);
+        spotLastSeen = max(spotLastSeen, lastEpoch);
+        xSemaphoreGive(spotLock);
+    }
+    if (error != DeserializationError::EmptyInput)
+    {
+        Serial.printf("⚠️ Spot stream stopped after %u rows: %s\n", rows, error.c_str());
+        return SPOT_ERROR_PARSE;
+    }
+    return status;
+}
+
+// 🎯 Rebuilds the band planners from what the receivers that heard us lately also heard: reports of
+// other stations per band, Hz offset and 10-minute bucket, aggregated by the server
+int fetchOccupancy(const char *callsign)
+{
+    char bands[48] = "";
+    for (byte i = 0; i < numWSPRbands; i++)
+        snprintf(bands + strlen(bands), sizeof(bands) - strlen(bands), "%s%lu", i ? "," : "", WSPRbandStart[i] / 1000000UL);
+    uint32_t now = time(nullptr);
+    uint32_t since = now - SPOT_OCCUPANCY_WINDOW_S;
+    char query[512];
+    snprintf(query, sizeof(query),
+             "SELECT band, toUInt32(frequency %% 1000) AS hz, toUInt32(count()) AS n, toUnixTimestamp(max(time)) AS t "
+             "FROM wspr.rx "
+             "WHERE time > toDateTime(%u) AND band IN (%s) AND tx_sign != '%s' AND rx_sign IN "
+             "(SELECT DISTINCT rx_sign FROM wspr.rx WHERE tx_sign = '%s' AND time > toDateTime(%u)) "
+             "GROUP BY band, hz, intDiv(toUnixTimestamp(time), 600) LIMIT %u FORMAT JSONEachRow",
+             since, bands, callsign, callsign, since, SPOT_OCCUPANCY_MAX_ROWS);
+    HTTPClient http;
+    int status = beginSpotQuery(http, query);
+    if (status != HTTP_CODE_OK)
+        return status;
+
+    JsonDocument filter;
+    for (const char *field : {"band", "hz", "n", "t"})
+        filter[field] = true;
+
+    std::unique_ptr<FrequencyPlanner[]> planners(new FrequencyPlanner[numWSPRbands]);
+    SpotStreamReader reader(readSpotClient, http.getStreamPtr());
+    JsonDocument document;
+    uint32_t rows = 0;
+    DeserializationError error = readJsonRows(reader, filter, document, [&](JsonObjectConst row)
+                                              {
+        rows++;
+        int bandMHz = row["band"] | -1;
+        uint32_t t = row["t"] | now;
+        for (byte i = 0; i < numWSPRbands; i++)
+        {
+            // The server sends the frequency modulo 1 kHz; the sub-bands are under 1 kHz wide
+            if (WSPRbandStart[i] / 1000000UL == (unsigned long)bandMHz)
+                planners[i].add((int)(row["hz"] | 0) - (int)(WSPRbandStart[i] % 1000UL), row["n"] | 0u, now > t ? now - t : 0);
+        }
+        return true; });
+    http.end();
+    if (error != DeserializationError::EmptyInput)
+        return SPOT_ERROR_PARSE;
+
+    for (byte i = 0; i < numWSPRbands; i++)
+    {
+        portENTER_CRITICAL(&plannerMux);
+        bandPlanners[i] = planners[i];
+        portEXIT_CRITICAL(&plannerMux);
+    }
+    Serial.printf("🎯 Band occupancy: %u buckets of other stations heard by our receivers\n", rows);
+    return status;
+}
+
+void foldSpot(const SpotCacheRecord &record)
+{
+    byte band = 0;
+    while (band < numWSPRbands && WSPRbandStart[band] / 1000000UL != (unsigned long)record.band)
+        band++;
+    if (band == numWSPRbands)
+        return;
+
+    uint32_t hour = record.time / 3600;
+    uint32_t reporterHash = fnv1a(record.rxSign, strlen(record.rxSign), 2166136261u);
+    if (reporterHash == 0)
+        reporterHash = 1;
+    SpotBandStats &b = spotBands[band];
+    xSemaphoreTake(spotLock, portMAX_DELAY);
+
+    SpotHour &h = b.hours[hour % SPOT_WINDOW_HOURS];
+    if (h.hour > hour)
+    {
+        xSemaphoreGive(spotLock); // Older than the window
+        return;
+    }
+    if (h.hour != hour)
+    {
+        memset(&h, 0, sizeof(h));
+        h.hour = hour;
+    }
+    h.spots++;
+    h.maxDistanceKm = max(h.maxDistanceKm, record.distanceKm);
+    byte bucket = 0;
+    while (bucket < SPOT_SNR_BUCKETS - 1 && record.snr > spotSnrBoundsDb[bucket])
+        bucket++;
+    h.snr[bucket]++;
+
+    // 👂 Reporters: refresh the entry, else take a free one or the one heard longest ago
+    SpotReporter *slot = &b.reporters[0];
+    for (byte i = 0; i < SPOT_MAX_REPORTERS; i++)
+    {
+        SpotReporter &r = b.reporters[i];
+        if (r.hash == reporterHash)
+        {
+            slot = &r;
+            break;
+        }
+        if (r.lastHour < slot->lastHour)
+            slot = &r;
+    }
+    slot->hash = reporterHash;
+    slot->lastHour = max(slot->lastHour, hour);
+    xSemaphoreGive(spotLock);
+}
+
+// 📡 GET /api/spots: the cached reports of the last 24 hours, newest first, in the shape of a wspr.live
+// FORMAT JSON answer ({"data":[...]}). The ETag changes with every stored report and every hour, so
+// polling dashboards mostly get a 304.
+struct SpotCacheCursor
+{
+    FsRecordStore store;
+    RecordRing ring;
+    uint32_t sequence; // Next record to read is sequence - 1
+    uint32_t end;
+    uint32_t from;
+    uint32_t remaining;
+    char callsign[sizeof(call)];
+    JsonArrayStream out;
+
+    SpotCacheCursor() : store(SPOT_CACHE_DIR), ring(spotCacheRing(store)), out() {}
+};
+
+size_t formatSpot(const SpotCacheRecord &r, bool first, char *buf, size_t size)
+{
+    char stamp[20];
+    time_t t = r.time;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    int n = snprintf(buf, size,
+                     "%s{\"time\":\"%s\",\"band\":%d,\"frequency\":%u,\"rx_sign\":\"%s\",\"rx_loc\":\"%s\","
+                     "\"rx_lat\":%.3f,\"rx_lon\":%.3f,\"tx_sign\":\"%s\",\"tx_lat\":%.3f,\"tx_lon\":%.3f,"
+                     "\"distance\":%u,\"snr\":%d,\"version\":\"%s\"}",
+                     first ? "" : ",", stamp, r.band, r.frequencyHz, r.rxSign, r.rxLoc, r.rxLat, r.rxLon,
+                     r.txSign, r.txLat, r.txLon, r.distanceKm, r.snr, r.version);
+    return n < 0 ? 0 : min<size_t>(n, size - 1);
+}
+
+void sendSpotCache(AsyncWebServerRequest *request)
+{
+    bool filled = false;
+    if (spotLock != NULL)
+    {
+        xSemaphoreTake(spotLock, portMAX_DELAY);
+        filled = spotLastSeen != 0 || spotLastStatus == HTTP_CODE_OK;
+        xSemaphoreGive(spotLock);
+    }
+    if (!filled)
+    {
+        request->send(503, "text/plain", "Spot cache not filled yet"); // The page then asks wspr.live itself
+        return;
+    }
+
+    Settings snapshot = settingsSnapshot();
+    uint32_t next = spotCacheNext.load(std::memory_order_acquire);
+    uint32_t now = time(nullptr);
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%08x-%u-%u\"", fnv1a(snapshot.callsign, strlen(snapshot.callsign), 2166136261u),
+             next, now / 3600);
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match").equals(etag))
+    {
+        AsyncWebServerResponse *response = request->beginResponse(304);
+        response->addHeader("ETag", etag);
+        request->send(response);
+        return;
+    }
+
+    std::shared_ptr<SpotCacheCursor> cursor(new SpotCacheCursor());
+    cursor->sequence = next;
+    cursor->end = cursor->ring.oldest(next);
+    cursor->from = now - SPOT_WINDOW_HOURS * 3600;
+    cursor->remaining = SPOT_MAX_ROWS;
+    strlcpy(cursor->callsign, snapshot.callsign, sizeof(cursor->callsign));
+    cursor->out.open = "{\"data\":[";
+    cursor->out.close = "]}";
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+                                                                     [cursor](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+                                                                     {
+        SpotCacheCursor &c = *cursor;
+        return fillJsonArray(c.out, buffer, maxLen, [&c](char *buf, size_t size, bool first) -> size_t
+                             {
+            SpotCacheRecord record;
+            while (c.remaining && c.sequence > c.end)
+            {
+                if (c.ring.read(--c.sequence, &record) && record.time >= c.from &&
+                    !strcmp(record.txSign, c.callsign))
+                {
+                    c.remaining--;
+                    return formatSpot(record, first, buf, size);
+                }
+            }
+            c.store.close();
+            return 0; }); });
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
+
+// 📡 GET /api/spots/summary: per-band spot count, unique reporters, best distance and SNR histogram
+void sendSpotSummary(AsyncWebServerRequest *request)
+{
+    struct
+    {
+        uint32_t spots;
+        uint32_t reporters;
+        uint32_t maxDistanceKm;
+        uint32_t snr[SPOT_SNR_BUCKETS];
+    } bands[numWSPRbands];
+    memset(bands, 0, sizeof(bands));
+    if (spotLock == NULL)
+    {
+        request->send(503, "text/plain", "Spot analytics not started");
+        return;
+    }
+
+    uint32_t nowHour = time(nullptr) / 3600;
+    uint32_t oldest = nowHour >= SPOT_WINDOW_HOURS ? nowHour - SPOT_WINDOW_HOURS + 1 : 0;
+    uint32_t lastSeen, lastFetch, rowsAdded;
+    int lastStatus;
+    xSemaphoreTake(spotLock, portMAX_DELAY);
+    for (byte i = 0; i < numWSPRbands; i++)
+    {
+        for (const SpotHour &h : spotBands[i].hours)
+        {
+            if (h.hour < oldest || h.hour > nowHour)
+                continue;
+            bands[i].spots += h.spots;
+            bands[i].maxDistanceKm = max<uint32_t>(bands[i].maxDistanceKm, h.maxDistanceKm);
+            for (byte k = 0; k < SPOT_SNR_BUCKETS; k++)
+                bands[i].snr[k] += h.snr[k];
+        }
+        for (const SpotReporter &r : spotBands[i].reporters)
+        {
+            if (r.hash && r.lastHour >= oldest)
+                bands[i].reporters++;
+        }
+    }
+    lastSeen = spotLastSeen;
+    lastFetch = spotLastFetch;
+    rowsAdded = spotRowsAdded;
+    lastStatus = spotLastStatus;
+    xSemaphoreGive(spotLock);
+
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    doc["windowHours"] = SPOT_WINDOW_HOURS;
+    doc["lastSeen"] = lastSeen;
+    doc["lastFetch"] = lastFetch;
+    doc["lastStatus"] = lastStatus;
+    doc["rowsAdded"] = rowsAdded;
+    JsonArray bounds = doc["snrBoundsDb"].to<JsonArray>();
+    for (int8_t bound : spotSnrBoundsDb)
+        bounds.add(bound);
+    JsonArray out = doc["bands"].to<JsonArray>();
+    for (byte i = 0; i < numWSPRbands; i++)
+    {
+        JsonObject band = out.add<JsonObject>();
+        band["band"] = WSPRbandNames[i];
+        band["spots"] = bands[i].spots;
+        band["reporters"] = bands[i].reporters;
+        band["maxDistanceKm"] = bands[i].maxDistanceKm;
+        JsonArray snr = band["snr"].to<JsonArray>();
+        for (uint32_t count : bands[i].snr)
+            snr.add(count);
+    }
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+Settings settingsSnapshot()
+{
+    SettingsRef current;
+    return *current;
+}
+
+bool sameSettings(const Settings &a, const Settings &b)
+{
+    return !strcmp(a.callsign, b.callsign) && !strcmp(a.locator, b.locator) &&
+           a.power_mW == b.power_mW && a.intervalMinutes == b.intervalMinutes &&
+           !memcmp(a.bandEnabled, b.bandEnabled, sizeof(a.bandEnabled)) &&
+           a.calFactor == b.calFactor && a.lowPowerIdle == b.lowPowerIdle &&
+           !memcmp(&a.schedule, &b.schedule, sizeof(a.schedule));
+}
+
+void defaultSchedule(ScheduleSettings &schedule)
+{
+    schedule.mode = SP_MODE_INTERVAL;
+    schedule.txPercent = 20;
+    schedule.bandHop = SP_HOP_ROTATE;
+    for (int i = 0; i < numWSPRbands; i++)
     {
-        Serial.println("✅ Enabled bands retrieved from Preferences.");
+        schedule.bandWindow[i][0] = 0; // All day
+        schedule.bandWindow[i][1] = 24;
     }
-    Serial.printf("📻 Enabled bands string: \"%s\"\n", storedBands.c_str());
+    memset(schedule.manualPlan, SP_IDLE, sizeof(schedule.manualPlan));
+}
 
-    // Parse comma-separated band indices
+bool isValidSchedule(const ScheduleSettings &schedule)
+{
+    if (schedule.mode > SP_MODE_MANUAL || schedule.bandHop > SP_HOP_COORDINATED ||
+        schedule.txPercent < 1 || schedule.txPercent > 100)
+        return false;
     for (int i = 0; i < numWSPRbands; i++)
     {
-        wsprBandEnabled[i] = false; // Reset first
+        if (schedule.bandWindow[i][0] > 23 || schedule.bandWindow[i][1] > 24)
+            return false;
+    }
+    for (int s = 0; s < SP_SLOTS; s++)
+    {
+        if (schedule.manualPlan[s] != SP_IDLE && schedule.manualPlan[s] >= numWSPRbands)
+            return false;
     }
+    return true;
+}
 
-    int start = 0;
-    while (start < storedBands.length())
+void defaultSettings(Settings &settings)
+{
+    memset(&settings, 0, sizeof(settings));
+    strlcpy(settings.callsign, "NOCALL", sizeof(settings.callsign));
+    strlcpy(settings.locator, "XX00XX", sizeof(settings.locator));
+    settings.power_mW = 250;
+    settings.intervalMinutes = 2;
+    settings.bandEnabled[3] = true; // 20m
+    settings.calFactor = 0;
+    settings.lowPowerIdle = false;
+    defaultSchedule(settings.schedule);
+}
+
+bool loadSettingsBlob(Settings &settings)
+{
+    nvs_handle_t handle;
+    if (nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return false;
+    uint8_t raw[SETTINGS_BLOB_MAX_SIZE];
+    size_t size = sizeof(raw);
+    esp_err_t err = nvs_get_blob(handle, SETTINGS_BLOB_KEY, raw, &size);
+    nvs_close(handle);
+    if (err != ESP_OK)
+        return false;
+
+    // Header, payload and CRC are all checked before any field is trusted
+    SettingsBlob header;
+    const size_t headerSize = offsetof(SettingsBlob, settings);
+    if (size < headerSize + sizeof(uint32_t))
+        return false;
+    memcpy(&header, raw, headerSize);
+    if (header.magic != SETTINGS_BLOB_MAGIC || headerSize + header.length + sizeof(uint32_t) > size)
+        return false;
+    uint32_t crc;
+    memcpy(&crc, raw + headerSize + header.length, sizeof(crc));
+    if (crc != esp_rom_crc32_le(0, raw, headerSize + header.length))
+        return false;
+
+    if (header.version == SETTINGS_BLOB_VERSION && header.length == sizeof(Settings))
+        memcpy(&settings, raw + headerSize, sizeof(Settings));
+    else if (!migrateSettings(header.version, raw + headerSize, header.length, settings))
+        return false;
+
+    settings.callsign[sizeof(settings.callsign) - 1] = '\0';
+    settings.locator[sizeof(settings.locator) - 1] = '\0';
+    if (settings.intervalMinutes < 2 || settings.intervalMinutes > 10 || settings.intervalMinutes % 2)
+        settings.intervalMinutes = 2;
+    if (settings.power_mW == 0)
+        settings.power_mW = 250;
+    if (!isValidSchedule(settings.schedule))
+        defaultSchedule(settings.schedule);
+    return true;
+}
+
+bool storeSettingsBlob(const Settings &settings)
+{
+    SettingsBlob blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.magic = SETTINGS_BLOB_MAGIC;
+    blob.version = SETTINGS_BLOB_VERSION;
+    blob.length = sizeof(Settings);
+    blob.settings = settings;
+    blob.crc = esp_rom_crc32_le(0, (const uint8_t *)&blob, offsetof(SettingsBlob, crc));
+
+    nvs_handle_t handle;
+    if (nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+        return false;
+    esp_err_t err = nvs_set_blob(handle, SETTINGS_BLOB_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK)
+        err = nvs_commit(handle);
+    nvs_close(handle);
+    return err == ESP_OK;
+}
+
+// 🔀 Migration hook: converts the payload of an older record version into the current Settings.
+// Version 2 appended the slot schedule, so a version 1 payload is the head of the current layout.
+bool migrateSettings(uint16_t version, const uint8_t *payload, uint16_t length, Settings &settings)
+{
+    if (version == 1 && length >= offsetof(Settings, schedule))
+    {
+        defaultSettings(settings);
+        memcpy(&settings, payload, offsetof(Settings, schedule));
+        Serial.println("🔀 Settings v1 migrated, default slot schedule");
+        return true;
+    }
+    Serial.printf("⚠️ No migration from settings v%u (%u bytes), using defaults\n", version, length);
+    return false;
+}
+
+// One-time import of the per-key layout written by firmware before the settings record
+bool importLegacySettings(Settings &settings)
+{
+    Preferences preferences; // One per caller: boot stages use NVS concurrently
+    preferences.begin(SETTINGS_NAMESPACE, false);
+    if (!preferences.isKey("callsign") && !preferences.isKey("enabledBands"))
     {
-        int end = storedBands.indexOf(',', start);
-        if (end == -1)
-            end = storedBands.length();
+        preferences.end();
+        return false;
+    }
 
-        String token = storedBands.substring(start, end);
-        int idx = token.toInt();
+    defaultSettings(settings);
+    String storedCall = preferences.getString("callsign");
+    if (!storedCall.isEmpty())
+        strlcpy(settings.callsign, storedCall.c_str(), sizeof(settings.callsign));
+    String storedLoc = preferences.getString("locator");
+    if (!storedLoc.isEmpty())
+        strlcpy(settings.locator, storedLoc.c_str(), sizeof(settings.locator));
+    settings.power_mW = preferences.getUInt("power", settings.power_mW);
+
+    String scheduleState = preferences.getString("scheduleState");
+    int schedule = scheduleState.startsWith("schedule") ? scheduleState.substring(8).toInt() : 0;
+    if (schedule >= 1 && schedule <= 5)
+        settings.intervalMinutes = schedule * 2;
 
-        if (idx >= 0 && idx < numWSPRbands)
+    String storedBands = preferences.getString("enabledBands");
+    if (!storedBands.isEmpty())
+    {
+        memset(settings.bandEnabled, 0, sizeof(settings.bandEnabled));
+        for (const char *p = storedBands.c_str(); *p; p++)
         {
-            wsprBandEnabled[idx] = true;
+            int idx = atoi(p);
+            if (idx >= 0 && idx < numWSPRbands)
+                settings.bandEnabled[idx] = true;
+            while (p[1] && *p != ',')
+                p++;
         }
+    }
+
+    settings.calFactor = preferences.getInt("cal_factor", settings.calFactor);
+    settings.lowPowerIdle = preferences.getBool("lowPower", settings.lowPowerIdle);
+
+    const char *legacyKeys[] = {"callsign", "locator", "power", "scheduleState", "enabledBands", "cal_factor", "lowPower"};
+    for (const char *key : legacyKeys)
+        preferences.remove(key);
+    preferences.end();
+    return true;
+}
 
-        start = end + 1;
+void retrieveUserSettings()
+{
+    int64_t startUs = esp_timer_get_time();
+    Settings settings;
+    const char *origin = "settings record";
+    if (!loadSettingsBlob(settings))
+    {
+        origin = "legacy keys";
+        if (!importLegacySettings(settings))
+        {
+            origin = "defaults 🆕";
+            defaultSettings(settings);
+        }
+        if (!storeSettingsBlob(settings))
+            Serial.println("⚠️ Could not write the settings record");
     }
+    int64_t loadUs = esp_timer_get_time() - startUs;
 
-    // 🧾 Print enabled bands
+    strlcpy(call, settings.callsign, sizeof(call));
+    strlcpy(loc, settings.locator, sizeof(loc));
+    power_mW = settings.power_mW;
+    dbm = round(10 * log10(power_mW));
+    intervalBetweenTx = settings.intervalMinutes * 60;
+    memcpy(wsprBandEnabled, settings.bandEnabled, sizeof(wsprBandEnabled));
+    cal_factor = settings.calFactor;
+    lowPowerIdle = settings.lowPowerIdle;
+    txSchedule = settings.schedule;
+
+    Serial.printf("📂 User settings loaded from %s in %lld µs\n", origin, loadUs);
+    Serial.printf("📢 Callsign: %s, Locator: %s\n", call, loc);
+    Serial.printf("📢 Power: %d mW → %d dBm\n", power_mW, dbm);
+    Serial.printf("📢 Transmission Interval: %d seconds (%d minutes)\n",
+                  intervalBetweenTx, intervalBetweenTx / 60);
     Serial.println("📡 Bands marked as ENABLED:");
     for (int i = 0; i < numWSPRbands; i++)
     {
         if (wsprBandEnabled[i])
         {
-            Serial.printf("   ✅ %s (%d)\n", WSPRbandNames[i], i);
+            Serial.printf("   ✅ %s (%d), %02u-%02u UTC\n", WSPRbandNames[i], i,
+                          txSchedule.bandWindow[i][0], txSchedule.bandWindow[i][1]);
         }
     }
-
-    // 🔧 Retrieve Calibration Factor
-    cal_factor = preferences.getInt("cal_factor", 9999999);
-    if (cal_factor == 9999999)
-    {
-        Serial.println("⚠️ Calibration factor not found! Setting default to 0 🆕");
-        cal_factor = 0;
-        preferences.putInt("cal_factor", cal_factor);
-    }
-    else
-    {
-        Serial.println("✅ Calibration factor retrieved successfully.");
-    }
+    Serial.printf("🗓️ Slot schedule: %s (%u%% in percent mode), %s band hopping\n",
+                  scheduleModeNames[txSchedule.mode], txSchedule.txPercent, bandHopNames[txSchedule.bandHop]);
     Serial.printf("📏 Calibration Factor: %d\n", cal_factor);
-
-    // ✅ Close preferences
-    preferences.end();
+    Serial.printf("💤 Low-power idle: %s\n", lowPowerIdle ? "enabled" : "disabled");
     Serial.println();
 }
 
 void configure_web_server()
 {
+    startTxPublisher();
     Serial.println("🌍 Starting Web Server Route Configuration...");
 
     server.on("/getModeOfOperation", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    DynamicJsonDocument doc(128);
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
     doc["modeOfOperation"] = modeOfOperation;
 
-    String jsonResponse;
-    serializeJson(doc, jsonResponse);
-    request->send(200, "application/json", jsonResponse); });
+    request->send(response); });
+
+    // Provisioning page replaces the dashboard while in access point mode
+    if (apModeActive)
+    {
+        server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
+                  { request->send(FILESYSTEM, "/ap.html", "text/html"); });
+    }
+    else
+    {
+        // 🖼️ Dashboard with its initial state inlined: first paint needs this one request.
+        // The plain file is streamed through the template processor chunk by chunk.
+        auto sendDashboard = [](AsyncWebServerRequest *request)
+        {
+            AsyncFileResponse *response = new AsyncFileResponse(FILESYSTEM, "/index.html", "text/html", false, indexTemplateProcessor);
+            response->setTemplatePlaceholder('~'); // '%' is all over the page's CSS and JS
+            response->addHeader("Cache-Control", "no-cache");
+            request->send(response);
+        };
+        server.on("/", HTTP_GET, sendDashboard);
+        server.on("/index.html", HTTP_GET, sendDashboard);
+    }
 
-    // Root and static pages
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/index.html", "text/html"); });
+    // 📶 Wi-Fi provisioning (access point page)
+    server.on("/scanNetworks", HTTP_GET, [](AsyncWebServerRequest *request)
+              { request->send(200, "application/json", scannedNetworksJson.isEmpty() ? "{\"networks\":[]}" : scannedNetworksJson); });
 
-    server.on("/index.html", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/index.html", "text/html"); });
+    server.on("/saveSettings", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+    StaticJsonDocument<512> doc;
+    if (index != 0 || len != total || deserializeJson(doc, data, len)) {
+        request->send(400, "text/plain", "Invalid JSON");
+        return;
+    }
 
-    server.on("/calibrate.html", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/calibrate.html", "text/html"); });
+    String newSSID = doc["ssid"] | "";
+    if (newSSID.isEmpty()) {
+        request->send(400, "text/plain", "Missing SSID");
+        return;
+    }
 
-    server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/favicon.ico", "image/x-icon"); });
+    StaticJsonDocument<128> patch;
+    if (doc.containsKey("callsign")) patch["callsign"] = doc["callsign"];
+    if (doc.containsKey("locator")) patch["locator"] = doc["locator"];
+    String error;
+    if (!patchSettings(patch.as<JsonObjectConst>(), error)) {
+        request->send(400, "text/plain", error);
+        return;
+    }
 
-    // Static assets
-    server.on("/assets/spectrum.jpg", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/assets/spectrum.jpg", "image/jpeg"); });
+    Preferences preferences;
+    preferences.begin("wifi", false);
+    preferences.clear(); // Drop the cached lease of the previous network
+    preferences.putString("ssid", newSSID);
+    preferences.putString("password", doc["password"] | "");
+    preferences.end();
 
-    server.on("/assets/wsprlogo.png", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/assets/wsprlogo.png", "image/png"); });
-    server.on("/assets/warning.png", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/assets/warning.png", "image/png"); });
+    stopSettingsWriter(SETTINGS_WRITE_FLUSH); // Now rather than after the debounce: we reboot right away
 
-    server.on("/cesium.key", HTTP_GET, [](AsyncWebServerRequest *request)
-              { request->send(FILESYSTEM, "/cesium.key", "text/plain"); });
+    Serial.printf("💾 Wi-Fi settings saved for %s, rebooting...\n", newSSID.c_str());
+    request->send(200, "text/plain", "Settings saved. Rebooting...");
+    delay(500); // Let browser receive response
+    ESP.restart(); });
 
     // 🔄 HTTP Endpoint: Return list of selected WSPR bands as JSON
 
     server.on("/getSelectedBands", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-                  StaticJsonDocument<128> doc;
-                  JsonArray arr = doc.createNestedArray("selectedBands");
+                  AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+                  JsonDocument &doc = response->document();
+                  fillSelectedBands(doc.createNestedArray("selectedBands"));
 
-                  for (int i = 0; i < numWSPRbands; i++)
-                  {
-                      if (wsprBandEnabled[i])
-                      {
-                          arr.add(i);
-                      }
-                  }
-
-                  String json;
-                  serializeJson(doc, json);
-                  request->send(200, "application/json", json);
-
-                  // Serial.println("📤 Sent selected band indices to client.");
+                  request->send(response);
               });
 
     // 🔄 HTTP Endpoint: Update selected WSPR bands from client
     server.on("/updateSelectedBands", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-    if (request->hasParam("bands", true)) {
-        String bandList = request->getParam("bands", true)->value();  // e.g., "0,2,5"
-        Serial.printf("\n⚠️ User selected or de-selected bands, updating table");
+    if (!request->hasParam("bands", true)) {
+        request->send(400, "text/plain", "Missing bands parameter");
+        return;
+    }
 
-        // Save to preferences
-        preferences.begin("settings", false);
-        preferences.putString("enabledBands", bandList);
-        preferences.end();
+    String bandList = request->getParam("bands", true)->value();  // e.g., "0,2,5"
+    StaticJsonDocument<256> patch;
+    JsonArray bands = patch.createNestedArray("bands");
+    int start = 0;
+    while (start < (int)bandList.length()) {
+        int commaIndex = bandList.indexOf(',', start);
+        if (commaIndex == -1) commaIndex = bandList.length();
+        bands.add(bandList.substring(start, commaIndex).toInt());
+        start = commaIndex + 1;
+    }
+    Serial.printf("\n⚠️ User selected or de-selected bands: %s\n", bandList.c_str());
+    sendLegacyPatch(request, patch, "Bands updated"); });
 
-        // Update wsprBandEnabled[] in memory
-        for (int i = 0; i < numWSPRbands; i++) {
-            wsprBandEnabled[i] = false;  // Clear all
-        }
+    // 🧩 Unified state resource: GET returns everything, PATCH applies a JSON batch atomically
+    server.on("/api/state", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    fillApiState(doc.to<JsonObject>());
+    request->send(response); });
+
+    AsyncCallbackJsonWebHandler *statePatch = new AsyncCallbackJsonWebHandler("/api/state", [](AsyncWebServerRequest *request, JsonVariant &json)
+                                                                            {
+    String error = json.is<JsonObject>() ? String() : String("body must be a JSON object");
+    if (error.isEmpty())
+        patchSettings(json.as<JsonObjectConst>(), error);
+    if (!error.isEmpty()) {
+        AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse(400);
+        JsonDocument &doc = response->document();
+        doc["error"] = error;
+        request->send(response);
+        return;
+    }
 
-        int start = 0;
-        while (start < bandList.length()) {
-            int commaIndex = bandList.indexOf(',', start);
-            if (commaIndex == -1) commaIndex = bandList.length();
-            int bandIndex = bandList.substring(start, commaIndex).toInt();
-            if (bandIndex >= 0 && bandIndex < numWSPRbands) {
-                wsprBandEnabled[bandIndex] = true;
-            }
-            start = commaIndex + 1;
-        }
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    fillApiState(doc.to<JsonObject>());
+    request->send(response); }, 1024);
+    statePatch->setMethod(HTTP_PATCH);
+    statePatch->setMaxContentLength(1024);
+    server.addHandler(statePatch);
 
-        // ---- Print full table in requested format ----
-        Serial.println(F("\n📋 Band Status Table:"));
-        for (int i = 0; i < numWSPRbands; i++) {
-            Serial.printf("   [%d] %-4s — %s %s\n",
-                          i,
-                          WSPRbandNames[i],  // assumes wsprBandName[] exists
-                          wsprBandEnabled[i] ? "✅" : "❌",
-                          wsprBandEnabled[i] ? "ENABLED" : "DISABLED");
-        }
-        Serial.println();
+    // 🗓️ Slot schedule: the rules (also part of /api/state) and the hour plan they produced
+    server.on("/api/schedule", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    fillApiSchedule(doc.to<JsonObject>());
+    request->send(response); });
+
+    AsyncCallbackJsonWebHandler *schedulePatch = new AsyncCallbackJsonWebHandler("/api/schedule", [](AsyncWebServerRequest *request, JsonVariant &json)
+                                                                               {
+    String error = json.is<JsonObject>() ? String() : String("body must be a JSON object");
+    if (error.isEmpty())
+        patchSettings(json.as<JsonObjectConst>(), error);
+    if (!error.isEmpty()) {
+        AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse(400);
+        JsonDocument &doc = response->document();
+        doc["error"] = error;
+        request->send(response);
+        return;
+    }
 
-        request->send(200, "text/plain", "Bands updated");
-    } else {
-        request->send(400, "text/plain", "Missing bands parameter");
-    } });
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    fillApiSchedule(doc.to<JsonObject>());
+    request->send(response); }, 1024);
+    schedulePatch->setMethod(HTTP_PATCH);
+    schedulePatch->setMaxContentLength(1024);
+    server.addHandler(schedulePatch);
 
     // 🔧 Settings and data endpoints
     server.on("/getAllSettings", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    StaticJsonDocument<256> doc;
-    doc["version"] = "Ver. " + String(VERSION);
-    doc["callsign"] = String(call);         // from global char array
-    doc["locator"] = String(loc);           // from global char array
-    doc["power"] = power_mW;                // from global variable
-    doc["TX_referenceFrequ"] = TX_referenceFrequ;
-    doc["WSPR_TX_operatingFrequ"] = WSPR_TX_operatingFrequ;
-
-    // Determine scheduleState from intervalBetweenTx
-    String scheduleState = "schedule1"; // default
-    if (intervalBetweenTx == 2 * 60) scheduleState = "schedule1";
-    else if (intervalBetweenTx == 4 * 60) scheduleState = "schedule2";
-    else if (intervalBetweenTx == 6 * 60) scheduleState = "schedule3";
-    else if (intervalBetweenTx == 8 * 60) scheduleState = "schedule4";
-    else if (intervalBetweenTx == 10 * 60) scheduleState = "schedule5";
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    fillAllSettings(doc.to<JsonObject>());
 
-    doc["scheduleState"] = scheduleState;
-
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    request->send(response); });
 
     server.on("/getLocator", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    preferences.begin("settings", true);
-    String locator = preferences.getString("locator", "");
-    preferences.end();
+    String locator = settingsSnapshot().locator;
 
     Serial.println("📤 Sending Locator...");
-    StaticJsonDocument<64> doc;
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
     doc["locator"] = locator;
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    request->send(response); });
 
     server.on("/getPower", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    preferences.begin("settings", true);
-    uint32_t power = preferences.getUInt("power", 24);
-    preferences.end();
+    uint32_t power = settingsSnapshot().power_mW;
 
     Serial.println("📤 Sending Power Info...");
-    StaticJsonDocument<64> doc;
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
     doc["power"] = power;
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    request->send(response); });
 
     server.on("/getTimes", HTTP_GET, [](AsyncWebServerRequest *request)
               {
     //Serial.printf("📤 Sending WSPR Timing Info to web page (TX = %d s, Next = %d s)\n", tx_ON_running_time_in_s, currentRemainingSeconds);
-    StaticJsonDocument<128> doc;
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
     doc["currentRemainingSeconds"] = currentRemainingSeconds;
     doc["txRunningTime"] = tx_ON_running_time_in_s;
     doc["TX_referenceFrequ"] = TX_referenceFrequ ;
     doc["intervalBetweenTx"] = intervalBetweenTx;
-    String json;
-    serializeJson(doc, json);
-    request->send(200, "application/json", json); });
+    request->send(response); });
 
     // 🔄 Settings update routes
     server.on("/updateCallsign", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    if (request->hasParam("callsign")) {
-        String callsign = request->getParam("callsign")->value();
-        preferences.begin("settings", false);
-        preferences.putString("callsign", callsign);
-        preferences.end();
-        Serial.printf("📡 Callsign set to %s\n", callsign.c_str());
-
-        // Update the global variable
-        callsign.toCharArray(call, sizeof(call));
-    } });
+    StaticJsonDocument<64> patch;
+    if (request->hasParam("callsign")) patch["callsign"] = request->getParam("callsign")->value();
+    sendLegacyPatch(request, patch, "Callsign updated"); });
 
     server.on("/updateLocator", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-  if (request->hasParam("locator")) {
-    String locator = request->getParam("locator")->value();
-
-    // Update the global Maidenhead locator (first 6 chars)
-    strncpy(loc, locator.c_str(), 6);
-    loc[6] = '\0';
-
-    preferences.begin("settings", false);
-    preferences.putString("locator", locator);
-    preferences.end();
-
-    Serial.printf("📍 Locator set to %s\n", loc);
-  }
-  request->send(200, "text/plain", "Locator updated"); });
+    StaticJsonDocument<64> patch;
+    if (request->hasParam("locator")) patch["locator"] = request->getParam("locator")->value();
+    sendLegacyPatch(request, patch, "Locator updated"); });
 
     server.on("/updatePower", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    if (request->hasParam("power")) {
-      String power = request->getParam("power")->value();
-      preferences.begin("settings", false);
-      preferences.putUInt("power", power.toInt());
-      preferences.end();
-      Serial.printf("⚡ Power set to %s mW\n", power.c_str());
-         // Update global power_mW
-    power_mW = power.toInt();
-        dbm = round(10 * log10(power_mW));
-    }
-    request->send(200, "text/plain", "Power updated"); });
+    StaticJsonDocument<64> patch;
+    if (request->hasParam("power")) patch["power"] = request->getParam("power")->value().toInt();
+    sendLegacyPatch(request, patch, "Power updated"); });
     server.on("/updateScheduleState", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-  if (request->hasParam("id")) {
-    String scheduleState = request->getParam("id")->value();
-
-    // Print old interval before updating
-    Serial.println("\n\n⚠️ User selected new TX interval");
-    Serial.printf("ℹ️ Previous TX interval: %d minutes\n", intervalBetweenTx / 60);
-        // Update based on selected schedule
-    if (scheduleState == "schedule1") intervalBetweenTx = 2 * 60;
-    else if (scheduleState == "schedule2") intervalBetweenTx = 4 * 60;
-    else if (scheduleState == "schedule3") intervalBetweenTx = 6 * 60;
-    else if (scheduleState == "schedule4") intervalBetweenTx = 8 * 60;
-    else if (scheduleState == "schedule5") intervalBetweenTx = 10 * 60;
-    else intervalBetweenTx = 2 * 60;   
-    
-    Serial.printf("ℹ️ New TX interval:      %d minutes\n",  intervalBetweenTx / 60);
-
-    
-    interruptWSPRcurrentTX = true;
-          isFirstIteration = true;
-   
-    preferences.begin("settings", false);
-    preferences.putString("scheduleState", scheduleState);
-    preferences.end();
-
-
-
-
-  
-         
-     
-
-  } else {
-    Serial.println("⚠️ No schedule ID received!");
-  }
-
-  request->send(200, "text/plain", "OK"); });
+    StaticJsonDocument<64> patch;
+    if (request->hasParam("id")) {
+        String scheduleState = request->getParam("id")->value(); // "schedule1".."schedule5", "schedule6": TX percentage
+        int schedule = scheduleState.substring(8).toInt();
+        if (schedule == 6) {
+            patch["scheduleMode"] = "percent";
+            if (request->hasParam("percent")) patch["txPercent"] = request->getParam("percent")->value().toInt();
+        } else {
+            patch["scheduleMode"] = "interval";
+            patch["intervalMinutes"] = schedule * 2;
+        }
+        Serial.println("\n\n⚠️ User selected new TX interval");
+    }
+    sendLegacyPatch(request, patch, "OK"); });
 
     // 🛠️ Control and calibration
     server.on("/startCalibtation", HTTP_GET, [](AsyncWebServerRequest *request)
@@ -1019,27 +3827,135 @@ Serial.println("\n\n⚠️ Transmission Stopped to enter Calibration Mode");
 
     server.on("/updateCalFactor", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-    if (request->hasParam("calFactor")) {
-      cal_factor = request->getParam("calFactor")->value().toInt();
-      si5351.set_correction(cal_factor, SI5351_PLL_INPUT_XO);
-      Serial.printf("📏 Calibration factor set to %d\n", cal_factor);
+    if (request->hasParam("calFactor") && !requestCalFactor(request->getParam("calFactor")->value().toInt())) {
+      request->send(409, "text/plain", "Not in calibration mode");
+      return;
     }
     request->send(200, "text/plain", "Calibration factor updated"); });
 
     server.on("/saveCalFactor", HTTP_GET, [](AsyncWebServerRequest *request)
               {
- 
-
+    StaticJsonDocument<64> patch;
     if (request->hasParam("calFactor")) {
-      cal_factor = request->getParam("calFactor")->value().toInt();
-      preferences.begin("settings", false);
-      preferences.putInt("cal_factor", cal_factor);
-      preferences.end();
-      Serial.printf("\n📏 Calibration factor saved: %d\n", cal_factor);
-      Serial.println("✅ Exiting Calibration Mode, Rebooting");
- 
+      patch["calFactor"] = request->getParam("calFactor")->value().toInt();
+      isFirstIteration = true; // loop() reschedules (and clears the interruption) once it leaves calibration
+      performCalibration = false;
+      calibrationStarted = false;
+      Serial.printf("\n📏 Calibration factor saved: %s\n", request->getParam("calFactor")->value().c_str());
+      Serial.println("✅ Exiting Calibration Mode");
+    }
+    sendLegacyPatch(request, patch, "Calibration factor saved"); });
+
+    server.on("/updateLowPower", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    StaticJsonDocument<64> patch;
+    if (request->hasParam("enabled")) patch["lowPowerIdle"] = request->getParam("enabled")->value().toInt() != 0;
+    sendLegacyPatch(request, patch, "Low-power idle updated"); });
+
+    server.on("/getPowerStats", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    doc["lowPowerIdle"] = lowPowerIdle;
+    doc["autoLightSleep"] = autoLightSleep;
+    doc["averageCurrent_mA"] = averageCurrent_mA();
+    doc["lastHourAverage_mA"] = lastHourAverage_mA;
+    doc["activeMs"] = powerStateMs[POWER_STATE_ACTIVE];
+    doc["idleMs"] = powerStateMs[POWER_STATE_IDLE];
+    doc["txMs"] = powerStateMs[POWER_STATE_TX];
+    request->send(response); });
+
+    // 🧮 Heap fragmentation and request-arena usage, to compare firmware builds
+    server.on("/getHeapStats", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    size_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    doc["freeHeap"] = freeHeap;
+    doc["minFreeHeap"] = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    doc["largestFreeBlock"] = largestBlock;
+    doc["fragmentationPct"] = freeHeap ? 100 - (largestBlock * 100) / freeHeap : 0;
+    const AsyncWebArenaStats &arena = AsyncWebArena::stats();
+    doc["requestArenas"] = arena.arenas;
+    doc["arenaChunks"] = arena.chunks;
+    doc["arenaFailed"] = arena.failed;
+    doc["arenaLiveBytes"] = arena.liveBytes;
+    doc["arenaPeakBytes"] = arena.peakBytes;
+    request->send(response); });
+
+    // 📈 Everything above plus task, I2C, TX timing and per-route latency in Prometheus text format
+    server.on("/metrics", HTTP_GET, sendMetrics);
+
+    // 📜 Transmission history, filtered by time range and band
+    server.on("/api/history", HTTP_GET, sendTxHistory);
+
+    // 📡 Per-band spot analytics for the last 24 hours; registered first, /api/spots matches its subpaths
+    server.on("/api/spots/summary", HTTP_GET, sendSpotSummary);
+
+    // 📡 Cached wspr.live reports for the dashboards
+    server.on("/api/spots", HTTP_GET, sendSpotCache);
+
+    // 🔌 AsyncTCP event queue: depth, pool use and backpressure counters
+    server.on("/getTcpStats", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    async_tcp_stats_t stats;
+    async_tcp_get_stats(&stats);
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    doc["queueDepth"] = stats.queueDepth;
+    doc["queueHighWater"] = stats.queueHighWater;
+    doc["poolFree"] = stats.poolFree;
+    doc["poolMisses"] = stats.poolMisses;
+    doc["pollsCoalesced"] = stats.pollsCoalesced;
+    doc["pollsDropped"] = stats.pollsDropped;
+    doc["recvDeferred"] = stats.recvDeferred;
+    doc["stalls"] = stats.stalls;
+    doc["dropped"] = stats.dropped;
+    request->send(response); });
+
+    // 📣 Push channel: a new client gets the full state, then deltas
+    events.onConnect([](AsyncEventSourceClient *client)
+                     {
+    StaticJsonDocument<384> doc;
+    doc["currentRemainingSeconds"] = currentRemainingSeconds;
+    doc["txRunningTime"] = tx_ON_running_time_in_s;
+    doc["TX_referenceFrequ"] = TX_referenceFrequ;
+    doc["WSPR_TX_operatingFrequ"] = WSPR_TX_operatingFrequ;
+    doc["modeOfOperation"] = modeOfOperation;
+    doc["selectedBandIndex"] = selectedBandIndex;
+    {
+        SettingsRef current;
+        doc["intervalBetweenTx"] = current->intervalMinutes * 60;
+        doc["power"] = current->power_mW;
+        doc["callsign"] = current->callsign;
+        doc["locator"] = current->locator;
+    }
+    char json[384];
+    serializeJson(doc, json, sizeof(json));
+    client->send(json, "state", millis(), 5000); });
+    server.addHandler(&events);
+
+    for (AsyncWebSocketMessageBuffer *&buffer : symbolBuffers)
+        buffer = new AsyncWebSocketMessageBuffer(sizeof(WsSymbolMessage)); // Not registered with makeBuffer(): never cleaned up
+    telemetry.onEvent(onTelemetryEvent);
+    server.addHandler(&telemetry);
+
+    server.on("/getBootTimings", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+    AsyncJsonStreamResponse *response = new AsyncJsonStreamResponse();
+    JsonDocument &doc = response->document();
+    doc["warmBoot"] = warmBoot;
+    doc["readyToTxMs"] = bootReadyToTxMs;
+    JsonArray stages = doc.createNestedArray("stages");
+    for (byte i = 0; i < numBootStages; i++) {
+        JsonObject stage = stages.createNestedObject();
+        stage["name"] = bootStages[i].name;
+        stage["startMs"] = bootStages[i].startMs;
+        stage["endMs"] = bootStages[i].endMs;
+        stage["failed"] = bootStages[i].failed;
     }
-    request->send(200, "text/plain", "Calibration factor saved"); });
+    request->send(response); });
 
     server.on("/getCalFactor", HTTP_GET, [](AsyncWebServerRequest *request)
               { request->send(200, "text/plain", String(cal_factor)); });
@@ -1049,6 +3965,7 @@ Serial.println("\n\n⚠️ Transmission Stopped to enter Calibration Mode");
               {
     Serial.println("🔄 Reboot requested...");
     request->send(200, "text/plain", "Rebooting...");
+    stopSettingsWriter(SETTINGS_WRITE_FLUSH); // An edit still in its debounce would be lost
     delay(1000);
     ESP.restart(); });
 
@@ -1056,12 +3973,34 @@ Serial.println("\n\n⚠️ Transmission Stopped to enter Calibration Mode");
               {
     Serial.println("⚠️ Factory Reset Requested...");
     request->send(200, "text/plain", "Factory reset...");
+    stopSettingsWriter(SETTINGS_WRITE_DISCARD); // A pending write would bring the old settings back
     delay(1000);
-    preferences.begin("settings", false);
+    Preferences preferences;
+    preferences.begin(SETTINGS_NAMESPACE, false);
+    preferences.clear();
+    preferences.end();
+    preferences.begin("wifi", false);
     preferences.clear();
     preferences.end();
     ESP.restart(); });
 
+    // 🗂️ Static files last, so API routes match first: pre-gzipped, strong ETag, 304 on If-None-Match.
+    // HTML is always revalidated; assets referenced with ?v=<hash> are cached for a year.
+    // The flash-mapped bundle answers first; LittleFS covers anything it lacks.
+    if (webBundle.mounted())
+    {
+        AsyncWebBundleHandler *bundleHandler = new AsyncWebBundleHandler(webBundle, FILESYSTEM, "no-cache");
+        bundleHandler->setDefaultFile("index.html").setVersionedCacheControl("public, max-age=31536000, immutable");
+        bundleHandler->setFilter(isWebAsset); // Also covers bundles packed before private files were left out
+        server.addHandler(bundleHandler);
+    }
+    server.serveStatic("/", FILESYSTEM, "/", "no-cache")
+        .setDefaultFile("index.html")
+        .setGzipFirst(true)
+        .setETagProvider(webAssetHash)
+        .setVersionedCacheControl("public, max-age=31536000, immutable")
+        .setFilter(isWebAsset);
+
     server.begin();
     Serial.println("✅ Web Server Routes Configuration Completed!");
 }
@@ -1137,6 +4076,10 @@ void initialTimeSyncViaSNTP()
 
     for (int i = 0; i < numServers; i++)
     {
+        // 🎯 Precise exchange first (offset/delay with µs resolution), plain SNTP as fallback
+        if (syncTimeViaNTPClient(ntpServers[i]))
+            return;
+
         Serial.printf("🌐 Trying SNTP server: %s\n", ntpServers[i]);
 
         configTime(0, 0, ntpServers[i]);
@@ -1157,6 +4100,8 @@ void initialTimeSyncViaSNTP()
 
             if (now >= 8 * 3600 * 2)
             {
+                timeLastStepUs.store(0, std::memory_order_relaxed); // SNTP does not report the step
+                recordTimeDiscipline(TIME_SOURCE_NTP, 100000); // SNTP gives no error estimate
                 Serial.println("\n✅ Time synchronized!");
                 return;
             }
@@ -1167,6 +4112,52 @@ void initialTimeSyncViaSNTP()
 
     Serial.println("❌ All SNTP servers failed.");
 }
+bool syncTimeViaNTPClient(const char *server)
+{
+    const int samples = 4;
+
+    Serial.printf("🎯 Precise NTP sync against %s\n", server);
+
+    WiFiUDP ntpUDP;
+    NTPClient ntp(ntpUDP, server);
+    ntp.begin();
+
+    // ⏱️ Keep the sample with the shortest round trip: it has the smallest asymmetry error
+    int64_t bestOffset = 0;
+    int64_t bestDelay = INT64_MAX;
+    int64_t bestDispersion = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        if (ntp.forceUpdate() && ntp.getDelayMicros() < bestDelay)
+        {
+            bestOffset = ntp.getOffsetMicros();
+            bestDelay = ntp.getDelayMicros();
+            bestDispersion = ntp.getDispersionMicros();
+        }
+        delay(50);
+    }
+    ntp.end();
+
+    if (bestDelay == INT64_MAX)
+    {
+        Serial.println("⚠️ No valid NTP reply.");
+        return false;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t corrected = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec + bestOffset;
+    tv.tv_sec = corrected / 1000000LL;
+    tv.tv_usec = corrected % 1000000LL;
+    settimeofday(&tv, nullptr);
+    timeLastStepUs.store((int32_t)constrain(bestOffset, (int64_t)INT32_MIN, (int64_t)INT32_MAX), std::memory_order_relaxed);
+    recordTimeDiscipline(TIME_SOURCE_NTP, (uint32_t)bestDispersion);
+
+    Serial.printf("✅ Time synchronized: offset %lld µs, delay %lld µs, dispersion %lld µs\n",
+                  bestOffset, bestDelay, bestDispersion);
+    return true;
+}
+
 bool syncTimeFromGPS()
 {
     Serial.println("📡 Trying to get time from GPS (requires valid fix)...");
@@ -1198,7 +4189,12 @@ bool syncTimeFromGPS()
 
             time_t epoch = mktime(&timeinfo); // uses current TZ; set TZ to UTC if needed at startup
             struct timeval now = {.tv_sec = epoch, .tv_usec = 0};
+            struct timeval before;
+            gettimeofday(&before, nullptr);
+            int64_t stepUs = ((int64_t)epoch - before.tv_sec) * 1000000LL - before.tv_usec;
             settimeofday(&now, nullptr);
+            timeLastStepUs.store((int32_t)constrain(stepUs, (int64_t)INT32_MIN, (int64_t)INT32_MAX), std::memory_order_relaxed);
+            recordTimeDiscipline(TIME_SOURCE_GPS, GPS_SYNC_ERROR_US);
 
             Serial.printf("✅ GPS time synced: %04d-%02d-%02d %02d:%02d:%02d\n",
                           gps.date.year(), gps.date.month(), gps.date.day(),
@@ -1210,13 +4206,13 @@ bool syncTimeFromGPS()
 
             String newLocator = latLonToMaidenhead(latitude, longitude);
 
-            if (newLocator != String(loc))
+            if (newLocator != settingsSnapshot().locator)
             {
                 Serial.printf("📍 Updating stored locator: %s → %s\n", loc, newLocator.c_str());
-                preferences.begin("settings", false);
-                preferences.putString("locator", newLocator);
-                preferences.end();
-                newLocator.toCharArray(loc, sizeof(loc)); // update global char array
+                StaticJsonDocument<64> patch;
+                patch["locator"] = newLocator;
+                String error;
+                patchSettings(patch.as<JsonObjectConst>(), error); // The loop picks it up before the next transmission
             }
             else
             {
@@ -1234,7 +4230,170 @@ bool syncTimeFromGPS()
     return false;
 }
 
+bool holdoverIsValid(const TimeHoldover &holdover)
+{
+    return holdover.magic == HOLDOVER_MAGIC &&
+           holdover.crc == esp_rom_crc32_le(0, (const uint8_t *)&holdover, offsetof(TimeHoldover, crc));
+}
+
+void holdoverSnapshot(TimeHoldover &holdover)
+{
+    portENTER_CRITICAL(&holdoverMux);
+    memcpy(&holdover, &timeHoldover, sizeof(holdover)); // Padding too: the CRC covers it
+    portEXIT_CRITICAL(&holdoverMux);
+}
+
+// 🔮 Current UTC estimated from the RTC timer and the last discipline, with its error bound
+bool holdoverPredict(const TimeHoldover &holdover, int64_t *epochUs, uint32_t *errorBoundUs)
+{
+    if (!holdoverIsValid(holdover) || holdover.source == TIME_SOURCE_NONE)
+        return false;
+
+    int64_t elapsedUs = (int64_t)(esp_clk_rtc_time() - holdover.rtcUs);
+    if (elapsedUs < 0)
+        return false; // RTC timer restarted: power was lost
+
+    *epochUs = holdover.epochUs + elapsedUs - (elapsedUs * holdover.driftPpb) / 1000000000LL;
+
+    int64_t toleranceUs = elapsedUs * (holdover.driftValid ? HOLDOVER_RESIDUAL_DRIFT_PPM : HOLDOVER_DEFAULT_DRIFT_PPM) / 1000000LL;
+    *errorBoundUs = (uint32_t)min<int64_t>(holdover.syncErrorUs + toleranceUs, UINT32_MAX);
+    return true;
+}
+
+void saveHoldover()
+{
+    portENTER_CRITICAL(&holdoverMux);
+    if (holdoverIsValid(timeHoldover)) // Otherwise nothing disciplined yet
+    {
+        timeHoldover.inCalibration = performCalibration;
+        timeHoldover.calFactor = cal_factor;
+        timeHoldover.crc = esp_rom_crc32_le(0, (const uint8_t *)&timeHoldover, offsetof(TimeHoldover, crc));
+    }
+    portEXIT_CRITICAL(&holdoverMux);
+}
+
+/*
+ * 📌 Call right after settimeofday(): anchors the holdover and refines the RTC drift estimate.
+ * Re-syncs come every few minutes, too close together for their errors to give a usable
+ * rate, so the drift is measured from a base sync kept across re-syncs until the two sync
+ * errors together fit in the residual tolerance over the time between them.
+ */
+void recordTimeDiscipline(uint8_t source, uint32_t errorBoundUs)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t nowUs = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+    uint64_t rtcNowUs = esp_clk_rtc_time();
+
+    TimeHoldover holdover;
+    holdoverSnapshot(holdover);
+    int64_t predictedUs;
+    uint32_t predictedErrorUs;
+    bool predicted = holdoverPredict(holdover, &predictedUs, &predictedErrorUs);
+    bool driftMeasured = false;
+    if (predicted)
+    {
+        int64_t baseElapsedUs = (int64_t)(rtcNowUs - holdover.driftBaseRtcUs);
+        int64_t syncErrorsUs = (int64_t)holdover.driftBaseErrorUs + errorBoundUs;
+        if (baseElapsedUs > 0 && baseElapsedUs / 1000000LL * HOLDOVER_RESIDUAL_DRIFT_PPM >= syncErrorsUs)
+        {
+            int64_t gainUs = baseElapsedUs - (nowUs - holdover.driftBaseEpochUs); // RTC ahead of UTC since the base
+            int32_t measuredPpb = (int32_t)((gainUs * 1000000000LL) / baseElapsedUs);
+            holdover.driftPpb = holdover.driftValid ? (holdover.driftPpb + measuredPpb) / 2 : measuredPpb;
+            holdover.driftValid = true;
+            driftMeasured = true;
+        }
+    }
+    else
+    {
+        holdover.driftPpb = 0;
+        holdover.driftValid = false;
+    }
+    if (!predicted || driftMeasured)
+    {
+        holdover.driftBaseRtcUs = rtcNowUs;
+        holdover.driftBaseEpochUs = nowUs;
+        holdover.driftBaseErrorUs = errorBoundUs;
+    }
+
+    holdover.magic = HOLDOVER_MAGIC;
+    holdover.rtcUs = rtcNowUs;
+    holdover.epochUs = nowUs;
+    holdover.source = source;
+    holdover.syncErrorUs = errorBoundUs;
+
+    portENTER_CRITICAL(&holdoverMux);
+    holdover.inCalibration = performCalibration;
+    holdover.calFactor = cal_factor;
+    holdover.crc = esp_rom_crc32_le(0, (const uint8_t *)&holdover, offsetof(TimeHoldover, crc));
+    memcpy(&timeHoldover, &holdover, sizeof(holdover));
+    portEXIT_CRITICAL(&holdoverMux);
+    timeSource = source;
+
+    if (predicted)
+        Serial.printf("⏱️ Holdover error: %+lld µs (bound %u µs)\n", nowUs - predictedUs, predictedErrorUs);
+    if (driftMeasured)
+        Serial.printf("⏱️ RTC drift: %+d ppb\n", holdover.driftPpb);
+}
+
+bool restoreTimeFromHoldover()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT)
+    {
+        timeHoldover.magic = 0; // RTC memory content is garbage
+        return false;
+    }
+
+    TimeHoldover holdover;
+    holdoverSnapshot(holdover);
+    int64_t epochUs;
+    uint32_t errorBoundUs;
+    if (!holdoverPredict(holdover, &epochUs, &errorBoundUs))
+        return false;
+
+    if (errorBoundUs > HOLDOVER_MAX_ERROR_US)
+    {
+        Serial.printf("⚠️ Holdover too old (bound %u µs), full time sync needed.\n", errorBoundUs);
+        return false;
+    }
+
+    struct timeval tv = {.tv_sec = (time_t)(epochUs / 1000000LL), .tv_usec = (suseconds_t)(epochUs % 1000000LL)};
+    settimeofday(&tv, nullptr);
+    timeSource = TIME_SOURCE_HOLDOVER;
+
+    char timeText[9];
+    Serial.printf("♻️ Warm boot: time restored from holdover %s (±%u ms)\n",
+                  convertPosixToHHMMSS(tv.tv_sec, timeText), errorBoundUs / 1000);
+    return true;
+}
+
+void timeVerifyTask(void *parameter)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t clockBeforeUs = (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+    int64_t uptimeBeforeUs = esp_timer_get_time();
+
+    if (!syncTimeFromGPS())
+    {
+        xEventGroupWaitBits(bootEvents, BOOT_WIFI, pdFALSE, pdTRUE, portMAX_DELAY);
+        initialTimeSyncViaSNTP();
+    }
+
+    // 🔁 Holdover was off by more than WSPR tolerates: reschedule from the corrected time
+    gettimeofday(&tv, nullptr);
+    int64_t stepUs = ((int64_t)tv.tv_sec * 1000000LL + tv.tv_usec - clockBeforeUs) - (esp_timer_get_time() - uptimeBeforeUs);
+    if (stepUs > 1000000LL || stepUs < -1000000LL)
+    {
+        Serial.printf("⚠️ Time corrected by %+lld ms after warm boot, rescheduling.\n", stepUs / 1000);
+        interruptWSPRcurrentTX = true;
+        isFirstIteration = true;
+    }
 
+    timeVerifyTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
 
 String latLonToMaidenhead(float lat, float lon)
 {
@@ -1254,68 +4413,120 @@ String latLonToMaidenhead(float lat, float lon)
     return String(maiden);
 }
 
-bool connectToWiFi_DHCP_then_Static()
+bool waitForWiFiConnection(unsigned long timeoutMs)
 {
-    Serial.println("📡 Connecting to Wi-Fi in DHCP mode...");
-    WiFi.mode(WIFI_STA);
-    WiFi.setHostname(hostname); // Apply hostname before connecting
-    WiFi.begin(ssid, password);
-
     unsigned long startAttemptTime = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 10000)
+    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < timeoutMs)
     {
-        delay(500);
-        Serial.print("⏳");
+        delay(100);
     }
+    return WiFi.status() == WL_CONNECTED;
+}
 
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        Serial.println("\n❌ DHCP connection failed. Check credentials or signal.");
-        return false;
-    }
+// 📂 Lease learned on a previous boot; only valid for the currently provisioned SSID
+bool loadWiFiLease()
+{
+    Preferences preferences; // One per caller: boot stages use NVS concurrently
+    preferences.begin("wifi", true);
+    bool valid = preferences.getString("leaseSSID", "") == String(wifiSSID) &&
+                 preferences.getBytes("bssid", wifiBSSID, sizeof(wifiBSSID)) == sizeof(wifiBSSID);
+    dhcp_ip = preferences.getUInt("ip", 0);
+    dhcp_gateway = preferences.getUInt("gateway", 0);
+    dhcp_subnet = preferences.getUInt("subnet", 0);
+    dhcp_dns = preferences.getUInt("dns", 0);
+    wifiChannel = preferences.getInt("channel", 0);
+    preferences.end();
+
+    return valid && (uint32_t)dhcp_ip != 0 && wifiChannel > 0;
+}
 
-    // ✅ DHCP successful — gather config
+void saveWiFiLease()
+{
     dhcp_ip = WiFi.localIP();
     dhcp_gateway = WiFi.gatewayIP();
     dhcp_subnet = WiFi.subnetMask();
-    IPAddress primaryDNS = WiFi.dnsIP(0);
+    dhcp_dns = WiFi.dnsIP(0);
+    wifiChannel = WiFi.channel();
+    memcpy(wifiBSSID, WiFi.BSSID(), sizeof(wifiBSSID));
+
+    Preferences preferences;
+    preferences.begin("wifi", false);
+    preferences.putString("leaseSSID", wifiSSID);
+    preferences.putUInt("ip", (uint32_t)dhcp_ip);
+    preferences.putUInt("gateway", (uint32_t)dhcp_gateway);
+    preferences.putUInt("subnet", (uint32_t)dhcp_subnet);
+    preferences.putUInt("dns", (uint32_t)dhcp_dns);
+    preferences.putInt("channel", wifiChannel);
+    preferences.putBytes("bssid", wifiBSSID, sizeof(wifiBSSID));
+    preferences.end();
 
-    Serial.println("\n✅ Connected via DHCP:");
+    Serial.println("💾 Wi-Fi lease cached for next boot:");
     Serial.print("   📍 IP Address : ");
     Serial.println(dhcp_ip);
     Serial.print("   🚪 Gateway    : ");
     Serial.println(dhcp_gateway);
     Serial.print("   📦 Subnet     : ");
     Serial.println(dhcp_subnet);
-    Serial.print("   🟢 DNS 1 (DHCP): ");
-    Serial.println(WiFi.dnsIP(0));
-    Serial.print("   🔵 DNS 2 (DHCP): ");
-    Serial.println(WiFi.dnsIP(1));
+    Serial.print("   🟢 DNS        : ");
+    Serial.println(dhcp_dns);
+    Serial.printf("   📻 BSSID/Ch.  : %s / %d\n", WiFi.BSSIDstr().c_str(), wifiChannel);
+}
 
-    // 🔌 Disconnect before static reconfig
-    Serial.println("🔌 Disconnecting to reconfigure static IP...");
-    WiFi.disconnect(true); // Clear old settings
-    delay(1000);
+bool connectToWiFi()
+{
+    // 🔐 Credentials come from NVS; without them, fall back to the provisioning access point
+    Preferences preferences;
+    preferences.begin("wifi", true);
+    String storedSSID = preferences.getString("ssid", "");
+    String storedPassword = preferences.getString("password", "");
+    preferences.end();
+
+    if (storedSSID.isEmpty())
+    {
+        Serial.println("⚠️ No Wi-Fi credentials stored.");
+        startAPMode();
+        return false;
+    }
+    storedSSID.toCharArray(wifiSSID, sizeof(wifiSSID));
+    storedPassword.toCharArray(wifiPassword, sizeof(wifiPassword));
 
-    // 🛠️ Reconnect using static IP and custom DNS
-    Serial.println("🔁 Reconnecting with static IP and custom DNS...");
-    WiFi.config(dhcp_ip, dhcp_gateway, dhcp_subnet, primaryDNS, secondaryDNS);
-    WiFi.begin(ssid, password);
+    WiFi.mode(WIFI_STA);
+    WiFi.setHostname(hostname); // Apply hostname before connecting
 
-    startAttemptTime = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 10000)
+    bool connected = false;
+
+    // ⚡ Fast path: one association with the cached static lease, BSSID and channel (no scan, no DHCP)
+    if (loadWiFiLease())
     {
-        delay(500);
-        Serial.print("⏳");
+        Serial.printf("⚡ Fast-connecting to %s (ch. %d) with cached static IP...\n", wifiSSID, wifiChannel);
+        WiFi.config(dhcp_ip, dhcp_gateway, dhcp_subnet, dhcp_dns, secondaryDNS);
+        WiFi.begin(wifiSSID, wifiPassword, wifiChannel, wifiBSSID);
+        connected = waitForWiFiConnection(5000);
+
+        if (!connected)
+        {
+            Serial.println("⚠️ Fast connect failed, falling back to scan + DHCP.");
+            WiFi.disconnect();
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // Re-enable the DHCP client
+        }
     }
 
-    if (WiFi.status() != WL_CONNECTED)
+    // 🔍 Slow path: full scan and DHCP, then cache the lease for the next boot
+    if (!connected)
     {
-        Serial.println("\n❌ Static IP connection failed. Aborting.");
-        return false;
+        Serial.printf("📡 Connecting to %s in DHCP mode...\n", wifiSSID);
+        WiFi.begin(wifiSSID, wifiPassword);
+        connected = waitForWiFiConnection(10000);
+
+        if (!connected)
+        {
+            Serial.println("❌ DHCP connection failed. Check credentials or signal.");
+            return false;
+        }
+        saveWiFiLease();
     }
 
-    Serial.println("\n✅ Reconnected with static IP and DNS:");
+    Serial.println("✅ Connected to Wi-Fi:");
     Serial.print("   📍 IP Address : ");
     Serial.println(WiFi.localIP());
     Serial.print("   🟢 DNS 1      : ");
@@ -1337,95 +4548,32 @@ bool connectToWiFi_DHCP_then_Static()
 
     return true;
 }
-byte getNextEnabledBandIndex(byte currentIndex)
+void startAPMode()
 {
-    Serial.println("\n🔄 Searching for next enabled band...");
-    // Serial.printf("📍 Current index: %d (%s)\n", currentIndex, WSPRbandNames[currentIndex]);
-
-    // Count how many bands are enabled
-    int enabledCount = 0;
-    for (int i = 0; i < numWSPRbands; i++)
-    {
-        if (wsprBandEnabled[i])
-            enabledCount++;
-    }
+    Serial.printf("\n📡 Starting Access Point mode: '%s'\n", apSSID);
 
-    // Handle degenerate case
-    if (enabledCount == 0)
-    {
-        Serial.println("❌ No enabled bands! Staying on current.");
-        for (int i = 0; i < numWSPRbands; i++)
-        {
-            Serial.printf("   [%d] %-4s — ❌ DISABLED%s\n", i, WSPRbandNames[i],
-                          (i == currentIndex ? " --> CURRENT" : ""));
-        }
-        return currentIndex;
-    }
-
-    if (enabledCount == 1)
-    {
-        // Find the only enabled band
-        byte onlyIdx = 0xFF;
-        for (int i = 0; i < numWSPRbands; i++)
-        {
-            if (wsprBandEnabled[i])
-            {
-                onlyIdx = i;
-                break;
-            }
-        }
-
-        Serial.println("🔂 Only one band enabled — no hopping.");
-        for (int i = 0; i < numWSPRbands; i++)
-        {
-            const char *emoji = wsprBandEnabled[i] ? "✅ ENABLED " : "❌ DISABLED";
-            Serial.printf("   [%d] %-4s — %s%s\n", i, WSPRbandNames[i], emoji,
-                          (i == onlyIdx ? " --> SELECTED" : ""));
-        }
-
-        // If current is already the only enabled one, keep it; otherwise switch to it
-        if (onlyIdx != 0xFF && onlyIdx != currentIndex)
-            Serial.printf("\n✅ Switching to band index %d (%s)\n", onlyIdx, WSPRbandNames[onlyIdx]);
-
-        return (onlyIdx != 0xFF) ? onlyIdx : currentIndex; // fallback safety
-    }
+    // Scan available Wi-Fi networks before launching the web interface
+    Serial.println("🔍 Scanning available Wi-Fi networks...");
+    WiFi.mode(WIFI_AP_STA);
+    int numNetworks = WiFi.scanNetworks();
 
-    // Normal rotation to next enabled band
-    byte nextIndex = currentIndex;
-    for (int offset = 1; offset <= numWSPRbands; offset++)
-    {
-        byte candidate = (currentIndex + offset) % numWSPRbands;
-        if (wsprBandEnabled[candidate])
-        {
-            nextIndex = candidate;
-            break;
-        }
-    }
+    // Prepare JSON document to store scanned networks
+    StaticJsonDocument<1024> doc;
+    JsonArray networks = doc.createNestedArray("networks");
 
-    // 📋 Full table
-    Serial.println("\n📋 Band Status Table:");
-    for (int i = 0; i < numWSPRbands; i++)
+    for (int i = 0; i < numNetworks; i++)
     {
-        const char *emoji = wsprBandEnabled[i] ? "✅ ENABLED " : "❌ DISABLED";
-        bool isCurrent = (i == currentIndex);
-        bool isNext = (i == nextIndex && i != currentIndex);
-
-        Serial.printf("   [%d] %-4s — %s%s%s\n", i, WSPRbandNames[i], emoji,
-                      isCurrent ? " <-- CURRENT" : "",
-                      isNext ? " --> NEXT" : "");
+        JsonObject network = networks.createNestedObject();
+        network["ssid"] = WiFi.SSID(i);
+        network["rssi"] = WiFi.RSSI(i);
+        network["encryptionType"] = (WiFi.encryptionType(i) == WIFI_AUTH_OPEN) ? "Open 🔓" : "Secured 🔐";
     }
-
-    Serial.printf("\n✅ Switching to band index %d (%s)\n", nextIndex, WSPRbandNames[nextIndex]);
-    Serial.println();
-    return nextIndex;
+    Serial.printf("✅ %d network(s) found\n", numNetworks);
+    scannedNetworksJson = "";
+    serializeJson(doc, scannedNetworksJson);
+    WiFi.scanDelete();
+
+    WiFi.softAP(apSSID);
+    apModeActive = true;
+    Serial.printf("🌐 Open http://%s to configure Wi-Fi\n", WiFi.softAPIP().toString().c_str());
 }
-
-byte getFirstEnabledBandIndex()
-{
-    for (byte i = 0; i < numWSPRbands; i++)
-    {
-        if (wsprBandEnabled[i])
-            return i;
-    }
-    return 0; // fallback to 0 if none are enabled
-}
\ No newline at end of file
@@ -0,0 +1,183 @@
+/*
+  Host tests of FrequencyPlanner: pio test -e native -f test_frequency_planner
+
+  The last test is a simulation of one band shared with other beacons, some
+  on a fixed frequency and some hopping, where 80 % of their transmissions
+  come back as reports. It compares the collision rate of the planner with
+  the uniform random choice it replaced.
+*/
+#include <unity.h>
+#include <FrequencyPlanner.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+
+static std::mt19937 gen;
+static uint32_t rng(){ return gen(); }
+
+void setUp(){ gen.seed(12345); }
+void tearDown(){}
+
+void test_no_reports_is_uniform(){
+  FrequencyPlanner planner;
+  int hits[FP_WINDOW_HZ + 1] = {0};
+  for(int i = 0; i < 17100; i++){
+    int f = planner.choose(15, 185, -1, rng);
+    TEST_ASSERT_TRUE(f >= 15 && f <= 185);
+    hits[f]++;
+  }
+  // 100 expected per offset
+  for(int f = 15; f <= 185; f++)
+    TEST_ASSERT_INT_WITHIN(50, 100, hits[f]);
+}
+
+void test_keeps_away_from_last_offset(){
+  FrequencyPlanner planner;
+  int last = 100;
+  for(int i = 0; i < 1000; i++){
+    int f = planner.choose(15, 185, last, rng);
+    TEST_ASSERT_GREATER_OR_EQUAL(FP_SIGNAL_HZ, abs(f - last));
+    last = f;
+  }
+}
+
+void test_picks_the_quiet_gap(){
+  FrequencyPlanner planner;
+  for(int f = 15; f <= 185; f++){
+    if(f < 90 || f > 110)
+      planner.add(f, 1, 0);
+  }
+  // Centres 95..105 overlap nothing
+  for(int i = 0; i < 500; i++){
+    int f = planner.choose(15, 185, -1, rng);
+    TEST_ASSERT_TRUE(f >= 95 && f <= 105);
+  }
+}
+
+void test_spreads_over_equal_gaps(){
+  FrequencyPlanner planner;
+  for(int f = 15; f <= 185; f++){
+    if(abs(f - 50) > 10 && abs(f - 150) > 10)
+      planner.add(f, 1, 0);
+  }
+  int low = 0;
+  for(int i = 0; i < 1000; i++)
+    low += planner.choose(15, 185, -1, rng) < 100;
+  TEST_ASSERT_INT_WITHIN(100, 500, low);
+}
+
+void test_reports_age(){
+  FrequencyPlanner planner;
+  planner.add(50, 1, 0);
+  TEST_ASSERT_EQUAL(FP_WEIGHT_ONE, planner.total());
+  planner.clear();
+  planner.add(50, 1, FP_HALF_LIFE_S);
+  TEST_ASSERT_EQUAL(FP_WEIGHT_ONE / 2, planner.total());
+  planner.clear();
+  planner.add(50, 4, 2 * FP_HALF_LIFE_S);
+  TEST_ASSERT_EQUAL(FP_WEIGHT_ONE, planner.total());
+}
+
+void test_ignores_out_of_window_and_saturates(){
+  FrequencyPlanner planner;
+  planner.add(-1, 1, 0);
+  planner.add(FP_WINDOW_HZ + 1, 1, 0);
+  TEST_ASSERT_EQUAL(0, planner.total());
+  planner.add(0, 1000, 0);
+  TEST_ASSERT_EQUAL(UINT16_MAX, planner.total());
+}
+
+void test_cost_covers_signal_width(){
+  FrequencyPlanner planner;
+  planner.add(100, 1, 0);
+  TEST_ASSERT_EQUAL(FP_WEIGHT_ONE, planner.cost(100 + FP_SIGNAL_HZ - 1));
+  TEST_ASSERT_EQUAL(0, planner.cost(100 + FP_SIGNAL_HZ));
+  TEST_ASSERT_EQUAL(FP_SELF_PENALTY, planner.cost(20, 25));
+}
+
+struct Beacon {
+  bool fixed;
+  int offsetHz;
+  double duty;
+};
+
+// Fraction of our transmissions within FP_SIGNAL_HZ of another beacon, uniform choice and planner
+static void simulate(int beacons, double& uniformRate, double& plannerRate){
+  const int slots = 40000;
+  const int historySlots = 30;      // One hour of reports
+  std::uniform_int_distribution<int> offset(15, 185);
+  std::uniform_real_distribution<double> unit(0, 1);
+
+  std::vector<Beacon> others(beacons);
+  for(Beacon& b : others){
+    b.fixed = unit(gen) < 0.6;
+    b.offsetHz = offset(gen);
+    b.duty = 0.1 + 0.3 * unit(gen);
+  }
+
+  std::vector<std::vector<int> > reports(slots);
+  FrequencyPlanner planner;
+  int last = -1;
+  long tx = 0, uniformHits = 0, plannerHits = 0;
+  for(int s = 0; s < slots; s++){
+    std::vector<int> active;
+    for(const Beacon& b : others){
+      if(unit(gen) >= b.duty)
+        continue;
+      int f = b.fixed ? b.offsetHz : offset(gen);
+      active.push_back(f);
+      if(unit(gen) < 0.8)
+        reports[s].push_back(f);
+    }
+    if(s % 5 || s <= historySlots)
+      continue;   // We transmit every 10 minutes
+
+    // Reports are fetched every 30 minutes
+    if(s % 15 == 0){
+      planner.clear();
+      for(int k = s - historySlots; k < s; k++){
+        for(int f : reports[k])
+          planner.add(f, 1, (s - k) * 120);
+      }
+    }
+    int uniform = offset(gen);
+    int planned = planner.choose(15, 185, last, rng);
+    last = planned;
+    tx++;
+    bool uniformHit = false, plannedHit = false;
+    for(int f : active){
+      uniformHit |= abs(f - uniform) < FP_SIGNAL_HZ;
+      plannedHit |= abs(f - planned) < FP_SIGNAL_HZ;
+    }
+    uniformHits += uniformHit;
+    plannerHits += plannedHit;
+  }
+  uniformRate = (double)uniformHits / tx;
+  plannerRate = (double)plannerHits / tx;
+}
+
+void test_simulation_fewer_collisions(){
+  for(int beacons : {10, 20, 40, 80}){
+    double uniformRate, plannerRate;
+    simulate(beacons, uniformRate, plannerRate);
+    char line[96];
+    snprintf(line, sizeof(line), "%2d beacons: collisions %.1f%% uniform, %.1f%% planner",
+             beacons, 100 * uniformRate, 100 * plannerRate);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(plannerRate < 0.8 * uniformRate, line);
+  }
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_no_reports_is_uniform);
+  RUN_TEST(test_keeps_away_from_last_offset);
+  RUN_TEST(test_picks_the_quiet_gap);
+  RUN_TEST(test_spreads_over_equal_gaps);
+  RUN_TEST(test_reports_age);
+  RUN_TEST(test_ignores_out_of_window_and_saturates);
+  RUN_TEST(test_cost_covers_signal_width);
+  RUN_TEST(test_simulation_fewer_collisions);
+  return UNITY_END();
+}
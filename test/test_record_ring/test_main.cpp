@@ -0,0 +1,270 @@
+/*
+  Host tests of RecordRing: pio test -e native -f test_record_ring
+
+  The store keeps segments in memory and can be told to fail: an append that
+  writes only part of its slot, a segment that cannot be removed while a
+  reader holds it open. Damage that flash can do (a torn tail, a flipped bit)
+  is applied to the stored bytes directly.
+*/
+#include <unity.h>
+#include <RecordRing.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#define MAGIC 0x54534554   // "TEST"
+#define PER_SEGMENT 8
+#define SEGMENTS 4
+
+struct Record {
+  uint32_t value;
+  char text[12];
+};
+
+class MemoryStore: public RecordStore {
+  public:
+    std::map<uint32_t, std::vector<uint8_t> > segments;
+    int failAppendAfter = -1;   // Bytes written by the next append before it fails
+    uint32_t held = UINT32_MAX; // Segment that cannot be removed
+    size_t appended = 0;
+    int flushes = 0;
+
+    size_t size(uint32_t segment) override {
+      auto it = segments.find(segment);
+      return it == segments.end() ? 0 : it->second.size();
+    }
+    bool append(uint32_t segment, const uint8_t* data, size_t len) override {
+      std::vector<uint8_t>& s = segments[segment];
+      if(failAppendAfter >= 0){
+        s.insert(s.end(), data, data + failAppendAfter);
+        failAppendAfter = -1;
+        return false;
+      }
+      s.insert(s.end(), data, data + len);
+      appended += len;
+      return true;
+    }
+    void flush() override {
+      flushes++;
+    }
+    bool read(uint32_t segment, size_t offset, uint8_t* data, size_t len) override {
+      auto it = segments.find(segment);
+      if(it == segments.end() || offset + len > it->second.size())
+        return false;
+      memcpy(data, &it->second[offset], len);
+      return true;
+    }
+    bool remove(uint32_t segment) override {
+      if(segment == held)
+        return false;
+      segments.erase(segment);
+      return true;
+    }
+    void list(void (*found)(uint32_t segment, void* context), void* context) override {
+      for(auto& s: segments)
+        found(s.first, context);
+    }
+};
+
+static Record makeRecord(uint32_t value){
+  Record r;
+  memset(&r, 0, sizeof(r));
+  r.value = value;
+  snprintf(r.text, sizeof(r.text), "rec%u", (unsigned)value);
+  return r;
+}
+
+static void appendRange(RecordRing& ring, uint32_t count){
+  for(uint32_t i = 0; i < count; i++){
+    Record r = makeRecord(ring.next() * 10);
+    TEST_ASSERT_TRUE(ring.append(&r));
+  }
+}
+
+static bool readsBack(RecordRing& ring, uint32_t sequence){
+  Record r;
+  return ring.read(sequence, &r) && r.value == sequence * 10 && !strcmp(r.text, makeRecord(sequence * 10).text);
+}
+
+void setUp(){}
+void tearDown(){}
+
+void test_empty_store_starts_at_zero(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  TEST_ASSERT_EQUAL(0, ring.begin());
+  TEST_ASSERT_EQUAL(0, ring.oldest());
+  Record r;
+  TEST_ASSERT_FALSE(ring.read(0, &r));
+  appendRange(ring, 3);
+  TEST_ASSERT_EQUAL(3, ring.next());
+  for(uint32_t s = 0; s < 3; s++)
+    TEST_ASSERT_TRUE(readsBack(ring, s));
+  TEST_ASSERT_FALSE(ring.read(3, &r));
+  TEST_ASSERT_EQUAL(1, store.segments.size());
+  TEST_ASSERT_EQUAL(0, store.flushes);   // Batching appends is up to the caller
+  ring.flush();
+  TEST_ASSERT_EQUAL(1, store.flushes);
+}
+
+void test_wrap_drops_whole_segments(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT * SEGMENTS);
+  TEST_ASSERT_EQUAL(0, ring.oldest());
+  TEST_ASSERT_EQUAL(SEGMENTS, store.segments.size());
+
+  // The first record of a fifth segment drops the first segment, not one slot
+  appendRange(ring, 1);
+  TEST_ASSERT_EQUAL(SEGMENTS, store.segments.size());
+  TEST_ASSERT_EQUAL(PER_SEGMENT, ring.oldest());
+  TEST_ASSERT_FALSE(readsBack(ring, PER_SEGMENT - 1));
+  for(uint32_t s = ring.oldest(); s < ring.next(); s++)
+    TEST_ASSERT_TRUE(readsBack(ring, s));
+
+  // Many wraps later only the newest segments are left, every byte appended once
+  appendRange(ring, PER_SEGMENT * SEGMENTS * 5 + 3);
+  TEST_ASSERT_EQUAL(SEGMENTS, store.segments.size());
+  TEST_ASSERT_EQUAL((ring.next() / PER_SEGMENT - (SEGMENTS - 1)) * PER_SEGMENT, ring.oldest());
+  TEST_ASSERT_LESS_OR_EQUAL(ring.capacity(), ring.next() - ring.oldest());
+  TEST_ASSERT_GREATER_THAN(ring.capacity() - PER_SEGMENT, ring.next() - ring.oldest());
+  for(uint32_t s = ring.oldest(); s < ring.next(); s++)
+    TEST_ASSERT_TRUE(readsBack(ring, s));
+  TEST_ASSERT_EQUAL(ring.next() * (sizeof(Record) + 12), store.appended);
+}
+
+void test_reopen_resumes_after_the_last_record(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT * 6 + 5);
+
+  RecordRing reopened(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  TEST_ASSERT_EQUAL(ring.next(), reopened.begin());
+  TEST_ASSERT_EQUAL(ring.oldest(), reopened.oldest());
+  appendRange(reopened, 4);
+  for(uint32_t s = reopened.oldest(); s < reopened.next(); s++)
+    TEST_ASSERT_TRUE(readsBack(reopened, s));
+
+  // A full newest segment resumes at the start of the next one
+  appendRange(reopened, PER_SEGMENT - 1);
+  RecordRing full(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  TEST_ASSERT_EQUAL(PER_SEGMENT * 8, full.begin());
+}
+
+void test_torn_tail_resumes_in_the_next_segment(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT + 3);
+  // Power lost halfway through the slot of sequence PER_SEGMENT + 3
+  Record half = makeRecord(0);
+  store.segments[1].insert(store.segments[1].end(), (uint8_t*)&half, (uint8_t*)&half + 9);
+
+  RecordRing reopened(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  TEST_ASSERT_EQUAL(PER_SEGMENT * 2, reopened.begin());
+  for(uint32_t s = 0; s < PER_SEGMENT + 3; s++)
+    TEST_ASSERT_TRUE(readsBack(reopened, s));
+  Record r;
+  for(uint32_t s = PER_SEGMENT + 3; s < PER_SEGMENT * 2; s++)
+    TEST_ASSERT_FALSE(reopened.read(s, &r));
+  appendRange(reopened, 2);
+  TEST_ASSERT_TRUE(readsBack(reopened, PER_SEGMENT * 2));
+  TEST_ASSERT_TRUE(readsBack(reopened, PER_SEGMENT * 2 + 1));
+}
+
+void test_failed_append_moves_to_the_next_segment(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, 2);
+  store.failAppendAfter = 5;
+  Record r = makeRecord(20);
+  TEST_ASSERT_FALSE(ring.append(&r));
+  TEST_ASSERT_EQUAL(PER_SEGMENT, ring.next());
+  appendRange(ring, 3);
+  for(uint32_t s = 0; s < 2; s++)
+    TEST_ASSERT_TRUE(readsBack(ring, s));
+  for(uint32_t s = PER_SEGMENT; s < PER_SEGMENT + 3; s++)
+    TEST_ASSERT_TRUE(readsBack(ring, s));
+
+  // A stub found where a segment starts is replaced, not appended to
+  appendRange(ring, PER_SEGMENT - 3);
+  store.failAppendAfter = 7;
+  TEST_ASSERT_FALSE(ring.append(&r));
+  TEST_ASSERT_EQUAL(PER_SEGMENT * 3, ring.next());
+  store.segments[3].assign(7, 0xFF);
+  appendRange(ring, 1);
+  TEST_ASSERT_TRUE(readsBack(ring, PER_SEGMENT * 3));
+  TEST_ASSERT_EQUAL(sizeof(Record) + 12, store.size(3));
+}
+
+void test_corrupt_slot_reads_as_missing(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT + 4);
+  store.segments[1][2 * (sizeof(Record) + 12) + 10] ^= 0x04;   // A bit in the record of PER_SEGMENT + 2
+
+  RecordRing reopened(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  TEST_ASSERT_EQUAL(PER_SEGMENT + 4, reopened.begin());
+  for(uint32_t s = 0; s < PER_SEGMENT + 4; s++){
+    if(s == PER_SEGMENT + 2)
+      TEST_ASSERT_FALSE(readsBack(reopened, s));
+    else
+      TEST_ASSERT_TRUE(readsBack(reopened, s));
+  }
+
+  // Another ring's records, or a slot asked for under the wrong sequence, do not read either
+  RecordRing other(store, MAGIC + 1, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  Record r;
+  TEST_ASSERT_FALSE(other.read(0, &r));
+  TEST_ASSERT_FALSE(reopened.read(PER_SEGMENT * SEGMENTS, &r));
+}
+
+void test_held_segment_is_removed_later(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT * SEGMENTS);
+  store.held = 0;
+  appendRange(ring, 1);
+  TEST_ASSERT_EQUAL(SEGMENTS + 1, store.segments.size());
+  TEST_ASSERT_EQUAL(PER_SEGMENT, ring.oldest());
+  store.held = UINT32_MAX;
+  appendRange(ring, PER_SEGMENT);
+  TEST_ASSERT_EQUAL(SEGMENTS, store.segments.size());
+  TEST_ASSERT_EQUAL(2, store.segments.begin()->first);
+}
+
+void test_smaller_capacity_drops_old_segments_on_begin(){
+  MemoryStore store;
+  RecordRing ring(store, MAGIC, sizeof(Record), PER_SEGMENT, SEGMENTS);
+  ring.begin();
+  appendRange(ring, PER_SEGMENT * SEGMENTS);
+
+  RecordRing smaller(store, MAGIC, sizeof(Record), PER_SEGMENT, 2);
+  TEST_ASSERT_EQUAL(PER_SEGMENT * SEGMENTS, smaller.begin());
+  TEST_ASSERT_EQUAL(2, store.segments.size());
+  TEST_ASSERT_EQUAL(PER_SEGMENT * (SEGMENTS - 2), smaller.oldest());
+}
+
+void test_crc_matches_the_rom_crc(){
+  // esp_rom_crc32_le(0, "123456789", 9), the CRC-32 check value
+  TEST_ASSERT_EQUAL(0xCBF43926, RecordRing::crc32((const uint8_t*)"123456789", 9));
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_store_starts_at_zero);
+  RUN_TEST(test_wrap_drops_whole_segments);
+  RUN_TEST(test_reopen_resumes_after_the_last_record);
+  RUN_TEST(test_torn_tail_resumes_in_the_next_segment);
+  RUN_TEST(test_failed_append_moves_to_the_next_segment);
+  RUN_TEST(test_corrupt_slot_reads_as_missing);
+  RUN_TEST(test_held_segment_is_removed_later);
+  RUN_TEST(test_smaller_capacity_drops_old_segments_on_begin);
+  RUN_TEST(test_crc_matches_the_rom_crc);
+  return UNITY_END();
+}
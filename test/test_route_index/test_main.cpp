@@ -0,0 +1,277 @@
+/*
+  Host tests of WebRouteIndex: pio test -e native -f test_route_index
+
+  The handlers below stand in for AsyncWebServer's: a plain server.on() path
+  answers for itself and its subpaths, a wildcard path for every URL it
+  prefixes, a websocket or event source for its own path only, a JSON body
+  handler like a plain path without being in the route table, and the web
+  asset bundle for the files it holds. Each test checks the index against the
+  walk over the whole handler list that AsyncWebServer did before, which is
+  also the baseline of the benchmark.
+*/
+#include <unity.h>
+#include <WebRouteIndex.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#define GET 1
+#define POST 2
+#define PATCH 4
+#define ANY (GET | POST | PATCH)
+
+enum { PLAIN, PREFIX, EXACT, SUBPATH, BUNDLE };
+
+static const char* bundleFiles[] = {"/index.html", "/ap.html", "/calibrate.html", "/favicon.ico", "/assets/app.js", "/bootstrap/bootstrap.min.css"};
+
+struct Handler {
+  std::string uri;
+  int kind;
+  int methods;
+};
+
+struct Request {
+  std::string url;
+  int method;
+};
+
+static size_t asked;   // Handlers offered a request, like canHandle() calls
+
+static bool canHandle(const Handler* h, const Request& r){
+  asked++;
+  if(!(h->methods & r.method))
+    return false;
+  if(h->kind == PREFIX)
+    return r.url.compare(0, h->uri.size(), h->uri) == 0;
+  if(h->kind == EXACT)
+    return r.url == h->uri;
+  if(h->kind == BUNDLE){
+    std::string path = r.url[r.url.size() - 1] == '/' ? r.url + "index.html" : r.url;
+    for(const char* file: bundleFiles){
+      if(path == file)
+        return true;
+    }
+    return false;
+  }
+  return r.url == h->uri || (r.url.size() > h->uri.size() && r.url[h->uri.size()] == '/' && r.url.compare(0, h->uri.size(), h->uri) == 0);
+}
+
+static const Handler* linearFind(const std::vector<Handler>& handlers, const Request& r){
+  for(const Handler& h: handlers){
+    if(canHandle(&h, r))
+      return &h;
+  }
+  return NULL;
+}
+
+static void build(WebRouteIndex<const Handler>& index, const std::vector<Handler>& handlers){
+  index.clear();
+  for(const Handler& h: handlers)
+    index.add(&h, h.kind == PLAIN ? h.uri.c_str() : NULL, h.uri.size());
+  index.sort();
+}
+
+static const Handler* indexFind(const WebRouteIndex<const Handler>& index, const Request& r, bool& overflow){
+  return index.find(r.url.c_str(), r.url.size(), [&r](const Handler* h){ return canHandle(h, r); }, overflow);
+}
+
+static const Handler* indexFind(const WebRouteIndex<const Handler>& index, const Request& r){
+  bool overflow;
+  const Handler* h = indexFind(index, r, overflow);
+  TEST_ASSERT_FALSE(overflow);
+  return h;
+}
+
+// The firmware's handlers, in the order configure_web_server() adds them; in
+// access point mode "/" serves the provisioning page and "/index.html" is not routed
+static std::vector<Handler> firmwareHandlers(bool apMode){
+  static const char* settings[] = {"/getAllSettings", "/getLocator", "/getPower", "/getTimes", "/updateCallsign", "/updateLocator",
+                                   "/updatePower", "/updateScheduleState", "/startCalibtation", "/updateCalFactor", "/saveCalFactor",
+                                   "/updateLowPower", "/getPowerStats", "/getHeapStats", "/metrics", "/api/history",
+                                   "/api/spots/summary", "/api/spots", "/getTcpStats"};
+  static const char* late[] = {"/getBootTimings", "/getCalFactor", "/reboot", "/factoryReset"};
+  std::vector<Handler> handlers;
+  handlers.push_back({"/getModeOfOperation", PLAIN, GET});
+  handlers.push_back({"/", PLAIN, GET});
+  if(!apMode)
+    handlers.push_back({"/index.html", PLAIN, GET});
+  handlers.push_back({"/scanNetworks", PLAIN, GET});
+  handlers.push_back({"/saveSettings", PLAIN, POST});
+  handlers.push_back({"/getSelectedBands", PLAIN, GET});
+  handlers.push_back({"/updateSelectedBands", PLAIN, POST});
+  handlers.push_back({"/api/state", PLAIN, GET});
+  handlers.push_back({"/api/state", SUBPATH, PATCH});    // JSON body handler
+  handlers.push_back({"/api/schedule", PLAIN, GET});
+  handlers.push_back({"/api/schedule", SUBPATH, PATCH});
+  for(const char* uri: settings)
+    handlers.push_back({uri, PLAIN, GET});
+  handlers.push_back({"/events", EXACT, GET});
+  handlers.push_back({"/ws", EXACT, GET});
+  for(const char* uri: late)
+    handlers.push_back({uri, PLAIN, GET});
+  handlers.push_back({"/", BUNDLE, GET});                // Web asset bundle, when mounted
+  handlers.push_back({"/", PREFIX, GET});                // serveStatic("/")
+  return handlers;
+}
+
+void setUp(){}
+void tearDown(){}
+
+void test_plain_path_owns_its_subpaths(){
+  std::vector<Handler> handlers = {{"/api", PLAIN, ANY}, {"/api/spots", PLAIN, ANY}, {"/", PLAIN, ANY}};
+  WebRouteIndex<const Handler> index;
+  build(index, handlers);
+  TEST_ASSERT_TRUE(indexFind(index, {"/api", GET}) == &handlers[0]);
+  TEST_ASSERT_TRUE(indexFind(index, {"/api/spots", GET}) == &handlers[0]);    // Added first
+  TEST_ASSERT_TRUE(indexFind(index, {"/api/x/y", GET}) == &handlers[0]);
+  TEST_ASSERT_TRUE(indexFind(index, {"/apix", GET}) == NULL);
+  TEST_ASSERT_TRUE(indexFind(index, {"/", GET}) == &handlers[2]);
+  TEST_ASSERT_TRUE(indexFind(index, {"/metrics", GET}) == NULL);
+  TEST_ASSERT_TRUE(indexFind(index, {"", GET}) == NULL);
+}
+
+void test_first_handler_added_wins(){
+  std::vector<Handler> handlers = {{"/a", PLAIN, POST}, {"/", PREFIX, GET}, {"/a", PLAIN, ANY}, {"/a/b", PLAIN, ANY}, {"/a", PREFIX, ANY}};
+  WebRouteIndex<const Handler> index;
+  build(index, handlers);
+  TEST_ASSERT_TRUE(indexFind(index, {"/a", POST}) == &handlers[0]);
+  TEST_ASSERT_TRUE(indexFind(index, {"/a", GET}) == &handlers[1]);            // Wildcard added before the second "/a"
+  TEST_ASSERT_TRUE(indexFind(index, {"/a/b", POST}) == &handlers[0]);
+  TEST_ASSERT_TRUE(indexFind(index, {"/ab", POST}) == &handlers[4]);          // Rejected by the plain paths
+  TEST_ASSERT_TRUE(indexFind(index, {"/x", POST}) == NULL);
+}
+
+void test_too_many_candidates_overflow(){
+  std::vector<Handler> handlers;
+  for(int i = 0; i <= ASYNCWEBSERVER_MAX_ROUTE_CANDIDATES; i++)
+    handlers.push_back({"/busy", PLAIN, POST});
+  handlers.push_back({"/busy/x", PLAIN, GET});
+  WebRouteIndex<const Handler> index;
+  build(index, handlers);
+  bool overflow;
+  asked = 0;
+  TEST_ASSERT_TRUE(indexFind(index, {"/busy/x", GET}, overflow) == NULL);
+  TEST_ASSERT_TRUE(overflow);
+  TEST_ASSERT_EQUAL(0, asked);
+  TEST_ASSERT_TRUE(indexFind(index, {"/other", GET}, overflow) == NULL);
+  TEST_ASSERT_FALSE(overflow);
+}
+
+void test_matches_the_linear_walk(){
+  static const char* parts[] = {"a", "b", "ab", "api", "spots", "x"};
+  std::mt19937 rng(38);
+  for(int trial = 0; trial < 200; trial++){
+    std::vector<Handler> handlers;
+    int count = 1 + rng() % 40;
+    for(int i = 0; i < count; i++){
+      std::string uri;
+      int levels = rng() % 4;
+      for(int l = 0; l < levels; l++)
+        uri += std::string("/") + parts[rng() % 6];
+      if(uri.empty() || rng() % 4 == 0)
+        uri += "/";
+      int kind = rng() % 5 == 0 ? PREFIX : rng() % 8 == 0 ? EXACT : PLAIN;
+      handlers.push_back({uri, kind, 1 + (int)(rng() % 3)});
+    }
+    WebRouteIndex<const Handler> index;
+    build(index, handlers);
+    for(int q = 0; q < 100; q++){
+      Request r;
+      int levels = rng() % 5;
+      for(int l = 0; l < levels; l++)
+        r.url += std::string("/") + parts[rng() % 6];
+      if(r.url.empty() || rng() % 6 == 0)
+        r.url += "/";
+      r.method = 1 + rng() % 2;
+      bool overflow;
+      const Handler* got = indexFind(index, r, overflow);
+      if(overflow)
+        continue;
+      char line[96];
+      snprintf(line, sizeof(line), "trial %d: %s", trial, r.url.c_str());
+      TEST_ASSERT_TRUE_MESSAGE(got == linearFind(handlers, r), line);
+    }
+  }
+}
+
+// Every plain route with its method, a wrong method, bundled and LittleFS files, a websocket upgrade and JSON PATCHes
+static std::vector<Request> firmwareRequests(const std::vector<Handler>& handlers){
+  std::vector<Request> requests;
+  for(const Handler& h: handlers){
+    if(h.kind == PLAIN)
+      requests.push_back({h.uri, h.methods});
+  }
+  requests.push_back({"/reboot", POST});                  // GET only: nothing answers
+  requests.push_back({"/assets/app.js", GET});
+  requests.push_back({"/digital.ttf", GET});
+  requests.push_back({"/calibrate.html", GET});
+  requests.push_back({"/ws", GET});
+  requests.push_back({"/api/state", PATCH});
+  requests.push_back({"/api/schedule", PATCH});
+  return requests;
+}
+
+void test_firmware_routes_in_both_modes(){
+  for(int apMode = 0; apMode < 2; apMode++){
+    std::vector<Handler> handlers = firmwareHandlers(apMode);
+    WebRouteIndex<const Handler> index;
+    build(index, handlers);
+    for(const Request& r: firmwareRequests(handlers))
+      TEST_ASSERT_TRUE_MESSAGE(indexFind(index, r) == linearFind(handlers, r), r.url.c_str());
+    // Routed handlers, not the static files behind them
+    TEST_ASSERT_EQUAL(PLAIN, indexFind(index, {"/reboot", GET})->kind);
+    TEST_ASSERT_EQUAL(SUBPATH, indexFind(index, {"/api/state", PATCH})->kind);
+    TEST_ASSERT_EQUAL(apMode ? BUNDLE : PLAIN, indexFind(index, {"/index.html", GET})->kind);
+    TEST_ASSERT_EQUAL(PREFIX, indexFind(index, {"/digital.ttf", GET})->kind);
+  }
+}
+
+void test_benchmark_firmware_routes(){
+  std::vector<Handler> handlers = firmwareHandlers(false);
+  WebRouteIndex<const Handler> index;
+  build(index, handlers);
+  std::vector<Request> requests = firmwareRequests(handlers);
+
+  const int rounds = 20000;
+  size_t linearAsked = 0, indexAsked = 0;
+  const Handler* sink = NULL;
+  auto t0 = std::chrono::steady_clock::now();
+  asked = 0;
+  for(int i = 0; i < rounds; i++){
+    for(const Request& r: requests)
+      sink = linearFind(handlers, r);
+  }
+  linearAsked = asked;
+  auto t1 = std::chrono::steady_clock::now();
+  asked = 0;
+  for(int i = 0; i < rounds; i++){
+    for(const Request& r: requests)
+      sink = indexFind(index, r);
+  }
+  indexAsked = asked;
+  auto t2 = std::chrono::steady_clock::now();
+  TEST_ASSERT_NOT_NULL(sink);
+
+  double lookups = (double)rounds * requests.size();
+  double linearNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+  double indexNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups;
+  char line[160];
+  snprintf(line, sizeof(line), "%u handlers: %.1f asked and %.0f ns per request walking the list, %.1f asked and %.0f ns with the index",
+           (unsigned)handlers.size(), linearAsked / lookups, linearNs, indexAsked / lookups, indexNs);
+  TEST_MESSAGE(line);
+  // Timing on the host only shows the trend; what the index saves on the ESP32 is canHandle() calls
+  TEST_ASSERT_TRUE_MESSAGE(indexAsked * 4 < linearAsked, line);
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_path_owns_its_subpaths);
+  RUN_TEST(test_first_handler_added_wins);
+  RUN_TEST(test_too_many_candidates_overflow);
+  RUN_TEST(test_matches_the_linear_walk);
+  RUN_TEST(test_firmware_routes_in_both_modes);
+  RUN_TEST(test_benchmark_firmware_routes);
+  return UNITY_END();
+}
@@ -0,0 +1,254 @@
+/*
+  Host tests of SlotPlanner: pio test -e native -f test_slot_planner
+
+  Besides the plans themselves, two simulations back the TX-percentage
+  scheme: its guarantees (duty and spacing) for every percentage and several
+  seeds, and a population of beacons on one band at 20 % duty, comparing
+  seeded runs with every beacon on the same fixed interval.
+*/
+#include <unity.h>
+#include <SlotPlanner.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static std::mt19937 gen;
+static SlotRules rules;
+static const uint32_t day = 1792000000UL / 3600 / 24 * 24;   // An hour 0 UTC, in epoch hours
+static const uint32_t firstSlot = 1792000000UL / SP_SLOT_S;
+
+void setUp(){
+  gen.seed(12345);
+  memset(&rules, 0, sizeof(rules));
+  rules.bandCount = 9;
+  rules.seed = 0xC0FFEE;
+  rules.bandHours[1] = SP_ALL_HOURS;
+  rules.bandHours[3] = SP_ALL_HOURS;
+  rules.bandHours[7] = 0x03FF00UL;   // 08-17 UTC
+  const int8_t hop[SP_HOP_CYCLE] = {-1, 0, -1, 1, 2, 3, 4, 5, 6, 7};
+  memcpy(rules.hopBand, hop, sizeof(hop));
+  memset(rules.manual, SP_IDLE, sizeof(rules.manual));
+}
+void tearDown(){}
+
+void test_interval_rotates_across_hours(){
+  SlotPlanner plan;
+  rules.mode = SP_MODE_INTERVAL;
+  rules.intervalSlots = 4;
+  rules.hop = SP_HOP_ROTATE;
+  uint8_t usable[] = {1, 3, 7};
+
+  for(uint32_t hour = day + 10; hour < day + 12; hour++){
+    plan.build(rules, hour);
+    TEST_ASSERT_TRUE(plan.covers(hour));
+    int count = 0;
+    for(uint8_t s = 0; s < SP_SLOTS; s++){
+      uint32_t n = hour * SP_SLOTS + s;
+      if(n % 4){
+        TEST_ASSERT_EQUAL(SP_IDLE, plan.band(s));
+        continue;
+      }
+      TEST_ASSERT_EQUAL(usable[(n / 4) % 3], plan.band(s));
+      count++;
+    }
+    TEST_ASSERT_EQUAL(count, plan.txCount());
+  }
+}
+
+void test_band_hours_limit_the_rotation(){
+  SlotPlanner plan;
+  rules.mode = SP_MODE_INTERVAL;
+  rules.intervalSlots = 1;
+  plan.build(rules, day + 3);   // Band 7 closed at 03 UTC
+  TEST_ASSERT_EQUAL(SP_SLOTS, plan.txCount());
+  for(uint8_t s = 0; s < SP_SLOTS; s++)
+    TEST_ASSERT_TRUE(plan.band(s) == 1 || plan.band(s) == 3);
+}
+
+void test_coordinated_hopping(){
+  SlotPlanner plan;
+  rules.mode = SP_MODE_INTERVAL;
+  rules.intervalSlots = 1;
+  rules.hop = SP_HOP_COORDINATED;
+  plan.build(rules, day + 10);
+  for(uint8_t s = 0; s < SP_SLOTS; s++){
+    int8_t cycleBand = rules.hopBand[s % SP_HOP_CYCLE];
+    if(cycleBand == 1 || cycleBand == 3 || cycleBand == 7)
+      TEST_ASSERT_EQUAL(cycleBand, plan.band(s));
+    else
+      TEST_ASSERT_TRUE(plan.band(s) == 1 || plan.band(s) == 3 || plan.band(s) == 7);
+  }
+}
+
+void test_manual_plan_skips_closed_bands(){
+  SlotPlanner plan;
+  rules.mode = SP_MODE_MANUAL;
+  rules.manual[0] = 3;
+  rules.manual[5] = 7;
+  rules.manual[9] = 2;   // No hours at all
+  plan.build(rules, day + 10);
+  TEST_ASSERT_EQUAL(2, plan.txCount());
+  TEST_ASSERT_EQUAL(3, plan.band(0));
+  TEST_ASSERT_EQUAL(7, plan.band(5));
+  TEST_ASSERT_EQUAL(SP_IDLE, plan.band(9));
+  plan.build(rules, day + 3);
+  TEST_ASSERT_EQUAL(1, plan.txCount());
+}
+
+void test_no_usable_band_is_an_empty_plan(){
+  SlotPlanner plan;
+  memset(rules.bandHours, 0, sizeof(rules.bandHours));
+  plan.build(rules, day);
+  TEST_ASSERT_TRUE(plan.covers(day));
+  TEST_ASSERT_EQUAL(0, plan.txCount());
+}
+
+void test_percent_plan_matches_percent_slot(){
+  SlotPlanner plan;
+  rules.mode = SP_MODE_PERCENT;
+  rules.txPercent = 20;
+  for(uint32_t hour = day; hour < day + 24; hour++){
+    plan.build(rules, hour);
+    for(uint8_t s = 0; s < SP_SLOTS; s++){
+      uint32_t run;
+      bool tx = SlotPlanner::percentSlot(hour * SP_SLOTS + s, 20, rules.seed, run);
+      TEST_ASSERT_EQUAL(tx, plan.band(s) != SP_IDLE);
+    }
+  }
+  // The same rules give the same plan, e.g. after a reboot
+  SlotPlanner again;
+  again.build(rules, day + 23);
+  for(uint8_t s = 0; s < SP_SLOTS; s++)
+    TEST_ASSERT_EQUAL(plan.band(s), again.band(s));
+}
+
+void test_percent_edges(){
+  uint32_t run;
+  TEST_ASSERT_FALSE(SlotPlanner::percentSlot(firstSlot, 0, 1, run));
+  TEST_ASSERT_EQUAL(0, SlotPlanner::maxSpacing(0));
+  for(uint32_t n = firstSlot; n < firstSlot + 100; n++)
+    TEST_ASSERT_TRUE(SlotPlanner::percentSlot(n, 100, 1, run));
+  TEST_ASSERT_EQUAL(1, SlotPlanner::maxSpacing(100));
+  TEST_ASSERT_EQUAL(19, SlotPlanner::maxSpacing(10));
+}
+
+// Duty within two transmissions over any window and spacing within maxSpacing(), 10 days of slots
+void test_percent_guarantees_every_percentage(){
+  const int slots = 7200;
+  std::vector<int> sum(slots + 1);
+  for(int p = 1; p <= 100; p++){
+    for(int k = 0; k < 4; k++){
+      uint32_t seed = gen();
+      uint32_t base = firstSlot + gen() % 100000;
+      int last = -1, spacing = 0;
+      sum[0] = 0;
+      for(int s = 0; s < slots; s++){
+        uint32_t run;
+        bool tx = SlotPlanner::percentSlot(base + s, p, seed, run);
+        sum[s + 1] = sum[s] + tx;
+        if(tx){
+          if(last >= 0)
+            spacing = std::max(spacing, s - last);
+          last = s;
+        }
+      }
+      TEST_ASSERT_LESS_OR_EQUAL(SlotPlanner::maxSpacing(p), spacing);
+      for(int len : {30, 720, 7200}){
+        for(int a = 0; a + len <= slots; a += 7)
+          TEST_ASSERT_TRUE(fabs(sum[a + len] - sum[a] - len * p / 100.0) <= 2.0);
+      }
+    }
+  }
+}
+
+struct Population {
+  double worstCollisions;   // Of the beacon that fares worst: share of its transmissions within 6 Hz of another
+  double sameNeighbour;     // After sharing a slot, share of next transmissions shared with the same beacon
+  int maxSpacing;
+};
+
+// beacons stations at 20 % on one band for 30 days, each on a random offset per transmission
+static Population simulate(bool seeded, int beacons){
+  const int slots = 30 * 720;
+  std::vector<uint32_t> seed(beacons), phase(beacons);
+  for(int i = 0; i < beacons; i++){
+    seed[i] = gen();
+    phase[i] = gen() % 5;
+  }
+  std::vector<long> tx(beacons, 0), collisions(beacons, 0);
+  std::vector<int> last(beacons, -1), neighbour(beacons, -1), offset(beacons);
+  long shared = 0, repeated = 0;
+  int maxSpacing = 0;
+  std::vector<int> on;
+  for(int s = 0; s < slots; s++){
+    uint32_t n = firstSlot + s;
+    on.clear();
+    for(int i = 0; i < beacons; i++){
+      uint32_t run;
+      if(seeded ? SlotPlanner::percentSlot(n, 20, seed[i], run) : n % 5 == phase[i]){
+        on.push_back(i);
+        offset[i] = gen() % 201;
+      }
+    }
+    for(int i : on){
+      tx[i]++;
+      if(last[i] >= 0)
+        maxSpacing = std::max(maxSpacing, s - last[i]);
+      last[i] = s;
+      for(int j : on){
+        if(j != i && abs(offset[i] - offset[j]) < 6){
+          collisions[i]++;
+          break;
+        }
+      }
+      if(neighbour[i] >= 0){
+        shared++;
+        repeated += std::find(on.begin(), on.end(), neighbour[i]) != on.end();
+      }
+      neighbour[i] = -1;
+      for(int j : on){
+        if(j != i){
+          neighbour[i] = j;
+          break;
+        }
+      }
+    }
+  }
+  Population result = {0, shared ? (double)repeated / shared : 0, maxSpacing};
+  for(int i = 0; i < beacons; i++)
+    result.worstCollisions = std::max(result.worstCollisions, tx[i] ? (double)collisions[i] / tx[i] : 0);
+  return result;
+}
+
+void test_simulation_seeded_runs_vs_fixed_interval(){
+  for(int beacons : {10, 20, 40}){
+    Population fixed = simulate(false, beacons);
+    Population seeded = simulate(true, beacons);
+    char line[160];
+    snprintf(line, sizeof(line), "%2d beacons: worst collisions %.1f%% fixed, %.1f%% seeded; same neighbour %.0f%% fixed, %.0f%% seeded; max gap %d, %d slots",
+             beacons, 100 * fixed.worstCollisions, 100 * seeded.worstCollisions,
+             100 * fixed.sameNeighbour, 100 * seeded.sameNeighbour, fixed.maxSpacing, seeded.maxSpacing);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(seeded.sameNeighbour < 0.5 * fixed.sameNeighbour, line);
+    TEST_ASSERT_TRUE_MESSAGE(seeded.worstCollisions < fixed.worstCollisions, line);
+    TEST_ASSERT_LESS_OR_EQUAL(SlotPlanner::maxSpacing(20), seeded.maxSpacing);
+  }
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_interval_rotates_across_hours);
+  RUN_TEST(test_band_hours_limit_the_rotation);
+  RUN_TEST(test_coordinated_hopping);
+  RUN_TEST(test_manual_plan_skips_closed_bands);
+  RUN_TEST(test_no_usable_band_is_an_empty_plan);
+  RUN_TEST(test_percent_plan_matches_percent_slot);
+  RUN_TEST(test_percent_edges);
+  RUN_TEST(test_percent_guarantees_every_percentage);
+  RUN_TEST(test_simulation_seeded_runs_vs_fixed_interval);
+  return UNITY_END();
+}
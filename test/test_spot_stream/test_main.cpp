@@ -0,0 +1,235 @@
+/*
+  Host tests of SpotStream: pio test -e native -f test_spot_stream
+
+  The answers below have the shape wspr.live gives to the firmware's queries
+  (ClickHouse JSONEachRow: 64-bit integers and dates quoted, one object per
+  line), including a SELECT * answer whose extra columns the filter must drop.
+  They are fed through SpotStreamReader in blocks of many sizes, so rows and
+  values end up split across block boundaries.
+*/
+#include <unity.h>
+#include <SpotStream.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const char spotAnswer[] =
+  "{\"t\":1792037400,\"band\":14,\"frequency\":14097061,\"rx_sign\":\"DL1ABC\",\"rx_loc\":\"JO62qm\",\"rx_lat\":52.521,\"rx_lon\":13.375,\"tx_lat\":48.146,\"tx_lon\":11.625,\"distance\":504,\"snr\":-21,\"version\":\"2.6.1\"}\n"
+  "{\"t\":1792037400,\"band\":14,\"frequency\":14097058,\"rx_sign\":\"G4XYZ\",\"rx_loc\":\"IO91wm\",\"rx_lat\":51.521,\"rx_lon\":-0.125,\"tx_lat\":48.146,\"tx_lon\":11.625,\"distance\":923,\"snr\":-7,\"version\":\"\"}\n"
+  "{\"t\":1792038000,\"band\":7,\"frequency\":7040123,\"rx_sign\":\"K1\\\"Q\\\\T\",\"rx_loc\":\"FN42\",\"rx_lat\":42.5,\"rx_lon\":-71.0,\"tx_lat\":48.146,\"tx_lon\":11.625,\"distance\":6191,\"snr\":-28,\"version\":\"WSJT-X 2.7.0\"}\n";
+
+// A SELECT * row: every wspr.rx column, most of which the filter drops
+static const char selectAllRow[] =
+  "{\"id\":\"7303921746\",\"time\":\"2026-10-19 04:10:00\",\"band\":14,\"rx_sign\":\"DL1ABC\",\"rx_lat\":52.521,\"rx_lon\":13.375,"
+  "\"rx_loc\":\"JO62qm\",\"tx_sign\":\"DL0XX\",\"tx_lat\":48.146,\"tx_lon\":11.625,\"tx_loc\":\"JN58td\",\"distance\":504,"
+  "\"azimuth\":19,\"rx_azimuth\":200,\"frequency\":14097061,\"power\":23,\"snr\":-21,\"drift\":0,\"version\":\"2.6.1\",\"code\":1,"
+  "\"t\":1792037400}\n";
+
+static const char* spotFields[] = {"t", "band", "frequency", "rx_sign", "rx_loc", "rx_lat", "rx_lon", "tx_lat", "tx_lon",
+                                   "distance", "snr", "version"};
+
+struct MemorySource {
+  const char* data;
+  size_t len;
+  size_t pos;
+  size_t block;   // Largest read, like a socket handing over what has arrived
+  int reads;
+};
+
+static int readMemory(void* context, uint8_t* buf, size_t size){
+  MemorySource& m = *(MemorySource*)context;
+  size_t n = m.len - m.pos;
+  if(n > m.block)
+    n = m.block;
+  if(n > size)
+    n = size;
+  memcpy(buf, m.data + m.pos, n);
+  m.pos += n;
+  m.reads++;
+  return (int)n;
+}
+
+struct Spot {
+  uint32_t t;
+  int band;
+  uint32_t frequency;
+  char rxSign[12];
+  float rxLat;
+  int snr;
+  char version[16];
+};
+
+static MemorySource source;
+static JsonDocument filter;
+
+static DeserializationError readSpots(const char* data, size_t len, size_t block, std::vector<Spot>& spots, size_t stopAfter = 0){
+  source.data = data;
+  source.len = len;
+  source.pos = 0;
+  source.block = block;
+  source.reads = 0;
+  SpotStreamReader reader(readMemory, &source);
+  JsonDocument document;
+  return readJsonRows(reader, filter, document, [&](JsonObjectConst row){
+    Spot spot;
+    spot.t = row["t"] | 0u;
+    spot.band = row["band"] | 0;
+    spot.frequency = row["frequency"] | 0u;
+    copySpotText(spot.rxSign, row["rx_sign"], sizeof(spot.rxSign));
+    spot.rxLat = row["rx_lat"] | 0.0f;
+    spot.snr = row["snr"] | 0;
+    copySpotText(spot.version, row["version"], sizeof(spot.version));
+    spots.push_back(spot);
+    return !stopAfter || spots.size() < stopAfter;
+  });
+}
+
+void setUp(){
+  filter.clear();
+  for(const char* field : spotFields)
+    filter[field] = true;
+}
+void tearDown(){}
+
+void test_rows_in_any_block_size(){
+  const size_t blocks[] = {1, 2, 3, 7, 64, 200, 511, 512, 4096};
+  for(size_t block : blocks){
+    std::vector<Spot> spots;
+    DeserializationError error = readSpots(spotAnswer, strlen(spotAnswer), block, spots);
+    TEST_ASSERT_TRUE_MESSAGE(error == DeserializationError::EmptyInput, error.c_str());
+    TEST_ASSERT_EQUAL(3, spots.size());
+    TEST_ASSERT_EQUAL_UINT32(1792037400, spots[0].t);
+    TEST_ASSERT_EQUAL(14, spots[0].band);
+    TEST_ASSERT_EQUAL_UINT32(14097061, spots[0].frequency);
+    TEST_ASSERT_EQUAL_STRING("DL1ABC", spots[0].rxSign);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 52.521, spots[0].rxLat);
+    TEST_ASSERT_EQUAL(-21, spots[0].snr);
+    TEST_ASSERT_EQUAL_STRING("2.6.1", spots[0].version);
+    TEST_ASSERT_EQUAL_STRING("", spots[1].version);
+    TEST_ASSERT_EQUAL(7, spots[2].band);
+    TEST_ASSERT_EQUAL(-28, spots[2].snr);
+  }
+}
+
+// The reader's own blocks are SPOT_STREAM_BLOCK bytes: put a boundary inside a row, a key and a value
+void test_rows_across_reader_blocks(){
+  const char* row = "{\"t\":1792037400,\"band\":14,\"frequency\":14097061,\"rx_sign\":\"DL1ABC\",\"snr\":-21}\n";
+  const char* markers[] = {"{\"t\"", "frequency", "14097061", "DL1ABC", "-21", "}\n"};
+  for(const char* marker : markers){
+    size_t at = strstr(row, marker) - row + 1;   // Boundary right after the marker's first byte
+    std::string stream;
+    // Filler rows the filter reduces to nothing, then padding, so the row starts at SPOT_STREAM_BLOCK - at
+    while(stream.size() + 40 < SPOT_STREAM_BLOCK - at)
+      stream += "{\"code\":1,\"tx_loc\":\"JN58td\",\"drift\":0}\n";
+    stream.append(SPOT_STREAM_BLOCK - at - stream.size(), ' ');
+    stream += row;
+    TEST_ASSERT_EQUAL(SPOT_STREAM_BLOCK, stream.find(row) + at);
+
+    std::vector<Spot> spots;
+    DeserializationError error = readSpots(stream.data(), stream.size(), SIZE_MAX, spots);
+    TEST_ASSERT_TRUE_MESSAGE(error == DeserializationError::EmptyInput, error.c_str());
+    TEST_ASSERT_EQUAL(2, source.reads - 1);   // Two blocks and the end of the stream
+    const Spot& spot = spots.back();
+    TEST_ASSERT_EQUAL_UINT32(1792037400, spot.t);
+    TEST_ASSERT_EQUAL_UINT32(14097061, spot.frequency);
+    TEST_ASSERT_EQUAL_STRING("DL1ABC", spot.rxSign);
+    TEST_ASSERT_EQUAL(-21, spot.snr);
+  }
+}
+
+void test_filter_keeps_only_the_asked_fields(){
+  source = {selectAllRow, strlen(selectAllRow), 0, 13, 0};
+  SpotStreamReader reader(readMemory, &source);
+  JsonDocument document;
+  size_t fields = 0;
+  DeserializationError error = readJsonRows(reader, filter, document, [&](JsonObjectConst row){
+    fields = row.size();
+    TEST_ASSERT_TRUE(row["id"].isNull());
+    TEST_ASSERT_TRUE(row["tx_sign"].isNull());
+    TEST_ASSERT_EQUAL_UINT32(1792037400, row["t"] | 0u);
+    TEST_ASSERT_EQUAL_STRING("JO62qm", row["rx_loc"] | "");
+    return true;
+  });
+  TEST_ASSERT_TRUE(error == DeserializationError::EmptyInput);
+  TEST_ASSERT_EQUAL(sizeof(spotFields) / sizeof(spotFields[0]), fields);   // All asked for, none of the 9 others
+}
+
+void test_server_error_after_rows(){
+  std::string stream = spotAnswer;
+  stream += "Code: 241. DB::Exception: Memory limit (for query) exceeded. (MEMORY_LIMIT_EXCEEDED) (version 24.3.2.23)\n";
+  std::vector<Spot> spots;
+  DeserializationError error = readSpots(stream.data(), stream.size(), 512, spots);
+  TEST_ASSERT_TRUE_MESSAGE(error == DeserializationError::InvalidInput, error.c_str());
+  TEST_ASSERT_EQUAL(3, spots.size());
+}
+
+void test_value_that_is_not_a_row(){
+  const char* stream = "{\"t\":1792037400,\"band\":14}\n[1,2,3]\n{\"t\":1792038000,\"band\":7}\n";
+  std::vector<Spot> spots;
+  DeserializationError error = readSpots(stream, strlen(stream), 512, spots);
+  TEST_ASSERT_TRUE(error == DeserializationError::InvalidInput);
+  TEST_ASSERT_EQUAL(1, spots.size());
+}
+
+void test_truncated_row(){
+  std::string stream(spotAnswer, strlen(spotAnswer) - 40);
+  std::vector<Spot> spots;
+  DeserializationError error = readSpots(stream.data(), stream.size(), 100, spots);
+  TEST_ASSERT_TRUE_MESSAGE(error == DeserializationError::IncompleteInput, error.c_str());
+  TEST_ASSERT_EQUAL(2, spots.size());
+}
+
+void test_empty_answer(){
+  std::vector<Spot> spots;
+  TEST_ASSERT_TRUE(readSpots("", 0, 512, spots) == DeserializationError::EmptyInput);
+  TEST_ASSERT_TRUE(readSpots("\n\n", 2, 512, spots) == DeserializationError::EmptyInput);
+  TEST_ASSERT_EQUAL(0, spots.size());
+}
+
+void test_missing_and_mistyped_fields_read_as_defaults(){
+  const char* stream = "{\"t\":\"soon\",\"band\":14,\"rx_sign\":42,\"snr\":null}\n";
+  std::vector<Spot> spots;
+  TEST_ASSERT_TRUE(readSpots(stream, strlen(stream), 512, spots) == DeserializationError::EmptyInput);
+  TEST_ASSERT_EQUAL(1, spots.size());
+  TEST_ASSERT_EQUAL_UINT32(0, spots[0].t);
+  TEST_ASSERT_EQUAL(14, spots[0].band);
+  TEST_ASSERT_EQUAL_UINT32(0, spots[0].frequency);
+  TEST_ASSERT_EQUAL_STRING("", spots[0].rxSign);
+  TEST_ASSERT_EQUAL(0, spots[0].snr);
+}
+
+void test_caller_stops_early(){
+  std::vector<Spot> spots;
+  DeserializationError error = readSpots(spotAnswer, strlen(spotAnswer), 16, spots, 1);
+  TEST_ASSERT_TRUE(error == DeserializationError::Ok);
+  TEST_ASSERT_EQUAL(1, spots.size());
+  TEST_ASSERT_LESS_THAN(strlen(spotAnswer), source.pos);
+}
+
+void test_spot_text_is_sanitised(){
+  std::vector<Spot> spots;
+  readSpots(spotAnswer, strlen(spotAnswer), 512, spots);
+  TEST_ASSERT_EQUAL_STRING("K1?Q?T", spots[2].rxSign);
+  TEST_ASSERT_EQUAL_STRING("WSJT-X 2.7.0", spots[2].version);
+
+  char text[6];
+  copySpotText(text, "A\tB\nCDEFG", sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("A?B?C", text);
+  copySpotText(text, NULL, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("", text);
+}
+
+int main(){
+  UNITY_BEGIN();
+  RUN_TEST(test_rows_in_any_block_size);
+  RUN_TEST(test_rows_across_reader_blocks);
+  RUN_TEST(test_filter_keeps_only_the_asked_fields);
+  RUN_TEST(test_server_error_after_rows);
+  RUN_TEST(test_value_that_is_not_a_row);
+  RUN_TEST(test_truncated_row);
+  RUN_TEST(test_empty_answer);
+  RUN_TEST(test_missing_and_mistyped_fields_read_as_defaults);
+  RUN_TEST(test_caller_stops_early);
+  RUN_TEST(test_spot_text_is_sanitised);
+  return UNITY_END();
+}